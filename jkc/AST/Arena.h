@@ -0,0 +1,88 @@
+#pragma once
+#include <jkr/CoreTypes.h>
+#include <jkr/Align.h>
+#include <jkr/Vector.h>
+#include <memory>
+#include <new>
+#include <string.h>
+#include <type_traits>
+
+namespace AST {
+
+// Bump allocator that owns every node of a program, the nodes are trivially
+// destructible so releasing the tree is a single Reset
+struct Arena {
+    static constexpr USize BlockSize = 64 * 1024;
+
+    Arena() = default;
+    ~Arena() = default;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    void* Allocate(USize Size, USize Alignment) {
+        USize offset = Align(Used, Alignment);
+        if (offset + Size > Capacity) {
+            // Blocks are aligned by operator new, a fresh block starts at 0
+            USize capacity = Size > BlockSize ? Size : BlockSize;
+            Blocks.emplace_back(new Byte[capacity]);
+            Capacity = capacity;
+            offset = 0;
+        }
+
+        Used = offset + Size;
+        return Blocks.back().get() + offset;
+    }
+
+    template<typename T, typename... Args>
+    T* New(Args&&... Arguments) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena nodes are never destroyed");
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+        return ::new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(Arguments)...);
+    }
+
+    void Reset() {
+        Blocks.clear();
+        Used = 0;
+        Capacity = 0;
+    }
+
+    Vector<std::unique_ptr<Byte[]>> Blocks;
+    USize Used = 0;
+    USize Capacity = 0;
+};
+
+// Growable array stored in an Arena, the old storage is left behind on growth
+template<typename T>
+struct List {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    T& Push(Arena& Nodes, const T& Item) {
+        if (Count == Reserved) {
+            UInt32 reserved = Reserved ? Reserved * 2 : 4;
+            T* items = (T*)Nodes.Allocate(sizeof(T) * reserved, alignof(T));
+            if (Count)
+                memcpy((void*)items, Items, sizeof(T) * Count);
+
+            Items = items;
+            Reserved = reserved;
+        }
+
+        T* item = ::new (&Items[Count++]) T(Item);
+        return *item;
+    }
+
+    constexpr T* begin() const { return Items; }
+    constexpr T* end() const { return Items + Count; }
+    constexpr USize size() const { return Count; }
+    constexpr bool empty() const { return Count == 0; }
+    constexpr T& operator[](USize Index) const { return Items[Index]; }
+
+    T* Items = nullptr;
+    UInt32 Count = 0;
+    UInt32 Reserved = 0;
+};
+
+}
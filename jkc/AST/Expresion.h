@@ -37,7 +37,6 @@ enum class ExpresionType {
 struct Expresion {
     constexpr Expresion(ExpresionType Type, const SourceLocation& Location) :
         Type(Type), Location(Location) {}
-    constexpr ~Expresion() {}
 
     Expresion(Expresion&&) = default;
     Expresion& operator=(Expresion&&) = default;
@@ -2,8 +2,7 @@
 #include "jkc/AST/Expresion.h"
 #include "jkc/AST/Type.h"
 #include "jkc/AST/Enums.h"
-#include <jkr/Vector.h>
-#include <memory>
+#include "jkc/AST/Arena.h"
 
 namespace AST {
 
@@ -13,14 +12,13 @@ struct Constant : Expresion {
     constexpr Constant(const SourceLocation& Location) : 
         Expresion(ExpresionType::Constant, Location), ValueType() {}
 
-    constexpr ~Constant() {}
-
     union {
         Int64 Signed = 0;
         UInt64 Unsigned;
         Float64 Real;
     };
-    String String;
+    // String literal as written in the source, with the escape sequences
+    StringView String;
     TypeDecl ValueType;
 };
 
@@ -28,47 +26,39 @@ struct Identifier : Expresion {
     constexpr Identifier(const SourceLocation& Location) :
         Expresion(ExpresionType::Identifier, Location) {}
 
-    constexpr ~Identifier() {}
-    String ID;
+    StringView ID;
+    Atom IDAtom = NoAtom;
 };
 
 struct Group : Expresion {
     constexpr Group(const SourceLocation& Location) :
         Expresion(ExpresionType::Group, Location) {}
 
-    constexpr ~Group() {}
-
-    std::unique_ptr<Expresion> Value;
+    Expresion* Value = nullptr;
 };
 
 struct Call : Expresion {
     constexpr Call(const SourceLocation& Location) :
         Expresion(ExpresionType::Call, Location) {}
 
-    constexpr ~Call() {}
-
-    std::unique_ptr<Expresion> Target;
-    Vector<std::unique_ptr<Expresion>> Arguments;
+    Expresion* Target = nullptr;
+    List<Expresion*> Arguments;
 };
 
 struct BinaryOp : Expresion {
     constexpr BinaryOp(const SourceLocation& Location) :
         Expresion(ExpresionType::BinaryOp, Location) {}
 
-    constexpr ~BinaryOp() {}
-
-    std::unique_ptr<Expresion> Left;
+    Expresion* Left = nullptr;
     BinaryOperation Op = BinaryOperation::None;
-    std::unique_ptr<Expresion> Right;
+    Expresion* Right = nullptr;
 };
 
 struct Unary : Expresion {
     constexpr Unary(const SourceLocation& Location) :
         Expresion(ExpresionType::Unary, Location) {}
 
-    constexpr ~Unary() {}
-
-    std::unique_ptr<Expresion> Value;
+    Expresion* Value = nullptr;
     UnaryOperation Op = UnaryOperation::None;
 };
 
@@ -76,47 +66,37 @@ struct Dot : Expresion {
     constexpr Dot(const SourceLocation& Location) :
         Expresion(ExpresionType::Dot, Location) {}
 
-    constexpr ~Dot() {}
-
-    std::unique_ptr<Expresion> Left;
-    std::unique_ptr<Expresion> Right;
+    Expresion* Left = nullptr;
+    Expresion* Right = nullptr;
 };
 
 struct ArrayList : Expresion {
     constexpr ArrayList(const SourceLocation& Location) :
         Expresion(ExpresionType::ArrayList, Location) {}
 
-    constexpr ~ArrayList() {}
-
-    Vector<std::unique_ptr<Expresion>> Elements;
+    List<Expresion*> Elements;
 };
 
 struct Block : Expresion {
     constexpr Block(const SourceLocation& Location) :
         Expresion(ExpresionType::Block, Location) {}
 
-    constexpr ~Block() {}
-
-    Vector<std::unique_ptr<Statement>> Statements;
+    List<Statement*> Statements;
 };
 
 struct ArrayAccess : Expresion {
     constexpr ArrayAccess(const SourceLocation& Location) :
         Expresion(ExpresionType::ArrayAccess, Location) {}
 
-    constexpr ~ArrayAccess() {}
-
-    std::unique_ptr<Expresion> Expr;
-    std::unique_ptr<Expresion> IndexExpr;
+    Expresion* Expr = nullptr;
+    Expresion* IndexExpr = nullptr;
 };
 
 struct IncDec : Expresion {
     constexpr IncDec(const SourceLocation& Location) :
         Expresion(ExpresionType::IncDec, Location) {}
 
-    constexpr ~IncDec() {}
-
-    std::unique_ptr<Expresion> Expr;
+    Expresion* Expr = nullptr;
     bool Increment;
     bool After; // The inc/dec was after the expresion
 };
@@ -124,10 +104,9 @@ struct IncDec : Expresion {
 struct Assignment : Expresion {
     constexpr Assignment(const SourceLocation& Location) :
         Expresion(ExpresionType::Assignment, Location) {}
-    constexpr ~Assignment() {}
 
-    std::unique_ptr<Expresion> Target;
-    std::unique_ptr<Expresion> Source;
+    Expresion* Target = nullptr;
+    Expresion* Source = nullptr;
 };
 
 }
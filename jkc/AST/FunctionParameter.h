@@ -7,9 +7,8 @@ namespace AST {
 struct FunctionParameter {
     constexpr FunctionParameter() {}
 
-    constexpr ~FunctionParameter() {}
-
     StringView Name;
+    Atom NameAtom = NoAtom;
     TypeDecl Type;
 };
 
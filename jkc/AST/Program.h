@@ -1,25 +1,26 @@
 #pragma once
 #include "jkc/AST/Expresion.h"
 #include "jkc/AST/Statement.h"
-#include <jkr/Vector.h>
+#include "jkc/AST/Arena.h"
 #include <jkr/String.h>
-#include <memory>
 
 namespace AST {
 
 struct Program {
-    using StatementList = Vector<std::unique_ptr<AST::Statement>>;
+    using StatementList = List<AST::Statement*>;
 
-    constexpr Program(String Name) : 
-        Name(Name), Statements() {}
-
-    constexpr ~Program() {}
+    Program(String Name) : 
+        Name(Name), Nodes(), Statements() {}
 
     Program(Program&&) = default;
     Program& operator=(Program&&) = default;
 
     String Name;
+    // Owns every node reachable from Statements
+    Arena Nodes;
     StatementList Statements;
+    // Hash of the tokens outside of the function bodies
+    UInt64 DeclarationHash = 0;
 };
 
 }
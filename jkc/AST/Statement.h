@@ -10,6 +10,7 @@ struct Var;
 struct If;
 struct For;
 struct While;
+struct Struct;
 struct ExpresionStatement;
 
 enum class StatementType {
@@ -21,6 +22,7 @@ enum class StatementType {
     If,
     For,
     While,
+    Struct,
     ExpresionStatement,
 };
 
@@ -28,8 +30,6 @@ struct Statement {
     constexpr Statement(StatementType Type, const SourceLocation& Location) :
         Type(Type), Location(Location) {}
 
-    constexpr ~Statement() {}
-
     Statement(Statement&&) = default;
     Statement& operator=(Statement&&) = default;
 
@@ -2,8 +2,7 @@
 #include "jkc/AST/Statement.h"
 #include "jkc/AST/Expresion.h"
 #include "jkc/AST/FunctionParameter.h"
-#include <jkr/Vector.h>
-#include <memory>
+#include "jkc/AST/Arena.h"
 
 namespace AST {
 
@@ -15,72 +14,102 @@ struct Function : Statement {
     constexpr Function(const SourceLocation& Location) :
         Statement(StatementType::Function, Location) {}
 
-    constexpr ~Function() {}
-
-    String Name;
+    StringView Name;
+    Atom NameAtom = NoAtom;
     TypeDecl FunctionType = TypeDecl();
-    Vector<FunctionParameter> Parameters = {};
+    List<FunctionParameter> Parameters;
     
     bool IsDefined = false;
     bool HasMultiReturn = false;
     bool IsExtern = false;
-    String LibraryRef;
+    // Library name as written in the source
+    StringView LibraryRef;
 
-    std::unique_ptr<Block> Body = {};
+    Block* Body = nullptr;
+    // Hash of the tokens of the body, used by the compilation cache
+    UInt64 BodyHash = 0;
 };
 
 struct Return : Statement {
     constexpr Return(const SourceLocation& Location) :
         Statement(StatementType::Return, Location) {}
 
-    constexpr ~Return() {}
-
-    std::unique_ptr<Expresion> Value;
+    Expresion* Value = nullptr;
 };
 
 struct Var : Statement {
     constexpr Var(const SourceLocation& Location) :
         Statement(StatementType::Var, Location) {}
 
-    constexpr ~Var() {}
-
-    String Name;
+    StringView Name;
+    Atom NameAtom = NoAtom;
     TypeDecl VarType;
     bool IsDefined = false;
-    std::unique_ptr<Expresion> Value;
+    Expresion* Value = nullptr;
 };
 
 struct ConstVal : Statement {
     constexpr ConstVal(const SourceLocation& Location) :
         Statement(StatementType::ConstVal, Location) {}
 
-    constexpr ~ConstVal() {}
-
-    String Name;
+    StringView Name;
+    Atom NameAtom = NoAtom;
     TypeDecl ConstType;
     bool IsDefined = false;
-    std::unique_ptr<Expresion> Value;
+    Expresion* Value = nullptr;
 };
 
 struct If : Statement {
     constexpr If(const SourceLocation& Location) :
         Statement(StatementType::If, Location) {}
 
-    constexpr ~If() {}
+    Expresion* Expr = nullptr;
+    Block* Body = nullptr;
+    If* Elif = nullptr;
+    Block* ElseBlock = nullptr;
+};
+
+// for (Init; Expr; Step) { Body }, every part is optional
+struct For : Statement {
+    constexpr For(const SourceLocation& Location) :
+        Statement(StatementType::For, Location) {}
 
-    std::unique_ptr<Expresion> Expr;
-    std::unique_ptr<Block> Body;
-    std::unique_ptr<If> Elif;
-    std::unique_ptr<Block> ElseBlock;
+    // A var or a expresion statement
+    Statement* Init = nullptr;
+    Expresion* Expr = nullptr;
+    Expresion* Step = nullptr;
+    Block* Body = nullptr;
+};
+
+struct While : Statement {
+    constexpr While(const SourceLocation& Location) :
+        Statement(StatementType::While, Location) {}
+
+    Expresion* Expr = nullptr;
+    Block* Body = nullptr;
+};
+
+struct StructField {
+    StringView Name;
+    Atom NameAtom = NoAtom;
+    TypeDecl Type;
+    SourceLocation Location;
+};
+
+struct Struct : Statement {
+    constexpr Struct(const SourceLocation& Location) :
+        Statement(StatementType::Struct, Location) {}
+
+    StringView Name;
+    Atom NameAtom = NoAtom;
+    List<StructField> Fields;
 };
 
 struct ExpresionStatement : Statement {
     constexpr ExpresionStatement(const SourceLocation& Location) :
         Statement(StatementType::ExpresionStatement, Location) {}
 
-    constexpr ~ExpresionStatement() {}
-
-    std::unique_ptr<Expresion> Value;
+    Expresion* Value = nullptr;
 };
 
 }
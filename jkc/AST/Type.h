@@ -1,5 +1,7 @@
 #pragma once
 #include "jkr/CoreTypes.h"
+#include "jkr/String.h"
+#include "jkc/Lexer/Atom.h"
 #include <string>
 
 namespace AST {
@@ -15,6 +17,7 @@ public:
         UInt,
         Float,
         Any,
+        Struct,
     };
 
     enum TypeFlags {
@@ -74,6 +77,7 @@ public:
     [[nodiscard]] constexpr bool IsInt() const { return Is(Type::Int) && !HasArray(); }
     [[nodiscard]] constexpr bool IsUInt() const { return Is(Type::UInt) && !HasArray(); }
     [[nodiscard]] constexpr bool IsFloat() const { return Is(Type::Float) && !HasArray(); }
+    [[nodiscard]] constexpr bool IsStruct() const { return Is(Type::Struct) && !HasArray(); }
     [[nodiscard]] constexpr bool IsConstString() const { 
         return Is(Type::Byte) && HasConst() && (HasArray());
     }
@@ -99,7 +103,8 @@ public:
         }
         return Primitive == RHS.Primitive
             && flags == rFlags
-            && ArrayLen == RHS.ArrayLen;
+            && ArrayLen == RHS.ArrayLen
+            && StructAtom == RHS.StructAtom;
     }
 
     [[nodiscard]] constexpr std::string ToString() const {
@@ -138,6 +143,9 @@ public:
         case Type::Float:
             str += "Float";
             break;
+        case Type::Struct:
+            str.append((const char*)StructName.data(), StructName.size());
+            break;
         }
 
         return str;
@@ -147,6 +155,9 @@ public:
     UInt32 SizeInBits;
     UInt8 Flags;
     UInt32 ArrayLen;
+    // Only used by Type::Struct, resolved by the emitter
+    StringView StructName = {};
+    Atom StructAtom = NoAtom;
 };
 
 }
\ No newline at end of file
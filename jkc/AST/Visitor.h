@@ -0,0 +1,233 @@
+#pragma once
+#include "jkc/AST/Statements.h"
+#include "jkc/AST/Expresions.h"
+#include <type_traits>
+
+namespace AST {
+
+// Dispatches the statements and the expresions to the Visit functions of Derived,
+// a Visit function that Derived doesn't define visits the children if the result is void
+// and returns the default result (false, nullptr, ...) otherwise
+template<typename Derived, typename StatResult = void, typename ExprResult = void>
+struct Visitor {
+    StatResult VisitStatement(Statement* Stat) {
+        switch (Stat->Type) {
+        case StatementType::Return:
+            return Self().VisitReturn((Return*)Stat);
+        case StatementType::Var:
+            return Self().VisitVar((Var*)Stat);
+        case StatementType::ConstVal:
+            return Self().VisitConstVal((ConstVal*)Stat);
+        case StatementType::If:
+            return Self().VisitIf((If*)Stat);
+        case StatementType::While:
+            return Self().VisitWhile((While*)Stat);
+        case StatementType::For:
+            return Self().VisitFor((For*)Stat);
+        case StatementType::ExpresionStatement:
+            return Self().VisitExpresionStatement((ExpresionStatement*)Stat);
+        default:
+            return StatResult();
+        }
+    }
+
+    ExprResult VisitExpresion(Expresion* Expr) {
+        switch (Expr->Type) {
+        case ExpresionType::Constant:
+            return Self().VisitConstant((Constant*)Expr);
+        case ExpresionType::Identifier:
+            return Self().VisitIdentifier((Identifier*)Expr);
+        case ExpresionType::Group:
+            return Self().VisitGroup((Group*)Expr);
+        case ExpresionType::Call:
+            return Self().VisitCall((Call*)Expr);
+        case ExpresionType::BinaryOp:
+            return Self().VisitBinaryOp((BinaryOp*)Expr);
+        case ExpresionType::Unary:
+            return Self().VisitUnary((Unary*)Expr);
+        case ExpresionType::Dot:
+            return Self().VisitDot((Dot*)Expr);
+        case ExpresionType::ArrayList:
+            return Self().VisitArrayList((ArrayList*)Expr);
+        case ExpresionType::Block:
+            return Self().VisitBlock((Block*)Expr);
+        case ExpresionType::ArrayAccess:
+            return Self().VisitArrayAccess((ArrayAccess*)Expr);
+        case ExpresionType::IncDec:
+            return Self().VisitIncDec((IncDec*)Expr);
+        case ExpresionType::Assignment:
+            return Self().VisitAssignment((Assignment*)Expr);
+        default:
+            return ExprResult();
+        }
+    }
+
+    // Statements
+
+    StatResult VisitReturn(Return* Ret) {
+        if constexpr (std::is_void_v<StatResult>) {
+            VisitChild(Ret->Value);
+        }
+        return StatResult();
+    }
+
+    StatResult VisitVar(Var* Var) {
+        if constexpr (std::is_void_v<StatResult>) {
+            VisitChild(Var->Value);
+        }
+        return StatResult();
+    }
+
+    StatResult VisitConstVal(ConstVal* Const) {
+        if constexpr (std::is_void_v<StatResult>) {
+            VisitChild(Const->Value);
+        }
+        return StatResult();
+    }
+
+    // The elif is visited as part of its if, not as a statement
+    StatResult VisitIf(If* If) {
+        if constexpr (std::is_void_v<StatResult>) {
+            VisitChild(If->Expr);
+            VisitChild(If->Body);
+            if (If->Elif) {
+                Self().VisitIf(If->Elif);
+            }
+            else {
+                VisitChild(If->ElseBlock);
+            }
+        }
+        return StatResult();
+    }
+
+    StatResult VisitWhile(While* While) {
+        if constexpr (std::is_void_v<StatResult>) {
+            VisitChild(While->Expr);
+            VisitChild(While->Body);
+        }
+        return StatResult();
+    }
+
+    StatResult VisitFor(For* For) {
+        if constexpr (std::is_void_v<StatResult>) {
+            if (For->Init) {
+                Self().VisitStatement(For->Init);
+            }
+            VisitChild(For->Expr);
+            VisitChild(For->Step);
+            VisitChild(For->Body);
+        }
+        return StatResult();
+    }
+
+    StatResult VisitExpresionStatement(ExpresionStatement* Stat) {
+        if constexpr (std::is_void_v<StatResult>) {
+            VisitChild(Stat->Value);
+        }
+        return StatResult();
+    }
+
+    // Expresions
+
+    ExprResult VisitConstant(Constant*) {
+        return ExprResult();
+    }
+
+    ExprResult VisitIdentifier(Identifier*) {
+        return ExprResult();
+    }
+
+    ExprResult VisitGroup(Group* Group) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            VisitChild(Group->Value);
+        }
+        return ExprResult();
+    }
+
+    // The target is a function name
+    ExprResult VisitCall(Call* Call) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            for (auto arg : Call->Arguments) {
+                VisitChild(arg);
+            }
+        }
+        return ExprResult();
+    }
+
+    ExprResult VisitBinaryOp(BinaryOp* BinOp) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            VisitChild(BinOp->Left);
+            VisitChild(BinOp->Right);
+        }
+        return ExprResult();
+    }
+
+    ExprResult VisitUnary(Unary* Unary) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            VisitChild(Unary->Value);
+        }
+        return ExprResult();
+    }
+
+    // The right side is a field name
+    ExprResult VisitDot(Dot* Dot) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            VisitChild(Dot->Left);
+        }
+        return ExprResult();
+    }
+
+    ExprResult VisitArrayList(ArrayList* List) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            for (auto element : List->Elements) {
+                VisitChild(element);
+            }
+        }
+        return ExprResult();
+    }
+
+    ExprResult VisitBlock(Block* Block) {
+        if constexpr (std::is_void_v<ExprResult> && std::is_void_v<StatResult>) {
+            for (auto stat : Block->Statements) {
+                Self().VisitStatement(stat);
+            }
+        }
+        return ExprResult();
+    }
+
+    ExprResult VisitArrayAccess(ArrayAccess* Access) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            VisitChild(Access->Expr);
+            VisitChild(Access->IndexExpr);
+        }
+        return ExprResult();
+    }
+
+    ExprResult VisitIncDec(IncDec* IncDec) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            VisitChild(IncDec->Expr);
+        }
+        return ExprResult();
+    }
+
+    ExprResult VisitAssignment(Assignment* Assignment) {
+        if constexpr (std::is_void_v<ExprResult>) {
+            VisitChild(Assignment->Target);
+            VisitChild(Assignment->Source);
+        }
+        return ExprResult();
+    }
+
+private:
+    Derived& Self() {
+        return static_cast<Derived&>(*this);
+    }
+
+    void VisitChild(Expresion* Expr) {
+        if (Expr) {
+            Self().VisitExpresion(Expr);
+        }
+    }
+};
+
+}
@@ -0,0 +1,116 @@
+#include "jkc/CodeGen/Assembler.h"
+#include <algorithm>
+
+namespace CodeGen {
+
+constexpr UInt32 UnboundLabel = 0xFFFF'FFFF;
+// The form emitted until the labels are resolved
+constexpr Byte NearJumpSize = codefile::InstructionSizes[Byte(codefile::OpCode::Jmp)];
+
+static Byte GetJumpSize(codefile::JumpForm Form) {
+    return codefile::InstructionSizes[Byte(codefile::GetJumpForm(codefile::OpCode::Jmp, Form))];
+}
+
+static bool Fits(Int64 Displacement, codefile::JumpForm Form) {
+    switch (Form) {
+    case codefile::JumpForm::Short:
+        return Displacement >= -0x80 && Displacement <= 0x7F;
+    case codefile::JumpForm::Near:
+        return Displacement >= -0x8000 && Displacement <= 0x7FFF;
+    default:
+        return true;
+    }
+}
+
+Label Assembler::CreateLabel(Function& Fn) {
+    Fn.Labels.emplace_back(UnboundLabel);
+    return Label(Fn.Labels.size() - 1);
+}
+
+void Assembler::BindLabel(Function& Fn, Label Target) {
+    Fn.Labels[Target] = UInt32(Fn.Code.Buff.size());
+}
+
+void Assembler::Jump(Function& Fn, codefile::OpCode OpCode, Label Target) {
+    Fn.Relocations.emplace_back(Relocation{ .IP = UInt32(Fn.Code.Buff.size()), .Target = Target });
+    Jmp(Fn, codefile::GetNearJump(OpCode), 0);
+}
+
+void Assembler::ResolveLabels(Function& Fn) {
+    auto& relocations = Fn.Relocations;
+    std::sort(relocations.begin(), relocations.end(), [](const Relocation& A, const Relocation& B) {
+        return A.IP < B.IP;
+    });
+
+    // Every jump starts in the short form and grows until it reaches its label,
+    // a jump never shrinks so the sizes stop changing
+    USize count = relocations.size();
+    Vector<codefile::JumpForm> forms(count, codefile::JumpForm::Short);
+    // Bytes saved by the jumps before each one, negative if they grew
+    Vector<Int64> saved(count + 1, 0);
+
+    auto relocate = [&](UInt32 Offset) {
+        auto it = std::lower_bound(relocations.begin(), relocations.end(), Offset, [](const Relocation& R, UInt32 IP) {
+            return R.IP < IP;
+        });
+        return UInt32(Offset - saved[it - relocations.begin()]);
+    };
+
+    auto displacement = [&](USize Index) {
+        const Relocation& relocation = relocations[Index];
+        UInt32 next = relocate(relocation.IP) + GetJumpSize(forms[Index]);
+        return Int64(relocate(Fn.Labels[relocation.Target])) - Int64(next);
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (USize i = 0; i < count; i++) {
+            saved[i + 1] = saved[i] + NearJumpSize - Int64(GetJumpSize(forms[i]));
+        }
+
+        for (USize i = 0; i < count; i++) {
+            if (!Fits(displacement(i), forms[i])) {
+                forms[i] = codefile::JumpForm(Byte(forms[i]) + 1);
+                changed = true;
+            }
+        }
+    }
+
+    const Vector<Byte>& code = Fn.Code.Buff;
+    Vector<Byte> result = {};
+    result.reserve(USize(Int64(code.size()) - saved[count]));
+
+    UInt32 start = 0;
+    for (USize i = 0; i < count; i++) {
+        UInt32 ip = relocations[i].IP;
+        result.insert(result.end(), code.begin() + start, code.begin() + ip);
+
+        Byte size = GetJumpSize(forms[i]);
+        UInt32 value = UInt32(displacement(i));
+        result.emplace_back(Byte(codefile::GetJumpForm(codefile::OpCode(code[ip]), forms[i])));
+        for (Byte b = 1; b < size; b++) {
+            result.emplace_back(Byte(value >> ((b - 1) * 8)));
+        }
+        start = ip + NearJumpSize;
+    }
+    result.insert(result.end(), code.begin() + start, code.end());
+
+    // The string references are never inside of a jump
+    for (auto& ref : Fn.StringRefs) {
+        ref.IP = relocate(ref.IP);
+    }
+    for (auto& site : Fn.ProfileSites) {
+        site.IP = relocate(site.IP);
+    }
+    for (auto& label : Fn.Labels) {
+        if (label != UnboundLabel) {
+            label = relocate(label);
+        }
+    }
+
+    relocations.clear();
+    Fn.Code.Buff = std::move(result);
+}
+
+}
@@ -12,7 +12,7 @@ struct Assembler {
     Assembler() {}
     ~Assembler() {}
 
-    constexpr void Brk(Function& Fn) { Fn.Code << UInt32(codefile::OpCode::Brk); }
+    constexpr void Brk(Function& Fn) { Fn.Code << Byte(codefile::OpCode::Brk); }
 
     constexpr void LDR(Function& Fn, Byte Dest, Byte BT, UInt16 Imm) {
         Fn.Code << Byte(codefile::OpCode::Ldr);
@@ -399,6 +399,41 @@ struct Assembler {
         Fn.Code << Src;
     }
 
+    constexpr void ObjectNew(Function& Fn, Byte Dest, UInt16 Size) {
+        Fn.Code << Byte(codefile::OpCode::ObjectNew);
+        Fn.Code << Dest;
+        Fn.Code << Size;
+    }
+
+    constexpr void ObjectDestroy(Function& Fn, Byte Src) {
+        Fn.Code << Byte(codefile::OpCode::ObjectDestroy);
+        Fn.Code << Src;
+    }
+
+    constexpr void LoadField(Function& Fn, Byte Dest, Byte ObjectInReg, codefile::ArrayElement FE, UInt16 Offset) {
+        Fn.Code << Byte(codefile::OpCode::LoadField);
+        Fn.Code << Byte(Dest | (ObjectInReg << 4));
+        Fn.Code << Byte(FE);
+        Fn.Code << Offset;
+    }
+
+    constexpr void StoreField(Function& Fn, Byte Src, Byte ObjectInReg, codefile::ArrayElement FE, UInt16 Offset) {
+        Fn.Code << Byte(codefile::OpCode::StoreField);
+        Fn.Code << Byte(Src | (ObjectInReg << 4));
+        Fn.Code << Byte(FE);
+        Fn.Code << Offset;
+    }
+
+    // Labels
+
+    Label CreateLabel(Function& Fn);
+    // The label is at the current end of the code
+    void BindLabel(Function& Fn, Label Target);
+    // A jump of any form to a label, Jmp emits a near jump with a known displacement
+    void Jump(Function& Fn, codefile::OpCode OpCode, Label Target);
+    // Picks the smallest form of each jump that reaches its label and writes the displacements,
+    // the labels and the string references are moved with the code
+    void ResolveLabels(Function& Fn);
 };
 
 }
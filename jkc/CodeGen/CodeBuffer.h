@@ -42,6 +42,7 @@ struct CodeBuffer {
         Buff.emplace_back(Byte(Val >> 32));
         Buff.emplace_back(Byte(Val >> 40));
         Buff.emplace_back(Byte(Val >> 48));
+        Buff.emplace_back(Byte(Val >> 56));
         return *this;
     }
     
@@ -49,6 +50,7 @@ struct CodeBuffer {
         for (auto& b : RHS) {
             *this << b;
         }
+        return *this;
     }
 
     constexpr void Clear() {
@@ -0,0 +1,251 @@
+#include "jkc/CodeGen/Decoder.h"
+
+namespace CodeGen {
+
+constexpr Byte R1 = OperandR1;
+constexpr Byte R2 = OperandR2;
+constexpr Byte R3 = OperandR3;
+
+const InstructionInfo InstructionInfos[codefile::OpCodeCount] = {
+    { "brk", OperandFormat::None, 0, 0 },
+
+    { "mov", OperandFormat::Registers, R2, R1 },
+    // The immediate of Mov4 is in R2
+    { "mov", OperandFormat::Registers, 0, R1 },
+    { "mov", OperandFormat::RegistersImm, 0, R1 },
+    { "mov", OperandFormat::RegistersImm, 0, R1 },
+    { "mov", OperandFormat::RegistersImm, 0, R1 },
+    { "mov", OperandFormat::RegistersImm, 0, R1 },
+    // The base of Ldr and Str is in R2
+    { "load.string", OperandFormat::RegistersImm, 0, R1 },
+    { "load", OperandFormat::RegistersImm, 0, R1 },
+    { "str", OperandFormat::RegistersImm, R1, 0 },
+
+    { "cmp", OperandFormat::Registers, R1 | R2, 0 },
+    { "fcmp", OperandFormat::Registers, R1 | R2, 0 },
+    { "testz", OperandFormat::Registers, R1, 0 },
+    { "jmp", OperandFormat::Imm, 0, 0 },
+    { "je", OperandFormat::Imm, 0, 0 },
+    { "jne", OperandFormat::Imm, 0, 0 },
+    { "jl", OperandFormat::Imm, 0, 0 },
+    { "jle", OperandFormat::Imm, 0, 0 },
+    { "jg", OperandFormat::Imm, 0, 0 },
+    { "jge", OperandFormat::Imm, 0, 0 },
+    { "jmp.s", OperandFormat::Imm, 0, 0 },
+    { "je.s", OperandFormat::Imm, 0, 0 },
+    { "jne.s", OperandFormat::Imm, 0, 0 },
+    { "jl.s", OperandFormat::Imm, 0, 0 },
+    { "jle.s", OperandFormat::Imm, 0, 0 },
+    { "jg.s", OperandFormat::Imm, 0, 0 },
+    { "jge.s", OperandFormat::Imm, 0, 0 },
+    { "jmp.l", OperandFormat::Imm, 0, 0 },
+    { "je.l", OperandFormat::Imm, 0, 0 },
+    { "jne.l", OperandFormat::Imm, 0, 0 },
+    { "jl.l", OperandFormat::Imm, 0, 0 },
+    { "jle.l", OperandFormat::Imm, 0, 0 },
+    { "jg.l", OperandFormat::Imm, 0, 0 },
+    { "jge.l", OperandFormat::Imm, 0, 0 },
+
+    { "call", OperandFormat::Imm, 0, 0 },
+    { "calla", OperandFormat::None, 0, 0 },
+    { "ret", OperandFormat::None, 0, 0 },
+    { "ret", OperandFormat::Imm, 0, 0 },
+
+    { "inc", OperandFormat::Registers, R1, R1 },
+    { "iinc", OperandFormat::Registers, R1, R1 },
+    { "finc", OperandFormat::Registers, R1, R1 },
+    { "dec", OperandFormat::Registers, R1, R1 },
+    { "idec", OperandFormat::Registers, R1, R1 },
+    { "fdec", OperandFormat::Registers, R1, R1 },
+
+    { "add", OperandFormat::Math, R2 | R3, R1 },
+    { "sub", OperandFormat::Math, R2 | R3, R1 },
+    { "mul", OperandFormat::Math, R2 | R3, R1 },
+    { "div", OperandFormat::Math, R2 | R3, R1 },
+    { "iadd", OperandFormat::Math, R2 | R3, R1 },
+    { "isub", OperandFormat::Math, R2 | R3, R1 },
+    { "imul", OperandFormat::Math, R2 | R3, R1 },
+    { "idiv", OperandFormat::Math, R2 | R3, R1 },
+    { "fadd", OperandFormat::Math, R2 | R3, R1 },
+    { "fsub", OperandFormat::Math, R2 | R3, R1 },
+    { "fmul", OperandFormat::Math, R2 | R3, R1 },
+    { "fdiv", OperandFormat::Math, R2 | R3, R1 },
+
+    { "add8", OperandFormat::RegistersImm, R2, R1 },
+    { "sub8", OperandFormat::RegistersImm, R2, R1 },
+    { "mul8", OperandFormat::RegistersImm, R2, R1 },
+    { "div8", OperandFormat::RegistersImm, R2, R1 },
+    { "iadd8", OperandFormat::RegistersImm, R2, R1 },
+    { "isub8", OperandFormat::RegistersImm, R2, R1 },
+    { "imul8", OperandFormat::RegistersImm, R2, R1 },
+    { "idiv8", OperandFormat::RegistersImm, R2, R1 },
+
+    { "add16", OperandFormat::RegistersImm, R2, R1 },
+    { "sub16", OperandFormat::RegistersImm, R2, R1 },
+    { "mul16", OperandFormat::RegistersImm, R2, R1 },
+    { "div16", OperandFormat::RegistersImm, R2, R1 },
+    { "iadd16", OperandFormat::RegistersImm, R2, R1 },
+    { "isub16", OperandFormat::RegistersImm, R2, R1 },
+    { "imul16", OperandFormat::RegistersImm, R2, R1 },
+    { "idiv16", OperandFormat::RegistersImm, R2, R1 },
+
+    { "or", OperandFormat::Math, R2 | R3, R1 },
+    { "and", OperandFormat::Math, R2 | R3, R1 },
+    { "xor", OperandFormat::Math, R2 | R3, R1 },
+    { "shl", OperandFormat::Math, R2 | R3, R1 },
+    { "shr", OperandFormat::Math, R2 | R3, R1 },
+
+    { "not", OperandFormat::Registers, R1, R1 },
+    { "neg", OperandFormat::Registers, R1, R1 },
+
+    { "or8", OperandFormat::RegistersImm, R2, R1 },
+    { "and8", OperandFormat::RegistersImm, R2, R1 },
+    { "xor8", OperandFormat::RegistersImm, R2, R1 },
+    { "shl8", OperandFormat::RegistersImm, R2, R1 },
+    { "shr8", OperandFormat::RegistersImm, R2, R1 },
+
+    { "or16", OperandFormat::RegistersImm, R2, R1 },
+    { "and16", OperandFormat::RegistersImm, R2, R1 },
+    { "xor16", OperandFormat::RegistersImm, R2, R1 },
+
+    { "push", OperandFormat::Imm, 0, 0 },
+    { "push", OperandFormat::Imm, 0, 0 },
+    { "push", OperandFormat::Imm, 0, 0 },
+    { "push", OperandFormat::Imm, 0, 0 },
+    { "popd", OperandFormat::None, 0, 0 },
+
+    { "push", OperandFormat::Registers, R1, 0 },
+    { "pop", OperandFormat::Registers, 0, R1 },
+
+    // The element of ArrayNew is in R2
+    { "array.new", OperandFormat::Registers, R1, R1 },
+    { "array.length", OperandFormat::Registers, R1, R2 },
+    { "array.load", OperandFormat::Array, R1 | R2, R3 },
+    { "array.store", OperandFormat::Array, R1 | R2 | R3, 0 },
+    { "array.destroy", OperandFormat::Registers, R1, 0 },
+
+    { "object.new", OperandFormat::RegistersImm, 0, R1 },
+    { "object.destroy", OperandFormat::Registers, R1, 0 },
+    { "object.load", OperandFormat::Field, R2, R1 },
+    { "object.store", OperandFormat::Field, R1 | R2, 0 },
+};
+
+static bool HasRegister(const DecodedInstruction& Inst, Byte Mask, Byte Reg) {
+    return ((Mask & OperandR1) && Inst.R1 == Reg) ||
+        ((Mask & OperandR2) && Inst.R2 == Reg) ||
+        ((Mask & OperandR3) && Inst.R3 == Reg);
+}
+
+bool DecodedInstruction::Reads(Byte Reg) const {
+    return HasRegister(*this, InstructionInfos[Byte(Op)].Reads, Reg);
+}
+
+bool DecodedInstruction::Writes(Byte Reg) const {
+    return HasRegister(*this, InstructionInfos[Byte(Op)].Writes, Reg);
+}
+
+// The immediates are little endian
+static UInt64 ReadImm(const Byte* Operand, UInt32 Size) {
+    UInt64 value = 0;
+    for (UInt32 i = 0; i < Size; i++) {
+        value |= UInt64(Operand[i]) << (i * 8);
+    }
+    return value;
+}
+
+static void WriteImm(Vector<Byte>& Code, UInt64 Value, UInt32 Size) {
+    for (UInt32 i = 0; i < Size; i++) {
+        Code.emplace_back(Byte(Value >> (i * 8)));
+    }
+}
+
+bool Decode(const Byte* Code, UInt32 Size, UInt32 Offset, DecodedInstruction& Result) {
+    if (Offset >= Size)
+        return false;
+
+    Byte opcode = Code[Offset];
+    if (opcode >= codefile::OpCodeCount || codefile::InstructionSizes[opcode] == 0)
+        return false;
+
+    Byte size = codefile::InstructionSizes[opcode];
+    if (Size - Offset < size)
+        return false;
+
+    Result = { .Op = codefile::OpCode(opcode), .Offset = Offset, .Size = size };
+
+    const Byte* operands = Code + Offset + 1;
+    switch (InstructionInfos[opcode].Format) {
+    case OperandFormat::None:
+        break;
+    case OperandFormat::Registers:
+        Result.R1 = INST_ARG1(operands[0]);
+        Result.R2 = INST_ARG2(operands[0]);
+        break;
+    case OperandFormat::RegistersImm:
+        Result.R1 = INST_ARG1(operands[0]);
+        Result.R2 = INST_ARG2(operands[0]);
+        Result.Imm = ReadImm(operands + 1, size - 2U);
+        break;
+    case OperandFormat::Imm:
+        Result.Imm = ReadImm(operands, size - 1U);
+        // The displacement of the jumps is sign extended
+        if (Result.IsJump()) {
+            UInt32 shift = 64 - (size - 1U) * 8;
+            Result.Imm = UInt64(Int64(Result.Imm << shift) >> shift);
+        }
+        break;
+    case OperandFormat::Math: {
+        UInt16 word = UInt16(ReadImm(operands, 2));
+        Result.R1 = MATH_DEST(word);
+        Result.R2 = MATH_SRC1(word);
+        Result.R3 = MATH_SRC2(word);
+        break;
+    }
+    case OperandFormat::Array:
+        Result.R1 = INST_ARG1(operands[0]);
+        Result.R2 = INST_ARG2(operands[0]);
+        Result.R3 = INST_ARG1(operands[1]);
+        break;
+    case OperandFormat::Field:
+        Result.R1 = INST_ARG1(operands[0]);
+        Result.R2 = INST_ARG2(operands[0]);
+        Result.Aux = operands[1];
+        Result.Imm = ReadImm(operands + 2, 2);
+        break;
+    }
+
+    return true;
+}
+
+void Encode(const DecodedInstruction& Inst, Vector<Byte>& Code) {
+    Byte size = codefile::InstructionSizes[Byte(Inst.Op)];
+    Byte registers = Byte(Inst.R1 | (Inst.R2 << 4));
+
+    Code.emplace_back(Byte(Inst.Op));
+    switch (InstructionInfos[Byte(Inst.Op)].Format) {
+    case OperandFormat::None:
+        break;
+    case OperandFormat::Registers:
+        Code.emplace_back(registers);
+        break;
+    case OperandFormat::RegistersImm:
+        Code.emplace_back(registers);
+        WriteImm(Code, Inst.Imm, size - 2U);
+        break;
+    case OperandFormat::Imm:
+        WriteImm(Code, Inst.Imm, size - 1U);
+        break;
+    case OperandFormat::Math:
+    case OperandFormat::Array:
+        Code.emplace_back(registers);
+        Code.emplace_back(Inst.R3);
+        break;
+    case OperandFormat::Field:
+        Code.emplace_back(registers);
+        Code.emplace_back(Inst.Aux);
+        WriteImm(Code, Inst.Imm, 2);
+        break;
+    }
+}
+
+}
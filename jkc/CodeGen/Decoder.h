@@ -0,0 +1,64 @@
+#pragma once
+#include <jkr/CodeFile/OpCodes.h>
+#include <jkr/Vector.h>
+
+namespace CodeGen {
+
+// How the operands follow the opcode
+enum class OperandFormat : Byte {
+    None,
+    // A byte with R1 in the low 4 bits and R2 in the high ones
+    Registers,
+    // The registers byte and a immediate in the rest of the instruction
+    RegistersImm,
+    // A immediate in the rest of the instruction
+    Imm,
+    // A word with R1, R2 and R3
+    Math,
+    // The registers byte and a byte with R3
+    Array,
+    // The registers byte, the element in Aux and a 16 bits offset
+    Field,
+};
+
+// The operands that are registers
+enum OperandMask : Byte {
+    OperandR1 = 1 << 0,
+    OperandR2 = 1 << 1,
+    OperandR3 = 1 << 2,
+};
+
+struct InstructionInfo {
+    const char* Mnemonic;
+    OperandFormat Format;
+    // OperandMask of the registers read and written
+    Byte Reads;
+    Byte Writes;
+};
+
+// By opcode, the size of each instruction is codefile::InstructionSizes
+extern const InstructionInfo InstructionInfos[codefile::OpCodeCount];
+
+struct DecodedInstruction {
+    codefile::OpCode Op = codefile::OpCode::Brk;
+    UInt32 Offset = 0;
+    Byte Size = 0;
+    Byte R1 = 0;
+    Byte R2 = 0;
+    Byte R3 = 0;
+    Byte Aux = 0;
+    UInt64 Imm = 0;
+
+    [[nodiscard]] constexpr bool IsJump() const { return codefile::IsJump(Op); }
+    // Offset of the target of a jump, the displacement is sign extended in Imm
+    [[nodiscard]] constexpr UInt32 GetTarget() const { return Offset + Size + UInt32(Imm); }
+    [[nodiscard]] bool Reads(Byte Reg) const;
+    [[nodiscard]] bool Writes(Byte Reg) const;
+};
+
+// Decodes the instruction at Offset, returns false if it's invalid or incomplete
+bool Decode(const Byte* Code, UInt32 Size, UInt32 Offset, DecodedInstruction& Result);
+// Appends the instruction, Offset and Size are ignored
+void Encode(const DecodedInstruction& Inst, Vector<Byte>& Code);
+
+}
@@ -0,0 +1,173 @@
+#include "jkc/CodeGen/Emitter/ConstFold.h"
+#include "jkc/CodeGen/Emitter/EmitterState.h"
+#include "jkc/AST/Statements.h"
+#include "jkc/AST/Expresions.h"
+#include <bit>
+
+namespace CodeGen {
+
+bool FoldBinary(AST::BinaryOperation Op, const AST::TypeDecl& Type, UInt64 A, UInt64 B, UInt64& Result) {
+    if (Type.IsFloat()) {
+        Float64 a = std::bit_cast<Float64>(A);
+        Float64 b = std::bit_cast<Float64>(B);
+        Float64 result = 0.0;
+
+        switch (Op) {
+        case AST::BinaryOperation::Add: result = a + b; break;
+        case AST::BinaryOperation::Sub: result = a - b; break;
+        case AST::BinaryOperation::Mul: result = a * b; break;
+        case AST::BinaryOperation::Div:
+            if (b == 0.0)
+                return false;
+            result = a / b;
+            break;
+        default:
+            return false;
+        }
+
+        Result = std::bit_cast<UInt64>(result);
+        return true;
+    }
+
+    if (!Type.IsInt() && !Type.IsUInt())
+        return false;
+
+    switch (Op) {
+    case AST::BinaryOperation::Add: Result = A + B; break;
+    case AST::BinaryOperation::Sub: Result = A - B; break;
+    case AST::BinaryOperation::Mul: Result = A * B; break;
+    case AST::BinaryOperation::Div:
+        if (B == 0)
+            return false;
+
+        if (Type.IsInt()) {
+            if (Int64(A) == INT64_MIN && Int64(B) == -1)
+                return false;
+            Result = UInt64(Int64(A) / Int64(B));
+        }
+        else {
+            Result = A / B;
+        }
+        break;
+    case AST::BinaryOperation::BinaryAnd: Result = A & B; break;
+    case AST::BinaryOperation::BinaryOr: Result = A | B; break;
+    case AST::BinaryOperation::BinaryXOr: Result = A ^ B; break;
+    // The shifts are unsigned
+    case AST::BinaryOperation::BinaryShl:
+        if (B >= 64)
+            return false;
+        Result = A << B;
+        break;
+    case AST::BinaryOperation::BinaryShr:
+        if (B >= 64)
+            return false;
+        Result = A >> B;
+        break;
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+bool FoldUnary(AST::UnaryOperation Op, const AST::TypeDecl& Type, UInt64 A, UInt64& Result) {
+    if (Type.IsFloat()) {
+        if (Op != AST::UnaryOperation::Negate)
+            return false;
+
+        Result = std::bit_cast<UInt64>(-std::bit_cast<Float64>(A));
+        return true;
+    }
+
+    if (!Type.IsInt() && !Type.IsUInt())
+        return false;
+
+    switch (Op) {
+    case AST::UnaryOperation::Negate:
+        Result = UInt64(0) - A;
+        return true;
+    // Not is bitwise in the virtual machine
+    case AST::UnaryOperation::LogicalNegate:
+    case AST::UnaryOperation::BinaryNAND:
+        Result = ~A;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool FindConstant(SymbolTable<Constant>& Table, Atom Name, Constant& Result) {
+    USize index = Table.Find(Name);
+    if (index == Table.NotFound)
+        return false;
+
+    Result = Table.Get(index);
+    return true;
+}
+
+bool EvaluateConstant(EmitterState& State, AST::Expresion* Expr,
+                      SymbolTable<Constant>* Locals, Constant& Result) {
+    switch (Expr->Type) {
+    case AST::ExpresionType::Constant: {
+        auto constant = (AST::Constant*)Expr;
+        if (!constant->ValueType.IsNumeric())
+            return false;
+
+        Result.Type = constant->ValueType;
+        Result.Unsigned = constant->Unsigned;
+        return true;
+    }
+    case AST::ExpresionType::Identifier: {
+        Atom name = ((AST::Identifier*)Expr)->IDAtom;
+        return (Locals && FindConstant(*Locals, name, Result)) ||
+            FindConstant(State.Constants, name, Result);
+    }
+    case AST::ExpresionType::Group:
+        return EvaluateConstant(State, ((AST::Group*)Expr)->Value, Locals, Result);
+    case AST::ExpresionType::BinaryOp: {
+        auto binOp = (AST::BinaryOp*)Expr;
+        Constant left = {};
+        Constant right = {};
+        if (binOp->Op > AST::BinaryOperation::BinaryShr ||
+            !EvaluateConstant(State, binOp->Left, Locals, left) ||
+            !EvaluateConstant(State, binOp->Right, Locals, right) ||
+            left.Type != right.Type)
+            return false;
+
+        Result.Type = left.Type;
+        return FoldBinary(binOp->Op, left.Type, left.Unsigned, right.Unsigned, Result.Unsigned);
+    }
+    case AST::ExpresionType::Unary: {
+        auto unary = (AST::Unary*)Expr;
+        Constant value = {};
+        if (!EvaluateConstant(State, unary->Value, Locals, value))
+            return false;
+
+        Result.Type = value.Type;
+        return FoldUnary(unary->Op, value.Type, value.Unsigned, Result.Unsigned);
+    }
+    default:
+        return false;
+    }
+}
+
+bool EvaluateConstVal(EmitterState& State, AST::ConstVal* ConstVal,
+                      SymbolTable<Constant>* Locals, Constant& Result) {
+    if (!EvaluateConstant(State, ConstVal->Value, Locals, Result)) {
+        State.Error(ConstVal->Location, u8"A const must to be initialized with a numeric constant expresion");
+        return false;
+    }
+
+    if (Result.Type != ConstVal->ConstType) {
+        State.TypeError(
+            ConstVal->ConstType, Result.Type, ConstVal->Location,
+            u8"You can't initialize a const of type '%s' with a value of type '%s'",
+            ConstVal->ConstType.ToString().c_str(), Result.Type.ToString().c_str()
+        );
+        return false;
+    }
+
+    return true;
+}
+
+}
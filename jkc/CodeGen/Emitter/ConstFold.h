@@ -0,0 +1,29 @@
+#pragma once
+#include "jkc/CodeGen/Values.h"
+#include "jkc/CodeGen/SymbolTable.h"
+
+namespace AST {
+
+struct Expresion;
+struct ConstVal;
+
+}
+
+namespace CodeGen {
+
+struct EmitterState;
+
+// Evaluates the operation like the virtual machine does, returns false
+// if the result can't be known at compile time (a division by zero, a shift too big...)
+bool FoldBinary(AST::BinaryOperation Op, const AST::TypeDecl& Type, UInt64 A, UInt64 B, UInt64& Result);
+bool FoldUnary(AST::UnaryOperation Op, const AST::TypeDecl& Type, UInt64 A, UInt64& Result);
+
+// Evaluates a expresion made of numeric literals and consts,
+// the consts of the function are searched in Locals before the global ones
+bool EvaluateConstant(EmitterState& State, AST::Expresion* Expr,
+                      SymbolTable<Constant>* Locals, Constant& Result);
+// Evaluates the value of a const declaration, reports a error if it isn't a constant of its type
+bool EvaluateConstVal(EmitterState& State, AST::ConstVal* ConstVal,
+                      SymbolTable<Constant>* Locals, Constant& Result);
+
+}
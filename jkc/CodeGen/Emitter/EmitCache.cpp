@@ -0,0 +1,138 @@
+#include "jkc/CodeGen/Emitter/EmitCache.h"
+#include <filesystem>
+#include <fstream>
+
+namespace CodeGen {
+
+// Layout of the file:
+// Magic, Version, Count
+// For each function:
+//   Key, SizeOfCode, CountOfStrings, CountOfSites, CountOfStackLocals, Code
+//   For each string: IP, Size, Data
+//   For each site: IP, Site, Function, IsCall, IsNegated
+
+template<typename T>
+static bool Read(std::ifstream& File, T& Value) {
+    return bool(File.read((char*)&Value, sizeof(T)));
+}
+
+template<typename T>
+static void Write(std::ofstream& File, const T& Value) {
+    File.write((const char*)&Value, sizeof(T));
+}
+
+void EmitCache::Load(const String& Path) {
+    Entries.clear();
+
+    std::ifstream file{ (const char*)Path.c_str(), std::ios::ate | std::ios::binary };
+    if (!file.is_open())
+        return;
+
+    // No size in a valid file can be bigger than the file
+    USize fileSize = USize(file.tellg());
+    file.seekg(0);
+
+    UInt32 magic = 0;
+    UInt32 version = 0;
+    UInt32 count = 0;
+    if (!Read(file, magic) || !Read(file, version) || !Read(file, count) ||
+        magic != Magic || version != Version)
+        return;
+
+    for (UInt32 i = 0; i < count; i++) {
+        UInt64 key = 0;
+        UInt32 sizeOfCode = 0;
+        UInt32 countOfStrings = 0;
+        UInt32 countOfSites = 0;
+        CachedFunction fn = {};
+
+        if (!Read(file, key) || !Read(file, sizeOfCode) || !Read(file, countOfStrings) || !Read(file, countOfSites) ||
+            !Read(file, fn.CountOfStackLocals) || sizeOfCode > fileSize || countOfStrings > fileSize ||
+            countOfSites > fileSize) {
+            Entries.clear();
+            return;
+        }
+
+        fn.Code.resize(sizeOfCode);
+        if (!file.read((char*)fn.Code.data(), sizeOfCode)) {
+            Entries.clear();
+            return;
+        }
+
+        for (UInt32 s = 0; s < countOfStrings; s++) {
+            CachedString& str = fn.Strings.emplace_back();
+            UInt32 size = 0;
+            if (!Read(file, str.IP) || !Read(file, size) ||
+                USize(str.IP) + sizeof(UInt32) > sizeOfCode || size > fileSize) {
+                Entries.clear();
+                return;
+            }
+
+            str.Data.resize(size);
+            if (!file.read((char*)str.Data.data(), size)) {
+                Entries.clear();
+                return;
+            }
+        }
+
+        for (UInt32 s = 0; s < countOfSites; s++) {
+            ProfileSite& site = fn.Sites.emplace_back();
+            if (!Read(file, site.IP) || !Read(file, site.Site) || !Read(file, site.Function) ||
+                !Read(file, site.IsCall) || !Read(file, site.IsNegated) || site.IP >= sizeOfCode) {
+                Entries.clear();
+                return;
+            }
+        }
+
+        Entries.insert_or_assign(key, std::move(fn));
+    }
+}
+
+bool EmitCache::Save(const String& Path) const {
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::path(Path);
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    std::ofstream file{ (const char*)Path.c_str(), std::ios::binary };
+    if (!file.is_open())
+        return false;
+
+    UInt32 count = 0;
+    for (auto& [key, fn] : Entries) {
+        count += fn.Used;
+    }
+
+    Write(file, Magic);
+    Write(file, Version);
+    Write(file, count);
+
+    for (auto& [key, fn] : Entries) {
+        if (!fn.Used)
+            continue;
+
+        Write(file, key);
+        Write(file, UInt32(fn.Code.size()));
+        Write(file, UInt32(fn.Strings.size()));
+        Write(file, UInt32(fn.Sites.size()));
+        Write(file, fn.CountOfStackLocals);
+        file.write((const char*)fn.Code.data(), fn.Code.size());
+
+        for (auto& str : fn.Strings) {
+            Write(file, str.IP);
+            Write(file, UInt32(str.Data.size()));
+            file.write((const char*)str.Data.data(), str.Data.size());
+        }
+
+        for (auto& site : fn.Sites) {
+            Write(file, site.IP);
+            Write(file, site.Site);
+            Write(file, site.Function);
+            Write(file, site.IsCall);
+            Write(file, site.IsNegated);
+        }
+    }
+
+    return bool(file);
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "jkc/CodeGen/Function.h"
+#include <jkr/CoreTypes.h>
+#include <jkr/String.h>
+#include <jkr/Vector.h>
+#include <unordered_map>
+
+namespace CodeGen {
+
+// A string loaded by a cached function, the index in the code is patched
+// with the index of the string in the module that reuses the function
+struct CachedString {
+    UInt32 IP;
+    String Data;
+};
+
+struct CachedFunction {
+    Vector<Byte> Code = {};
+    Vector<CachedString> Strings = {};
+    // The sites don't depend on the module, they are keyed by function of the source
+    Vector<ProfileSite> Sites = {};
+    Byte CountOfStackLocals = 0;
+    // Only the functions used by the last build are saved
+    bool Used = false;
+};
+
+// On disk cache of the emitted functions of a module,
+// a function is keyed by the hash of his body and of the module declarations
+struct EmitCache {
+    static constexpr UInt32 Magic = 0x4343'4B4A; // JKCC
+    // Changed with the emitted code, the old entries are discarded
+    static constexpr UInt32 Version = 9;
+
+    void Clear() { Entries.clear(); }
+
+    // A missing or invalid cache file is a empty cache
+    void Load(const String& Path);
+    bool Save(const String& Path) const;
+
+    const CachedFunction* Find(UInt64 Key) {
+        auto it = Entries.find(Key);
+        if (it == Entries.end())
+            return nullptr;
+
+        it->second.Used = true;
+        return &it->second;
+    }
+
+    void Add(UInt64 Key, CachedFunction&& Fn) {
+        Fn.Used = true;
+        Entries.insert_or_assign(Key, std::move(Fn));
+    }
+
+    std::unordered_map<UInt64, CachedFunction> Entries;
+};
+
+}
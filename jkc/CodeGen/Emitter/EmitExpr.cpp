@@ -1,13 +1,15 @@
 #include "jkc/CodeGen/Emitter/EmitExpr.h"
 #include "jkc/CodeGen/Emitter/EmitStat.h"
 #include "jkc/CodeGen/Emitter/EmitterState.h"
+#include "jkc/CodeGen/Emitter/ConstFold.h"
 #include "jkc/CodeGen/Emitter/EmitExprMacros.h"
 #include "jkc/AST/Expresions.h"
 #include <jkr/Utility.h>
+#include <algorithm>
 
 namespace CodeGen {
 
-TmpValue EmitExpresion(EmitterState& /*State*/, AST::Expresion* Expr) {
+TmpValue EmitExpresion(EmitterState& State, AST::Expresion* Expr) {
     if (Expr->Type == AST::ExpresionType::Constant) {
         auto constant = (AST::Constant*)Expr;
         return TmpValue{
@@ -17,6 +19,15 @@ TmpValue EmitExpresion(EmitterState& /*State*/, AST::Expresion* Expr) {
         };
     }
 
+    Constant value = {};
+    if (EvaluateConstant(State, Expr, nullptr, value)) {
+        return TmpValue{
+            .Ty = TmpType::Constant,
+            .Data = value.Unsigned,
+            .Type = value.Type,
+        };
+    }
+
     return TmpValue(TmpType::Err);
 }
 
@@ -28,7 +39,7 @@ TmpValue EmitFunctionExpresion(EmitterState& State, AST::Expresion* Expr, Functi
         return EmitFunctionIdentifier(State, (AST::Identifier*)Expr, Fn);
     }
     else if (Expr->Type == AST::ExpresionType::Group) {
-        return EmitFunctionExpresion(State, ((AST::Group*)Expr)->Value.get(), Fn);
+        return EmitFunctionExpresion(State, ((AST::Group*)Expr)->Value, Fn);
     }
     else if (Expr->Type == AST::ExpresionType::Call) {
         return EmitFunctionCall(State, (AST::Call*)Expr, Fn);
@@ -80,21 +91,19 @@ TmpValue EmitFunctionConstant(EmitterState& State, AST::Constant* Constant, Func
         }
     }
     else if (Constant->ValueType.IsConstString()) {
-        auto& str = State.Strings.emplace_back(Constant->String.data(), Constant->String.size());
-        tmp.Data = State.Strings.size() - 1;
-        str.Location = Constant->Location;
+        tmp.Data = State.AddLiteral(Constant->String, Constant->Location);
     }
 
     return tmp;
 }
 
 TmpValue EmitFunctionIdentifier(EmitterState& State, AST::Identifier* ID, Function& Fn) {
-    return State.GetID(ID->ID, Fn, ID->Location);
+    return State.GetID(ID, Fn);
 }
 
 TmpValue EmitFunctionCall(EmitterState& State, AST::Call* Call, Function& Fn) {
     TmpValue result = {};
-    Function* target = State.GetFn(Call->Target.get());
+    Function* target = State.GetFn(Call->Target);
     if (target == nullptr) {
         return TmpValue{ TmpType::Err };
     }
@@ -120,7 +129,7 @@ TmpValue EmitFunctionCall(EmitterState& State, AST::Call* Call, Function& Fn) {
     State.Context.IsInCall = true;
     for (Int8 i = target->CountOfArguments; i > 0; i--) {
         TmpValue arg = EmitFunctionExpresion(
-            State, Call->Arguments[static_cast<USize>(i) - 1].get(), Fn
+            State, Call->Arguments[static_cast<USize>(i) - 1], Fn
         );
 
         // Checking uninitialized variables
@@ -164,6 +173,26 @@ TmpValue EmitFunctionCall(EmitterState& State, AST::Call* Call, Function& Fn) {
         return TmpValue(TmpType::Err);
     }
 
+    // The caller drops the arguments, the frame of the callee starts at them
+    if (!target->IsRegisterBased()) {
+        for (Byte i = 0; i < target->StackArguments; i++) {
+            State.CodeAssembler.PopTop(Fn);
+        }
+    }
+
+    // The pops restore r0, the result is moved to a register that isn't restored
+    Byte resultReg = 0;
+    bool isSaved = std::find(usedRegisters.begin(), usedRegisters.end(), Byte(0)) != usedRegisters.end();
+    if (!target->Type.IsVoid() && isSaved) {
+        for (auto& reg : State.Registers) {
+            if (std::find(usedRegisters.begin(), usedRegisters.end(), reg.Index) == usedRegisters.end()) {
+                resultReg = reg.Index;
+                break;
+            }
+        }
+        State.CodeAssembler.Mov(Fn, resultReg, 0);
+    }
+
     if (usedRegisters.size()) {
         Int i = Int(usedRegisters.size());
         while (i > 0) {
@@ -176,16 +205,16 @@ TmpValue EmitFunctionCall(EmitterState& State, AST::Call* Call, Function& Fn) {
     result.Ty = TmpType::Register;
     result.Type = target->Type;
     if (!target->Type.IsVoid()) {
-        State.Registers[0].IsAllocated = true;
-        result.Reg = 0;
+        State.Registers[resultReg].IsAllocated = true;
+        result.Reg = resultReg;
     }
 
     return result;
 }
 
 TmpValue EmitFunctionBinaryOp(EmitterState& State, AST::BinaryOp* BinOp, Function& Fn) {
-    TmpValue left = EmitFunctionExpresion(State, BinOp->Left.get(), Fn);
-    TmpValue right = EmitFunctionExpresion(State, BinOp->Right.get(), Fn);
+    TmpValue left = EmitFunctionExpresion(State, BinOp->Left, Fn);
+    TmpValue right = EmitFunctionExpresion(State, BinOp->Right, Fn);
 
     // Checking uninitialized variables
     if (left.IsFunctionLocal()) {
@@ -206,6 +235,38 @@ TmpValue EmitFunctionBinaryOp(EmitterState& State, AST::BinaryOp* BinOp, Functio
         left.Type.ToString().c_str(), right.Type.ToString().c_str()
     );
 
+    if (BinOp->Op >= AST::BinaryOperation::AddEqual && BinOp->Op <= AST::BinaryOperation::BinaryShrEqual &&
+        left.IsConstant()) {
+        State.Error(BinOp->Location, u8"A const can't be modified");
+        return TmpValue{ TmpType::Err };
+    }
+
+    // The operations between constants are done at compile time
+    if (BinOp->Op <= AST::BinaryOperation::BinaryShr && left.IsConstant() && right.IsConstant() &&
+        left.Type == right.Type) {
+        UInt64 value = 0;
+        if (FoldBinary(BinOp->Op, left.Type, left.Data, right.Data, value)) {
+            result.Data = value;
+            result.LastOp = BinOp->Op;
+            return result;
+        }
+    }
+
+    // The constant of a commutative operation goes to the right, where it can be a immediate
+    switch (BinOp->Op) {
+    case AST::BinaryOperation::Add:
+    case AST::BinaryOperation::Mul:
+    case AST::BinaryOperation::BinaryAnd:
+    case AST::BinaryOperation::BinaryOr:
+    case AST::BinaryOperation::BinaryXOr:
+        if (left.IsConstant() && !right.IsConstant()) {
+            std::swap(left, right);
+        }
+        break;
+    default:
+        break;
+    }
+
     switch (BinOp->Op) {
     case AST::BinaryOperation::Add:
     case AST::BinaryOperation::AddEqual:
@@ -238,8 +299,9 @@ TmpValue EmitFunctionBinaryOp(EmitterState& State, AST::BinaryOp* BinOp, Functio
         if (right.IsConstant() && right.Data == 0) {
             if (left.IsRegister()) {
                 State.CodeAssembler.TestZ(Fn, left.Reg);
+                State.DeallocateRegister(left.Reg);
             }
-            else if (left.IsLocal()) {
+            else if (left.IsLocal() || left.IsGlobal() || left.IsConstant()) {
                 UInt8 tmp = State.AllocateRegister();
                 State.MoveTmp(Fn, tmp, left);
                 State.CodeAssembler.TestZ(Fn, tmp);
@@ -263,7 +325,7 @@ TmpValue EmitFunctionBinaryOp(EmitterState& State, AST::BinaryOp* BinOp, Functio
         if (left.IsRegister() || left.IsLocalReg()) {
             leftReg = left.Reg;
         }
-        else if (left.IsLocal() || left.IsGlobal()) {
+        else if (left.IsLocal() || left.IsGlobal() || left.IsConstant()) {
             leftReg = State.AllocateRegister();
             State.MoveTmp(Fn, leftReg, left);
             State.DeallocateRegister(leftReg);
@@ -276,9 +338,13 @@ TmpValue EmitFunctionBinaryOp(EmitterState& State, AST::BinaryOp* BinOp, Functio
             State.CodeAssembler.FCmp(Fn, leftReg, rightReg);
         }
 
-        if (rightReg != UInt8(-1)) {
+        // The registers of the locals stay allocated, a loop reads them again
+        if (!right.IsLocalReg()) {
             State.DeallocateRegister(rightReg);
         }
+        if (left.IsRegister()) {
+            State.DeallocateRegister(left.Reg);
+        }
     }
     break;
     default:
@@ -364,10 +430,11 @@ TmpValue EmitBinaryOp(EmitterState& State, TmpValue& Left, TmpValue& Right, AST:
         }
     }
     else {
+        // The result can be in the register where the left operand was loaded
         if (Left.IsRegister() && result.Reg != Left.Reg) {
             State.DeallocateRegister(Left.Reg);
         }
-        else if (!Left.IsLocalReg() && !Left.IsRegister()) {
+        else if (!Left.IsLocalReg() && !Left.IsRegister() && result.Reg != leftReg) {
             State.DeallocateRegister(leftReg);
         }
     }
@@ -376,7 +443,7 @@ TmpValue EmitBinaryOp(EmitterState& State, TmpValue& Left, TmpValue& Right, AST:
 }
 
 TmpValue EmitFunctionUnary(EmitterState& State, AST::Unary* Unary, Function& Fn) {
-    TmpValue tmp = EmitFunctionExpresion(State, Unary->Value.get(), Fn);
+    TmpValue tmp = EmitFunctionExpresion(State, Unary->Value, Fn);
     if (tmp.IsErr()) {
         return TmpValue{ TmpType::Err };
     }
@@ -389,6 +456,12 @@ TmpValue EmitFunctionUnary(EmitterState& State, AST::Unary* Unary, Function& Fn)
         CHECK_UNINITIALIZED_LOCAL(Fn.Locals.Get(tmp.Index), Unary->Location);
     }
 
+    UInt64 value = 0;
+    if (tmp.IsConstant() && FoldUnary(Unary->Op, tmp.Type, tmp.Data, value)) {
+        tmp.Data = value;
+        return tmp;
+    }
+
     if (tmp.IsLocalReg() || tmp.IsRegister()) {
         if (tmp.IsRegister()) {
             result.Reg = tmp.Reg;
@@ -425,7 +498,128 @@ TmpValue EmitFunctionUnary(EmitterState& State, AST::Unary* Unary, Function& Fn)
     return tmp;
 }
 
-TmpValue EmitFunctionDot(EmitterState& /*State*/, AST::Dot* /*Dot*/, Function& /*Fn*/) {
+static Field* EmitFieldAddress(EmitterState& State, AST::Dot* Dot, Function& Fn, 
+                               TmpValue& Object, Byte& ObjectReg) {
+    Object = EmitFunctionExpresion(State, Dot->Left, Fn);
+    if (Object.IsErr() || !Dot->Right) {
+        return nullptr;
+    }
+
+    // Checking uninitialized variables
+    if (Object.IsFunctionLocal()) {
+        CHECK_UNINITIALIZED_LOCAL(Fn.Locals.Get(Object.Index), Dot->Location);
+    }
+
+    Struct* _struct = State.GetStruct(Object.Type, Dot->Location);
+    if (_struct == nullptr) {
+        return nullptr;
+    }
+
+    auto id = (AST::Identifier*)Dot->Right;
+    USize index = _struct->Fields.Find(id->IDAtom);
+    if (index == _struct->Fields.NotFound) {
+        State.Error(id->Location,
+            u8"'%.*s' has no field named '%.*s'",
+            (int)_struct->Name.size(), _struct->Name.data(),
+            (int)id->ID.size(), id->ID.data()
+        );
+        return nullptr;
+    }
+
+    if (Object.IsRegister() || Object.IsLocalReg()) {
+        ObjectReg = Object.Reg;
+    }
+    else {
+        ObjectReg = State.AllocateRegister();
+        State.MoveTmp(Fn, ObjectReg, Object);
+    }
+
+    return &_struct->Fields.Get(index);
+}
+
+TmpValue EmitFunctionDot(EmitterState& State, AST::Dot* Dot, Function& Fn) {
+    TmpValue object = {};
+    Byte objectReg = Byte(-1);
+    Field* field = EmitFieldAddress(State, Dot, Fn, object, objectReg);
+    if (field == nullptr) {
+        return TmpValue(TmpType::Err);
+    }
+
+    // The object register is reused as destination when it's a temporary
+    Byte dest = objectReg;
+    if (object.IsLocalReg()) {
+        dest = State.AllocateRegister();
+    }
+
+    State.CodeAssembler.LoadField(
+        Fn, dest, objectReg,
+        State.TypeToArrayElement(field->Type), field->Offset
+    );
+
+    return TmpValue{
+        .Ty = TmpType::Register,
+        .Reg = dest,
+        .Type = field->Type,
+    };
+}
+
+static TmpValue EmitFieldAssignment(EmitterState& State, AST::Dot* Dot, AST::Assignment* Assignment, Function& Fn) {
+    TmpValue object = {};
+    Byte objectReg = Byte(-1);
+    Field* field = EmitFieldAddress(State, Dot, Fn, object, objectReg);
+    if (field == nullptr) {
+        return TmpValue(TmpType::Err);
+    }
+
+    TmpValue source = EmitFunctionExpresion(State, Assignment->Source, Fn);
+    if (source.IsErr()) {
+        return TmpValue(TmpType::Err);
+    }
+
+    if (source.IsFunctionLocal()) {
+        CHECK_UNINITIALIZED_LOCAL(Fn.Locals.Get(source.Index), Assignment->Location);
+    }
+
+    // There are no byte literals, a integer constant is stored in a Byte field if it fits
+    if (field->Type.IsByte() && source.IsConstant() && (source.Type.IsInt() || source.Type.IsUInt())) {
+        if (source.Data > 0xFF) {
+            State.Error(Assignment->Location, u8"The value doesn't fit in a field of type 'Byte'");
+            return TmpValue(TmpType::Err);
+        }
+        source.Type = field->Type;
+    }
+
+    State.TypeError(
+        field->Type, source.Type, Assignment->Location,
+        u8"You can't assign a value of type '%s' to a field of type '%s'",
+        source.Type.ToString().c_str(), field->Type.ToString().c_str()
+    );
+
+    Byte sourceReg = Byte(-1);
+    if (source.IsLocalReg() || source.IsRegister()) {
+        sourceReg = source.Reg;
+    }
+    else if (source.IsArrayExpr()) {
+        State.Error(Assignment->Location, u8"Invalid assignment");
+        return TmpValue(TmpType::Err);
+    }
+    else {
+        sourceReg = State.AllocateRegister();
+        State.MoveTmp(Fn, sourceReg, source);
+    }
+
+    State.CodeAssembler.StoreField(
+        Fn, sourceReg, objectReg,
+        State.TypeToArrayElement(field->Type), field->Offset
+    );
+
+    if (!source.IsLocalReg()) {
+        State.DeallocateRegister(sourceReg);
+    }
+    if (!object.IsLocalReg()) {
+        State.DeallocateRegister(objectReg);
+    }
+
     return TmpValue();
 }
 
@@ -438,15 +632,15 @@ TmpValue EmitFunctionArrayList(EmitterState& /*State*/, AST::ArrayList* ArrayLis
 
 TmpValue EmitFunctionBlock(EmitterState& State, AST::Block* Block, Function& Fn) {
     for (auto& stat : Block->Statements) {
-        EmitFunctionStatement(State, stat.get(), Fn);
+        EmitFunctionStatement(State, stat, Fn);
     }
 
     return TmpValue();
 }
 
 TmpValue EmitFunctionArrayAccess(EmitterState& State, AST::ArrayAccess* ArrayAccess, Function& Fn) {
-    TmpValue toIndex = EmitFunctionExpresion(State, ArrayAccess->Expr.get(), Fn);
-    TmpValue index = EmitFunctionExpresion(State, ArrayAccess->IndexExpr.get(), Fn);
+    TmpValue toIndex = EmitFunctionExpresion(State, ArrayAccess->Expr, Fn);
+    TmpValue index = EmitFunctionExpresion(State, ArrayAccess->IndexExpr, Fn);
     if (toIndex.IsErr() || index.IsErr()) {
         return TmpValue(TmpType::Err);
     }
@@ -521,7 +715,7 @@ TmpValue EmitFunctionArrayAccess(EmitterState& State, AST::ArrayAccess* ArrayAcc
 }
 
 TmpValue EmitFunctionIncDec(EmitterState& State, AST::IncDec* IncDec, Function& Fn) {
-    TmpValue tmp = EmitFunctionExpresion(State, IncDec->Expr.get(), Fn);
+    TmpValue tmp = EmitFunctionExpresion(State, IncDec->Expr, Fn);
     if (tmp.IsErr()) {
         return TmpValue(TmpType::Err);
     }
@@ -609,54 +803,77 @@ TmpValue EmitFunctionIncDec(EmitterState& State, AST::IncDec* IncDec, Function&
         }
     }
 
-    State.DeallocateRegister(reg);
+    // The register of a local is released after its last use
+    if (!tmp.IsLocalReg()) {
+        State.DeallocateRegister(reg);
+    }
 
     return result;
 }
 
 TmpValue EmitFunctionAssignment(EmitterState& State, AST::Assignment* Assignment, Function& Fn) {
-    TmpValue target = EmitFunctionExpresion(State, Assignment->Target.get(), Fn);
-    TmpValue source = EmitFunctionExpresion(State, Assignment->Source.get(), Fn);
+    if (Assignment->Target->Type == AST::ExpresionType::Dot) {
+        return EmitFieldAssignment(State, (AST::Dot*)Assignment->Target, Assignment, Fn);
+    }
+
+    TmpValue target = EmitFunctionExpresion(State, Assignment->Target, Fn);
+    TmpValue source = EmitFunctionExpresion(State, Assignment->Source, Fn);
     if (target.IsErr() || source.IsErr()) {
         return TmpValue(TmpType::Err);
     }
 
+    if (target.IsConstant()) {
+        State.Error(Assignment->Location, u8"A const can't be modified");
+        return TmpValue(TmpType::Err);
+    }
+
     if (source.IsFunctionLocal()) {
         CHECK_UNINITIALIZED_LOCAL(Fn.Locals.Get(source.Index), Assignment->Location);
+        CHECK_OWNED_OBJECT(Fn.Locals.Get(source.Index), Assignment->Location);
     }
 
     if (target.IsFunctionLocal()) {
+        // The old object would leak, it's only destroyed through its var
+        if (Fn.Locals.Get(target.Index).OwnsObject) {
+            State.Error(Assignment->Location, u8"A var that owns a object can't be assigned");
+            return TmpValue(TmpType::Err);
+        }
         Fn.Locals.Get(target.Index).IsInitialized = true;
     }
 
-    Byte sourceReg = Byte(-1);
-    if (source.IsLocalReg() || source.IsRegister()) {
-        sourceReg = source.Reg;
-    }
-    else if (source.IsArrayExpr()) {
+    if (source.IsArrayExpr()) {
         State.Error(Assignment->Location, u8"Invalid assignment");
         return TmpValue(TmpType::Err);
     }
-    else if (source.IsConstant() && target.IsLocalReg()) {
+
+    if (source.IsConstant() && target.IsLocalReg()) {
         State.MoveTmp(Fn, target.Reg, source);
+        return target;
+    }
+
+    // A value in a register is stored from it, the others are loaded in a temporary
+    Byte sourceReg = Byte(-1);
+    bool isTemporary = !source.IsLocalReg();
+    if (source.IsLocalReg() || source.IsRegister()) {
+        sourceReg = source.Reg;
     }
     else {
         sourceReg = State.AllocateRegister();
         State.MoveTmp(Fn, sourceReg, source);
+    }
 
-        if (target.IsLocalReg()) {
-            State.CodeAssembler.Mov(Fn, target.Reg, sourceReg);
-        }
-        else if (target.IsLocal()) {
-            State.CodeAssembler.LocalSet(Fn, sourceReg, target.Local);
-        }
-        else if (target.IsGlobal()) {
-            State.CodeAssembler.GlobalSet(Fn, sourceReg, target.Global);
-        }
+    if (target.IsLocalReg()) {
+        State.CodeAssembler.Mov(Fn, target.Reg, sourceReg);
+    }
+    else if (target.IsLocal()) {
+        State.CodeAssembler.LocalSet(Fn, sourceReg, target.Local);
+    }
+    else if (target.IsGlobal()) {
+        State.CodeAssembler.GlobalSet(Fn, sourceReg, target.Global);
+    }
 
-        if (sourceReg != Byte(-1)) {
-            State.DeallocateRegister(sourceReg);
-        }
+    if (isTemporary) {
+        State.DeallocateRegister(sourceReg);
     }
 
     return target;
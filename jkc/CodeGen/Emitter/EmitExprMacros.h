@@ -11,6 +11,15 @@
         State.CodeAssembler.F##Function(Fn, __VA_ARGS__);\
     }
 
+// The immediates of the signed operations are sign extended
+#define MAKE_IMM_OP(Type, Function, ...) \
+    if(Type.IsInt()) {\
+        State.CodeAssembler.I##Function(Fn, __VA_ARGS__);\
+    }\
+    else {\
+        State.CodeAssembler.##Function(Fn, __VA_ARGS__);\
+    }
+
 #define MAKE_CASE(Case) \
     if(Op == AST::BinaryOperation::Case || Op == AST::BinaryOperation::Case##Equal){\
         if(Right.IsRegister()) {\
@@ -34,11 +43,11 @@
                 }\
                 MAKE_OP(Right.Type, Inc, result.Reg);\
             }\
-            else if (Right.Data <= ByteMax) {\
-                State.CodeAssembler.##Case##8(Fn, result.Reg, leftReg, Byte(Right.Data));\
+            else if (!Right.Type.IsFloat() && Right.Data <= (Right.Type.IsInt() ? 0x7FU : ByteMax)) {\
+                MAKE_IMM_OP(Right.Type, Case##8, result.Reg, leftReg, Byte(Right.Data));\
             }\
-            else if (Right.Data <= Const16Max) {\
-                State.CodeAssembler.##Case##16(Fn, result.Reg, leftReg, UInt16(Right.Data));\
+            else if (!Right.Type.IsFloat() && Right.Data <= (Right.Type.IsInt() ? 0x7FFFU : Const16Max)) {\
+                MAKE_IMM_OP(Right.Type, Case##16, result.Reg, leftReg, UInt16(Right.Data));\
             }\
             else {\
                 Byte tmp = State.AllocateRegister();\
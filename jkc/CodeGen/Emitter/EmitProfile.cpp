@@ -0,0 +1,69 @@
+#include "jkc/CodeGen/Emitter/EmitProfile.h"
+#include "jkc/AST/Statements.h"
+#include "jkc/Hash.h"
+#include <jkr/CodeFile/Profile.h>
+#include <fstream>
+
+namespace CodeGen {
+
+// The values are hashed as they are read
+struct ProfileReader {
+    template<typename T>
+    bool Read(T& Value) {
+        if (!File.read((char*)&Value, sizeof(T)))
+            return false;
+
+        Hash = HashValue(Hash, Value);
+        return true;
+    }
+
+    std::ifstream& File;
+    UInt64 Hash = HashSeed;
+};
+
+void EmitProfile::Clear() {
+    Hash = 0;
+    Sites.clear();
+}
+
+bool EmitProfile::Load(const String& Path) {
+    Clear();
+
+    std::ifstream file{ (const char*)Path.c_str(), std::ios::ate | std::ios::binary };
+    if (!file.is_open())
+        return false;
+
+    // No count of entries in a valid file can be bigger than the file
+    USize fileSize = USize(file.tellg());
+    file.seekg(0);
+
+    ProfileReader reader{ .File = file };
+    UInt32 magic = 0;
+    UInt32 version = 0;
+    UInt32 count = 0;
+    if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(count) ||
+        magic != codefile::ProfileMagic || version != codefile::ProfileVersion || count > fileSize)
+        return false;
+
+    for (UInt32 i = 0; i < count; i++) {
+        UInt64 function = 0;
+        UInt32 site = 0;
+        SiteCounts counts = {};
+        if (!reader.Read(function) || !reader.Read(site) ||
+            !reader.Read(counts.Counts[0]) || !reader.Read(counts.Counts[1])) {
+            Clear();
+            return false;
+        }
+        Sites.insert_or_assign({ function, site }, counts);
+    }
+
+    Hash = reader.Hash;
+    return true;
+}
+
+UInt64 EmitProfile::GetFunctionKey(const AST::Function* ASTFn) {
+    UInt64 key = HashValue(HashSeed, ASTFn->BodyHash);
+    return HashBytes(key, ASTFn->Name.data(), ASTFn->Name.size());
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <jkr/CoreTypes.h>
+#include <jkr/String.h>
+#include <map>
+
+namespace AST {
+
+struct Function;
+
+}
+
+namespace CodeGen {
+
+// Counts of a condition or a call of the source, summed over all its copies in the code
+struct SiteCounts {
+    // Condition: times it was true and false, Call: times it was made in the first one
+    UInt64 Counts[2] = {};
+};
+
+// Profile written by the virtual machine for a previous build of the module.
+// The counts are by function of the source and ordinal of the site in it,
+// so they are looked up while the function is built
+struct EmitProfile {
+    void Clear();
+
+    // Returns false if the file is missing or invalid
+    bool Load(const String& Path);
+
+    // Key of the function in the profile, it doesn't depend on the options
+    // so the profile of any build of the same function applies
+    [[nodiscard]] static UInt64 GetFunctionKey(const AST::Function* ASTFn);
+
+    [[nodiscard]] bool IsLoaded() const { return !Sites.empty(); }
+    // nullptr if the site wasn't in the profiled code
+    [[nodiscard]] const SiteCounts* Find(UInt64 Function, UInt32 Site) const {
+        auto it = Sites.find({ Function, Site });
+        return it == Sites.end() ? nullptr : &it->second;
+    }
+    // Times the function was called, 0 if it wasn't profiled
+    [[nodiscard]] UInt64 GetCalls(UInt64 Function) const {
+        const SiteCounts* counts = Find(Function, 0);
+        return counts ? counts->Counts[0] : 0;
+    }
+
+    // Hash of the counts, part of the cache key of the module
+    UInt64 Hash = 0;
+    // By key of the function and ordinal of the site, the site 0 is the function
+    std::map<std::pair<UInt64, UInt32>, SiteCounts> Sites;
+};
+
+}
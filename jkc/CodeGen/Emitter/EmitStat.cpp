@@ -1,15 +1,21 @@
 #include "jkc/CodeGen/Emitter/EmitStat.h"
 #include "jkc/CodeGen/Emitter/EmitExpr.h"
 #include "jkc/CodeGen/Emitter/EmitterState.h"
+#include "jkc/CodeGen/Emitter/ConstFold.h"
+#include "jkc/CodeGen/Emitter/RegisterAllocator.h"
 #include "jkc/AST/Statements.h"
 #include "jkc/AST/Expresions.h"
+#include "jkc/IR/Builder.h"
+#include "jkc/IR/Inliner.h"
+#include "jkc/IR/Lowering.h"
+#include "jkc/IR/PassManager.h"
 #include <jkr/Utility.h>
 
 namespace CodeGen {
 
 void EmitProgramStatements(EmitterState& State, AST::Program& Program) {
     for (auto& stat : Program.Statements) {
-        EmitStatement(State, stat.get());
+        EmitStatement(State, stat);
     }
 }
 
@@ -20,47 +26,70 @@ void EmitStatement(EmitterState& State, AST::Statement* Stat) {
     else if (Stat->Type == AST::StatementType::Var) {
         EmitVar(State, (AST::Var*)Stat);
     }
-    else if (Stat->Type == AST::StatementType::ConstVal) {
-        EmitConstVal(State, (AST::ConstVal*)Stat);
+}
+
+// The functions that the IR can represent are optimized on it, the rest are emitted from the AST
+static bool EmitFunctionFromIR(EmitterState& State, AST::Function* ASTFn, Function& Fn) {
+    IR::Function irFn = {};
+    if (!IR::BuildFunction(State, ASTFn, Fn, irFn))
+        return false;
+
+    if (State.FunctionInliner) {
+        State.FunctionInliner->Run(irFn, Fn.Address);
     }
+
+    IR::PassManager passes{ State.CurrentOptions.OptimizationLevel };
+    passes.Run(irFn);
+    return IR::LowerFunction(State, irFn, Fn);
 }
 
 void EmitFunction(EmitterState& State, AST::Function* ASTFn) {
     if (!ASTFn->IsDefined && !ASTFn->IsExtern)
         return;
 
-    auto& fn = State.Functions.Get(State.Functions.Find(ASTFn->Name)->second);
+    auto& fn = State.Functions.Get(State.Functions.Find(ASTFn->NameAtom));
 
     if (ASTFn->IsDefined) {
+        fn.ProfileKey = EmitProfile::GetFunctionKey(ASTFn);
+
+        UInt64 cacheKey = 0;
+        if (State.IsCacheEnabled()) {
+            cacheKey = State.GetFunctionKey(ASTFn);
+            if (State.ReuseFunction(cacheKey, fn))
+                return;
+        }
+
+        if (State.CurrentOptions.OptimizationLevel != OPTIMIZATION_NONE && EmitFunctionFromIR(State, ASTFn, fn)) {
+            if (State.IsCacheEnabled() && State.Success) {
+                State.CacheFunction(cacheKey, fn);
+            }
+            return;
+        }
+
         // Prologue
+        fn.ReturnLabel = State.CodeAssembler.CreateLabel(fn);
         if (fn.RegisterArguments) {
             for (Byte i = 1; i <= fn.RegisterArguments; i++)
                 State.Registers[i].IsAllocated = true;
         }
 
+        if (State.CurrentOptions.OptimizationLevel == OPTIMIZATION_RELEASE_FAST) {
+            AllocateRegisters(State, ASTFn, fn);
+        }
+
         {
             UInt32 i = 0;
             for (auto& stat : ASTFn->Body->Statements) {
                 if ((static_cast<unsigned long long>(i) + 1) == ASTFn->Body->Statements.size()) {
                     State.Context.IsLast = true;
                 }
-                EmitFunctionStatement(State, stat.get(), fn);
+                EmitFunctionStatement(State, stat, fn);
                 State.Context.IsLast = false;
                 i++;
             }
         }
 
-        for (auto& toResolve : fn.ResolveReturns) {
-            UInt16 address = UInt16(fn.Code.Buff.size() - (toResolve.IP + 2));
-            if (address <= Const16Max) {
-                UInt16& jmp = *(UInt16*)&fn.Code.Buff[toResolve.IP];
-                jmp = address;
-            }
-            else {
-                State.Error(ASTFn->Location, u8"Code too long");
-                return;
-            }
-        }
+        State.CodeAssembler.BindLabel(fn, fn.ReturnLabel);
 
         // Epilogue
         Byte deleter = State.AllocateRegister();
@@ -79,36 +108,48 @@ void EmitFunction(EmitterState& State, AST::Function* ASTFn) {
                     State.CodeAssembler.ArrayDestroy(fn, deleter);
                 }
             }
+            else if (local.OwnsObject) {
+                if (local.IsRegister) {
+                    State.CodeAssembler.ObjectDestroy(fn, local.Reg);
+                }
+                else {
+                    State.CodeAssembler.LocalGet(fn, deleter, local.Index);
+                    State.CodeAssembler.ObjectDestroy(fn, deleter);
+                }
+            }
         }
         State.DeallocateRegister(deleter);
 
         State.CodeAssembler.Ret(fn);
+        State.CodeAssembler.ResolveLabels(fn);
 
         if (fn.RegisterArguments) {
             for (Int16 i = 1; i <= fn.RegisterArguments; i++)
                 State.Registers[i].IsAllocated = false;
         }
+        ReleaseRegisters(State);
+
+        if (State.IsCacheEnabled() && State.Success) {
+            State.CacheFunction(cacheKey, fn);
+        }
     }
 }
 
 void EmitVar(EmitterState& State, AST::Var* Var) {
-    auto& global = State.Globals.Get(State.Globals.Find(Var->Name)->second);
+    auto& global = State.Globals.Get(State.Globals.Find(Var->NameAtom));
 
     if (Var->Value) {
-        if (Var->Value->Type != AST::ExpresionType::Constant &&
-            Var->Value->Type != AST::ExpresionType::ArrayList) {
-            State.Error(Var->Location, u8"A global must to be initialized with a constant");
-            return;
-        }
-
-        TmpValue tmp = EmitExpresion(State, Var->Value.get());
+        TmpValue tmp = EmitExpresion(State, Var->Value);
         if (tmp.IsErr()) {
+            if (Var->Value->Type != AST::ExpresionType::ArrayList) {
+                State.Error(Var->Location, u8"A global must to be initialized with a constant");
+            }
             return;
         }
         else if (global.Type.IsUnknown()) {
             global.Type = tmp.Type;
         }
-        else {
+        else if (global.Type != tmp.Type) {
             State.TypeError(
                 global.Type, tmp.Type,
                 Var->Location,
@@ -124,9 +165,9 @@ void EmitVar(EmitterState& State, AST::Var* Var) {
     }
 }
 
-void EmitConstVal(EmitterState& /*State*/, AST::ConstVal* /*ConstVal*/) {}
-
 void EmitFunctionStatement(EmitterState& State, AST::Statement* Stat, Function& Fn) {
+    AdvanceRegisters(State);
+
     if (Stat->Type == AST::StatementType::Return) {
         EmitFunctionReturn(State, (AST::Return*)Stat, Fn);
     }
@@ -139,8 +180,14 @@ void EmitFunctionStatement(EmitterState& State, AST::Statement* Stat, Function&
     else if (Stat->Type == AST::StatementType::If) {
         EmitFunctionIf(State, (AST::If*)Stat, Fn);
     }
+    else if (Stat->Type == AST::StatementType::While) {
+        EmitFunctionWhile(State, (AST::While*)Stat, Fn);
+    }
+    else if (Stat->Type == AST::StatementType::For) {
+        EmitFunctionFor(State, (AST::For*)Stat, Fn);
+    }
     else if (Stat->Type == AST::StatementType::ExpresionStatement) {
-        TmpValue tmp = EmitFunctionExpresion(State, ((AST::ExpresionStatement*)Stat)->Value.get(), Fn);
+        TmpValue tmp = EmitFunctionExpresion(State, ((AST::ExpresionStatement*)Stat)->Value, Fn);
         if (tmp.IsRegister()) {
             State.DeallocateRegister(tmp.Reg);
         }
@@ -150,12 +197,18 @@ void EmitFunctionStatement(EmitterState& State, AST::Statement* Stat, Function&
 void EmitFunctionReturn(EmitterState& State, AST::Return* Ret, Function& Fn) {
     if (Ret->Value) {
         State.Context.IsInReturn = true;
-        TmpValue tmp = EmitFunctionExpresion(State, Ret->Value.get(), Fn);
+        TmpValue tmp = EmitFunctionExpresion(State, Ret->Value, Fn);
         State.Context.IsInReturn = false;
 
         if (tmp.IsErr()) {
             return;
         }
+
+        // The object is moved to the caller
+        if (tmp.IsFunctionLocal()) {
+            Fn.Locals.Get(tmp.Index).OwnsObject = false;
+        }
+
         State.TypeError(
             Fn.Type, tmp.Type, Ret->Location,
             u8"Invalid conversion from '%s' to '%s'",
@@ -172,10 +225,10 @@ void EmitFunctionReturn(EmitterState& State, AST::Return* Ret, Function& Fn) {
             State.CodeAssembler.LocalGet(Fn, 0, tmp.Local);
         }
         else if (tmp.IsLocalReg()) {
+            // The local keeps its register until its last use
             if (tmp.Reg != 0) {
                 State.CodeAssembler.Mov(Fn, 0, tmp.Reg);
             }
-            State.DeallocateRegister(tmp.Reg);
         }
         else if (tmp.IsGlobal()) {
                 State.CodeAssembler.GlobalGet(Fn, 0, tmp.Global);
@@ -184,50 +237,34 @@ void EmitFunctionReturn(EmitterState& State, AST::Return* Ret, Function& Fn) {
             State.MoveTmp(Fn, 0, tmp);
         }
 
-        if (Fn.HasMultiReturn && (!State.Context.IsLast || (State.Context.IsInIf && !State.Context.IsInElse))) {
-            State.CodeAssembler.Jmp(Fn, codefile::OpCode::Jmp, 0);
-            auto& toResolve = Fn.ResolveReturns.emplace_back();
-            toResolve.IP = UInt32(Fn.Code.Buff.size() - 2);
+        // The code after a loop is never the end of the function
+        if (State.Context.IsInLoop ||
+            (Fn.HasMultiReturn && (!State.Context.IsLast || (State.Context.IsInIf && !State.Context.IsInElse)))) {
+            State.CodeAssembler.Jump(Fn, codefile::OpCode::Jmp, Fn.ReturnLabel);
         }
     }
 }
 
 void EmitFunctionLocal(EmitterState& State, AST::Var* Var, Function& Fn) {
-    {
-        auto it = Fn.Locals.Find(Var->Name);
-        if (it != Fn.Locals.end()) {
-            State.Error(Var->Location, u8"'%s' is already defined", Var->Name.c_str());
-            return;
-        }
+    if (Fn.Locals.Find(Var->NameAtom) != Fn.Locals.NotFound ||
+        Fn.Constants.Find(Var->NameAtom) != Fn.Constants.NotFound) {
+        State.Error(Var->Location, u8"'%.*s' is already defined", (int)Var->Name.size(), Var->Name.data());
+        return;
     }
 
-    {
-        auto it = State.Globals.Find(Var->Name);
-        if (it != State.Globals.end()) {
-            State.Error(Var->Location, u8"'%s' is shadowing a variable", Var->Name.c_str());
-            return;
-        }
+    if (State.Globals.Find(Var->NameAtom) != State.Globals.NotFound ||
+        State.Constants.Find(Var->NameAtom) != State.Constants.NotFound) {
+        State.Error(Var->Location, u8"'%.*s' is shadowing a variable", (int)Var->Name.size(), Var->Name.data());
+        return;
     }
 
-    auto& local = Fn.Locals.Add(Var->Name);
+    auto& local = Fn.Locals.Add(Var->NameAtom);
     local.Type = Var->VarType;
 
-    if (State.CurrentOptions.OptimizationLevel == OPTIMIZATION_RELEASE_FAST) {
-        for (auto& reg : State.Registers) {
-            if ((reg.Index >= 1 
-                && reg.Index <= 10)
-                && !reg.IsAllocated) {
-                reg.IsAllocated = true;
-                local.Index = reg.Index;
-                local.IsRegister = true;
-                break;
-            }
-        }
-
-        if (!local.IsRegister) {
-            local.Index = Fn.CountOfStackLocals++;
-            local.IsRegister = false;
-        }
+    Byte reg = 0;
+    if (ClaimRegister(State, Var->NameAtom, reg)) {
+        local.Reg = reg;
+        local.IsRegister = true;
     }
     else {
         local.Index = Fn.CountOfStackLocals++;
@@ -258,6 +295,22 @@ void EmitFunctionLocal(EmitterState& State, AST::Var* Var, Function& Fn) {
                 local.IsInitialized = true;
             }
         }
+        else if (Var->VarType.IsStruct()) {
+            Struct* _struct = State.GetStruct(Var->VarType, Var->Location);
+            if (_struct == nullptr) {
+                return;
+            }
+
+            Byte dest = local.IsRegister ? local.Reg : State.AllocateRegister();
+            State.CodeAssembler.ObjectNew(Fn, dest, _struct->Size);
+            if (!local.IsRegister) {
+                State.CodeAssembler.LocalSet(Fn, dest, local.Index);
+                State.DeallocateRegister(dest);
+            }
+
+            local.IsInitialized = true;
+            local.OwnsObject = true;
+        }
         else {
             local.IsInitialized = false;
         }
@@ -265,11 +318,15 @@ void EmitFunctionLocal(EmitterState& State, AST::Var* Var, Function& Fn) {
     else {
         local.IsInitialized = true;
 
-        TmpValue tmp = EmitFunctionExpresion(State, Var->Value.get(), Fn);
+        TmpValue tmp = EmitFunctionExpresion(State, Var->Value, Fn);
         if (tmp.IsErr()) {
             return;
         }
 
+        if (tmp.IsFunctionLocal()) {
+            CHECK_OWNED_OBJECT(Fn.Locals.Get(tmp.Index), Var->Location);
+        }
+
         if (local.Type.IsUnknown()) {
             local.Type = tmp.Type;
         }
@@ -289,6 +346,7 @@ void EmitFunctionLocal(EmitterState& State, AST::Var* Var, Function& Fn) {
         if (tmp.IsRegister()) {
             if (local.IsRegister) {
                 State.CodeAssembler.Mov(Fn, local.Index, tmp.Reg);
+                State.DeallocateRegister(tmp.Reg);
             }
             else {
                 State.CodeAssembler.LocalSet(Fn, tmp.Reg, local.Index);
@@ -340,7 +398,7 @@ void EmitFunctionLocal(EmitterState& State, AST::Var* Var, Function& Fn) {
             elementType.Flags ^= AST::TypeDecl::Array;
             elementType.ArrayLen = 0;
             for (auto& element : arr->Elements) {
-                TmpValue tmpE = EmitFunctionExpresion(State, element.get(), Fn);
+                TmpValue tmpE = EmitFunctionExpresion(State, element, Fn);
 
                 if (requiredType) {
                     elementType = tmpE.Type;
@@ -399,64 +457,149 @@ void EmitFunctionLocal(EmitterState& State, AST::Var* Var, Function& Fn) {
     }
 }
 
-void EmitFunctionConstVal(EmitterState& /*State*/, AST::ConstVal* /*ConstVal*/, Function& /*Fn*/) {}
-
-void EmitFunctionIf(EmitterState& State, AST::If* _If, Function& Fn) {
-    State.Context.IsInIf = true;
+void EmitFunctionConstVal(EmitterState& State, AST::ConstVal* ConstVal, Function& Fn) {
+    if (Fn.Locals.Find(ConstVal->NameAtom) != Fn.Locals.NotFound ||
+        Fn.Constants.Find(ConstVal->NameAtom) != Fn.Constants.NotFound) {
+        State.Error(ConstVal->Location, u8"'%.*s' is already defined", (int)ConstVal->Name.size(), ConstVal->Name.data());
+        return;
+    }
 
-    TmpValue result = EmitFunctionExpresion(State, _If->Expr.get(), Fn);
-    if (result.IsErr()) {
+    if (State.Globals.Find(ConstVal->NameAtom) != State.Globals.NotFound ||
+        State.Constants.Find(ConstVal->NameAtom) != State.Constants.NotFound) {
+        State.Error(ConstVal->Location, u8"'%.*s' is shadowing a variable", (int)ConstVal->Name.size(), ConstVal->Name.data());
         return;
     }
 
-    codefile::OpCode opcode = codefile::OpCode::Jmp;
-    switch (result.LastOp) {
-    case AST::BinaryOperation::Comparision:
-        opcode = codefile::OpCode::Jne;
-        break;
-    case AST::BinaryOperation::NotEqual:
-        opcode = codefile::OpCode::Je;
-        break;
-    case AST::BinaryOperation::Less:
-        opcode = codefile::OpCode::Jge;
-        break;
-    case AST::BinaryOperation::LessEqual:
-        opcode = codefile::OpCode::Jg;
-        break;
-    case AST::BinaryOperation::Greater:
-        opcode = codefile::OpCode::Jle;
-        break;
-    case AST::BinaryOperation::GreaterEqual:
-        opcode = codefile::OpCode::Jle;
-        break;
-    }
-
-    State.CodeAssembler.Jmp(Fn, opcode, 0);
-    UInt32 toResolve = UInt16(Fn.Code.Buff.size() - 2);
-
-    (void)EmitFunctionExpresion(State, _If->Body.get(), Fn);
-    UInt16 address = UInt16(Fn.Code.Buff.size() - (toResolve+2));
-
-    if (address <= Const16Max) {
-        UInt16& jcc = *(UInt16*)&Fn.Code.Buff[toResolve];
-        jcc = address;
+    // The uses of the const are replaced by its value, nothing is emitted
+    Constant value = {};
+    if (EvaluateConstVal(State, ConstVal, &Fn.Constants, value)) {
+        Fn.Constants.Add(ConstVal->NameAtom) = value;
+    }
+}
+
+// The jump taken when the comparision is true
+static codefile::OpCode ToJump(AST::BinaryOperation Op) {
+    switch (Op) {
+    case AST::BinaryOperation::Comparision: return codefile::OpCode::Je;
+    case AST::BinaryOperation::NotEqual: return codefile::OpCode::Jne;
+    case AST::BinaryOperation::Less: return codefile::OpCode::Jl;
+    case AST::BinaryOperation::LessEqual: return codefile::OpCode::Jle;
+    case AST::BinaryOperation::Greater: return codefile::OpCode::Jg;
+    default: return codefile::OpCode::Jge;
+    }
+}
+
+// Emits the condition of a if or a loop, Jump is taken when it's true
+static bool EmitCondition(EmitterState& State, AST::Expresion* Expr, Function& Fn, codefile::OpCode& Jump) {
+    TmpValue result = EmitFunctionExpresion(State, Expr, Fn);
+    if (result.IsErr())
+        return false;
+
+    if (result.LastOp >= AST::BinaryOperation::Comparision) {
+        Jump = ToJump(result.LastOp);
+        return true;
+    }
+
+    // A value is true if it isn't zero
+    if (result.IsRegister() || result.IsLocalReg()) {
+        State.CodeAssembler.TestZ(Fn, result.Reg);
+        if (result.IsRegister()) {
+            State.DeallocateRegister(result.Reg);
+        }
     }
     else {
-        State.Error(_If->Location, u8"Code too long");
+        UInt8 reg = State.AllocateRegister();
+        State.MoveTmp(Fn, reg, result);
+        State.CodeAssembler.TestZ(Fn, reg);
+        State.DeallocateRegister(reg);
+    }
+
+    Jump = codefile::OpCode::Jne;
+    return true;
+}
+
+static bool EndsInReturn(AST::Block* Block) {
+    return Block->Statements.size() && Block->Statements[Block->Statements.size() - 1]->Type == AST::StatementType::Return;
+}
+
+void EmitFunctionIf(EmitterState& State, AST::If* _If, Function& Fn) {
+    State.Context.IsInIf = true;
+
+    codefile::OpCode jump = codefile::OpCode::Jmp;
+    if (!EmitCondition(State, _If->Expr, Fn, jump))
         return;
+
+    Label otherwise = State.CodeAssembler.CreateLabel(Fn);
+    State.CodeAssembler.Jump(Fn, codefile::GetNegatedJump(jump), otherwise);
+
+    (void)EmitFunctionExpresion(State, _If->Body, Fn);
+
+    // The body jumps over the else
+    bool hasElse = (_If->Elif || _If->ElseBlock) && !EndsInReturn(_If->Body);
+    Label end = 0;
+    if (hasElse) {
+        end = State.CodeAssembler.CreateLabel(Fn);
+        State.CodeAssembler.Jump(Fn, codefile::OpCode::Jmp, end);
     }
+    State.CodeAssembler.BindLabel(Fn, otherwise);
+
     if (_If->Elif) {
-        EmitFunctionIf(State, (AST::If*)_If->Elif.get(), Fn);
+        EmitFunctionIf(State, (AST::If*)_If->Elif, Fn);
     }
     else {
         if (_If->ElseBlock) {
             State.Context.IsInElse = true;
-            (void)EmitFunctionExpresion(State, _If->ElseBlock.get(), Fn);
+            (void)EmitFunctionExpresion(State, _If->ElseBlock, Fn);
             State.Context.IsInElse = false;
         }
     }
 
+    if (hasElse) {
+        State.CodeAssembler.BindLabel(Fn, end);
+    }
     State.Context.IsInIf = false;
 }
 
+// The condition is at the bottom of the body and the loop is entered by a jump to it,
+// so each iteration runs a single branch
+static void EmitLoop(EmitterState& State, AST::Block* Body, AST::Expresion* Step, AST::Expresion* Condition, Function& Fn) {
+    bool isInLoop = State.Context.IsInLoop;
+    State.Context.IsInLoop = true;
+
+    Label body = State.CodeAssembler.CreateLabel(Fn);
+    Label test = State.CodeAssembler.CreateLabel(Fn);
+    if (Condition) {
+        State.CodeAssembler.Jump(Fn, codefile::OpCode::Jmp, test);
+    }
+
+    State.CodeAssembler.BindLabel(Fn, body);
+    (void)EmitFunctionExpresion(State, Body, Fn);
+    if (Step) {
+        TmpValue tmp = EmitFunctionExpresion(State, Step, Fn);
+        if (tmp.IsRegister()) {
+            State.DeallocateRegister(tmp.Reg);
+        }
+    }
+
+    // Without condition the loop ends with a return
+    State.CodeAssembler.BindLabel(Fn, test);
+    codefile::OpCode jump = codefile::OpCode::Jmp;
+    if (!Condition || EmitCondition(State, Condition, Fn, jump)) {
+        State.CodeAssembler.Jump(Fn, jump, body);
+    }
+
+    State.Context.IsInLoop = isInLoop;
+}
+
+void EmitFunctionWhile(EmitterState& State, AST::While* While, Function& Fn) {
+    EmitLoop(State, While->Body, nullptr, While->Expr, Fn);
+}
+
+void EmitFunctionFor(EmitterState& State, AST::For* For, Function& Fn) {
+    if (For->Init) {
+        EmitFunctionStatement(State, For->Init, Fn);
+    }
+    EmitLoop(State, For->Body, For->Step, For->Expr, Fn);
+}
+
 }
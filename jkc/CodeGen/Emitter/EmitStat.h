@@ -10,6 +10,8 @@ struct Var;
 struct ConstVal;
 struct Return;
 struct If;
+struct While;
+struct For;
 
 }
 
@@ -24,12 +26,13 @@ void EmitProgramStatements(EmitterState& State, AST::Program& Program);
 void EmitStatement(EmitterState& State, AST::Statement* Stat);
 void EmitFunction(EmitterState& State, AST::Function* ASTFn);
 void EmitVar(EmitterState& State, AST::Var* Var);
-void EmitConstVal(EmitterState& State, AST::ConstVal* ConstVal);
 
 void EmitFunctionStatement(EmitterState& State, AST::Statement* Stat, Function& Fn);
 void EmitFunctionReturn(EmitterState& State, AST::Return* Ret, Function& Fn);
 void EmitFunctionLocal(EmitterState& State, AST::Var* Var, Function& Fn);
 void EmitFunctionConstVal(EmitterState& State, AST::ConstVal* ConstVal, Function& Fn);
 void EmitFunctionIf(EmitterState& State, AST::If* ConstVal, Function& Fn);
+void EmitFunctionWhile(EmitterState& State, AST::While* While, Function& Fn);
+void EmitFunctionFor(EmitterState& State, AST::For* For, Function& Fn);
 
 }
@@ -1,112 +1,327 @@
 #include "jkc/CodeGen/Emitter/EmitterState.h"
 #include "jkc/CodeGen/Emitter/PreEmit.h"
 #include "jkc/CodeGen/Emitter/EmitStat.h"
+#include "jkc/CodeGen/Peephole.h"
+#include "jkc/CodeGen/Decoder.h"
+#include "jkc/IR/Inliner.h"
 #include "jkc/AST/Statements.h"
 #include "jkc/AST/Expresions.h"
+#include "jkc/Hash.h"
 #include <jkr/CodeFile/Header.h>
 #include <jkr/CodeFile/Function.h>
+#include <jkr/CodeFile/Profile.h>
 #include <jkr/CodeFile/Data.h>
 #include <jkr/CodeFile/Type.h>
+#include <jkr/CodeFile/Link.h>
 #include <jkr/Utility.h>
 #include <stdarg.h>
+#include <algorithm>
 
 namespace CodeGen {
 
 EmitterState::EmitterState(FILE* ErrorStream) : ErrorStream(ErrorStream) {}
 
+// A backward jump is the back edge of a loop
+static bool HasBackEdges(const Vector<Byte>& Code) {
+    DecodedInstruction inst = {};
+    for (UInt32 offset = 0; Decode(Code.data(), UInt32(Code.size()), offset, inst); offset += inst.Size) {
+        if (inst.IsJump() && inst.GetTarget() <= offset)
+            return true;
+    }
+    return false;
+}
+
 EmitterState::~EmitterState() {}
 
 void EmitterState::Emit(AST::Program& Program, FileType FileTy, EmitOptions Options, std::ostream& Output) {
     CurrentOptions = Options;
+    CurrentFileType = FileTy;
     Functions.Clear();
     Globals.Clear();
+    Constants.Clear();
+    Structs.Clear();
+    StringIndices.clear();
+    Strings.clear();
+    DecodedStrings.clear();
     Context = {};
 
+    Profile.Clear();
+    if (Options.ProfilePath && Options.OptimizationLevel != OPTIMIZATION_NONE && !Profile.Load((Str)Options.ProfilePath)) {
+        fprintf(ErrorStream, "Warn: The profile '%s' can't be read\n", Options.ProfilePath);
+    }
+
+    Cache.Clear();
+    CachePath.clear();
+    if (Options.CacheDirectory) {
+        // A cache file for each module
+        char fileName[32];
+        sprintf_s(fileName, sizeof(fileName), "%016llX.jkcache",
+                  HashBytes(HashSeed, Program.Name.data(), Program.Name.size()));
+
+        CachePath = (Str)Options.CacheDirectory;
+        CachePath += u8"/";
+        CachePath += (Str)fileName;
+        Cache.Load(CachePath);
+
+        ModuleKey = HashValue(HashSeed, Program.DeclarationHash);
+        ModuleKey = HashValue(ModuleKey, FileTy);
+        ModuleKey = HashValue(ModuleKey, Options.Debug);
+        ModuleKey = HashValue(ModuleKey, Options.OptimizationLevel);
+        ModuleKey = HashValue(ModuleKey, Options.InlineThreshold);
+        ModuleKey = HashValue(ModuleKey, Profile.Hash);
+    }
+
     PreEmit(*this, Program);
+
+    FunctionInliner.reset();
+    if (Options.OptimizationLevel != OPTIMIZATION_NONE && Options.InlineThreshold) {
+        FunctionInliner = std::make_unique<IR::Inliner>(*this);
+        FunctionInliner->Analyze(Program);
+    }
     
     EmitProgramStatements(*this, Program);
 
+    if (Options.OptimizationLevel != OPTIMIZATION_NONE) {
+        for (auto& fn : Functions.Items) {
+            if (fn.IsDefined && !fn.IsExtern) {
+                OptimizePeephole(fn);
+            }
+        }
+    }
+
+    if (Success && IsCacheEnabled()) {
+        Cache.Save(CachePath);
+    }
+
+    // Link tables
+    std::vector<codefile::ExportEntry> exports;
+    std::vector<codefile::ImportEntry> imports;
+    for (auto& fn : Functions.Items) {
+        StringView name = fn.Name;
+        if (fn.IsImport) {
+            imports.emplace_back(codefile::ImportEntry{
+                .Hash = codefile::HashName(name.data(), name.size()),
+                .Name = fn.EntryAddress,
+                .Library = fn.LibraryAddress,
+            });
+        }
+        else if (FileTy == FileType::Library && !fn.IsExtern && fn.IsDefined) {
+            exports.emplace_back(codefile::ExportEntry{
+                .Hash = codefile::HashName(name.data(), name.size()),
+                .Name = AddString(name, SourceLocation()),
+                .Function = fn.Address,
+            });
+        }
+    }
+
+    // The runtime search the exports by hash
+    std::sort(exports.begin(), exports.end(), [](const codefile::ExportEntry& A, const codefile::ExportEntry& B) {
+        return A.Hash < B.Hash;
+    });
+
+    // The virtual machine writes the profile by these
+    std::vector<codefile::SiteEntry> sites;
+    for (auto& fn : Functions.Items) {
+        if (!fn.IsDefined || fn.IsExtern)
+            continue;
+
+        sites.emplace_back(codefile::SiteEntry{
+            .Key = fn.ProfileKey,
+            .Function = fn.Address,
+            .Kind = codefile::SiteFunction,
+        });
+        for (auto& site : fn.ProfileSites) {
+            sites.emplace_back(codefile::SiteEntry{
+                .Key = site.Function,
+                .Function = fn.Address,
+                .Offset = site.IP,
+                .Site = site.Site,
+                .Kind = site.IsCall ? codefile::SiteCall : site.IsNegated ? codefile::SiteNegatedBranch : codefile::SiteBranch,
+            });
+        }
+    }
+
+    // The runtime search the sites of a function and the site of a offset, the entry of the function stays first
+    std::stable_sort(sites.begin(), sites.end(), [](const codefile::SiteEntry& A, const codefile::SiteEntry& B) {
+        return A.Function < B.Function || (A.Function == B.Function && A.Offset < B.Offset);
+    });
+
     codefile::FileHeader header = {
             .Signature = {},
-            .CheckSize = sizeof(codefile::FileHeader),
+            .CheckSize = 0,
+            .MajorVersion = codefile::CurrentMajorVersion,
+            .MinorVersion = codefile::CurrentMinorVersion,
     };
 
     memcpy_s((Char*)&header.Signature, sizeof(header.Signature), codefile::Signature, sizeof(codefile::Signature));
 
     if (FileTy == FileType::Executable) {
-        auto it = Functions.Find(u8"Main");
-        if (it == Functions.end()) {
+        USize main = Functions.Find(InternAtom(u8"Main"));
+        if (main == Functions.NotFound) {
             GlobalError(u8"The entry point was not defined");
             return;
         }
 
         header.FileType = codefile::Executable;
-        header.EntryPoint = (UInt32)it->second;
-        header.MajorVersion = 1;
-        header.MinorVersion = 0;
+        header.EntryPoint = (UInt32)main;
+    }
+    else {
+        header.FileType = codefile::Library;
     }
 
     header.DataSize = UInt16(Globals.Size());
     header.FunctionSize = UInt32(Functions.Size());
     header.StringsSize = UInt32(Strings.size());
 
-    // Calculate CheckSize
+    // Layout the sections
+    codefile::SectionHeader sections[codefile::SectionCount] = {};
+    UInt32 offset = UInt32(codefile::SectionDirectoryOffset + sizeof(sections));
+
+    sections[codefile::SectionData].Offset = UInt32(Align(offset, codefile::SectionAlignment));
     for (auto& global : Globals.Items) {
-        header.CheckSize += UInt32(sizeof(codefile::DataHeader));
-        header.CheckSize += UInt32(global.Type.SizeInBits / 8);
+        sections[codefile::SectionData].Size += UInt32(sizeof(codefile::DataHeader));
+        sections[codefile::SectionData].Size += UInt32(global.Type.SizeInBits / 8);
     }
+    offset = sections[codefile::SectionData].Offset + sections[codefile::SectionData].Size;
+
+    sections[codefile::SectionFunctions].Offset = UInt32(Align(offset, codefile::SectionAlignment));
+    sections[codefile::SectionFunctions].Size = UInt32(sizeof(codefile::FunctionEntry) * Functions.Size());
+    offset = sections[codefile::SectionFunctions].Offset + sections[codefile::SectionFunctions].Size;
 
+    // The functions called more times in the profile are put first, together
+    std::vector<Function*> codeOrder;
     for (auto& fn : Functions.Items) {
-        header.CheckSize += UInt32(sizeof(codefile::FunctionHeader) + fn.Code.Buff.size());
+        if (!fn.IsExtern) {
+            codeOrder.emplace_back(&fn);
+        }
+    }
+    if (Profile.IsLoaded()) {
+        std::stable_sort(codeOrder.begin(), codeOrder.end(), [&](const Function* A, const Function* B) {
+            return Profile.GetCalls(A->ProfileKey) > Profile.GetCalls(B->ProfileKey);
+        });
     }
 
+    // By address of the function
+    std::vector<UInt32> codeOffsets(Functions.Size(), 0);
+    sections[codefile::SectionCode].Offset = UInt32(Align(offset, codefile::SectionAlignment));
+    for (Function* fn : codeOrder) {
+        sections[codefile::SectionCode].Size = UInt32(Align(sections[codefile::SectionCode].Size, codefile::SectionAlignment));
+        codeOffsets[fn->Address] = sections[codefile::SectionCode].Size;
+        sections[codefile::SectionCode].Size += UInt32(fn->Code.Buff.size());
+    }
+    offset = sections[codefile::SectionCode].Offset + sections[codefile::SectionCode].Size;
+
+    sections[codefile::SectionStrings].Offset = UInt32(Align(offset, codefile::SectionAlignment));
     for (auto& str : Strings) {
-        header.CheckSize += UInt32((str.Size + 1) + 2);
+        sections[codefile::SectionStrings].Size = UInt32(Align(sections[codefile::SectionStrings].Size, codefile::StringAlignment));
+        sections[codefile::SectionStrings].Size += UInt32(sizeof(UInt32) + (str.Size + 1));
     }
+    offset = sections[codefile::SectionStrings].Offset + sections[codefile::SectionStrings].Size;
+
+    sections[codefile::SectionExports].Offset = UInt32(Align(offset, codefile::SectionAlignment));
+    sections[codefile::SectionExports].Size = UInt32(sizeof(codefile::ExportEntry) * exports.size());
+    offset = sections[codefile::SectionExports].Offset + sections[codefile::SectionExports].Size;
+
+    sections[codefile::SectionImports].Offset = UInt32(Align(offset, codefile::SectionAlignment));
+    sections[codefile::SectionImports].Size = UInt32(sizeof(codefile::ImportEntry) * imports.size());
+    offset = sections[codefile::SectionImports].Offset + sections[codefile::SectionImports].Size;
+
+    sections[codefile::SectionSites].Offset = UInt32(Align(offset, codefile::SectionAlignment));
+    sections[codefile::SectionSites].Size = UInt32(sizeof(codefile::SiteEntry) * sites.size());
+    header.CheckSize = sections[codefile::SectionSites].Offset + sections[codefile::SectionSites].Size;
 
     // Writing
-    Output.write((const char*)&header, sizeof(codefile::FileHeader));
+    USize written = 0;
+    auto write = [&](const void* Data, USize Size) {
+        Output.write((const char*)Data, Size);
+        written += Size;
+    };
+    auto pad = [&](USize To) {
+        for (; written < To; written++) {
+            Output.put('\0');
+        }
+    };
+
+    write(&header, sizeof(codefile::FileHeader));
+    pad(codefile::SectionDirectoryOffset);
+    write(sections, sizeof(sections));
 
     // Data section
+    pad(sections[codefile::SectionData].Offset);
     for (auto& global : Globals.Items) {
         codefile::DataHeader gHeader = {
             .Primitive = TypeToPrimitive(global.Type),
         };
 
-        Output.write((const char*)(&gHeader), sizeof(codefile::DataHeader));
-        Output.write((const char*)(&global.Value.Unsigned), global.Type.SizeInBits / 8);
+        write(&gHeader, sizeof(codefile::DataHeader));
+        write(&global.Value.Unsigned, global.Type.SizeInBits / 8);
     }
 
-    // Code section
+    // Functions section
+    pad(sections[codefile::SectionFunctions].Offset);
+    UInt32 importIndex = 0;
     for (auto& fn : Functions.Items) {
-        codefile::FunctionHeader fnHeader = {
-                .Flags = codefile::FunctionNone,
-        };
-
-        if (fn.IsExtern) {
-            fnHeader.Flags |= codefile::FunctionNative;
-            fnHeader.SizeOfCode = fn.LibraryAddress;
-            fnHeader.StackArguments = UInt16(fn.EntryAddress & 0xFFFF);
-            fnHeader.LocalReserve = UInt16(fn.EntryAddress>>16);
-            Output.write((char*)&fnHeader, sizeof(codefile::FunctionHeader));
+        codefile::FunctionEntry fnEntry = {};
+        fnEntry.Flags = codefile::FunctionNone;
+
+        if (fn.IsImport) {
+            fnEntry.Flags |= codefile::FunctionImport;
+            fnEntry.SizeOfCode = importIndex++;
+            // Checked against the exported function by the linker
+            fnEntry.StackArguments = fn.StackArguments;
+        }
+        else if (fn.IsExtern) {
+            fnEntry.Flags |= codefile::FunctionNative;
+            fnEntry.SizeOfCode = fn.LibraryAddress;
+            fnEntry.StackArguments = UInt16(fn.EntryAddress & 0xFFFF);
+            fnEntry.LocalReserve = UInt16(fn.EntryAddress>>16);
         }
         else {
-            fnHeader.StackArguments = fn.StackArguments;
-            fnHeader.LocalReserve = fn.CountOfStackLocals;
-            fnHeader.SizeOfCode = UInt32(fn.Code.Buff.size()),
-
-            Output.write((char*)&fnHeader, sizeof(codefile::FunctionHeader));
-            Output.write((char*)fn.Code.Buff.data(), fn.Code.Buff.size());
+            fnEntry.StackArguments = fn.StackArguments;
+            fnEntry.LocalReserve = fn.CountOfStackLocals;
+            fnEntry.SizeOfCode = UInt32(fn.Code.Buff.size());
+            fnEntry.CodeOffset = codeOffsets[fn.Address];
+
+            if (FileTy == FileType::Library) {
+                fnEntry.Flags |= codefile::FunctionExport;
+            }
+            if (HasBackEdges(fn.Code.Buff)) {
+                fnEntry.Flags |= codefile::FunctionLoops;
+            }
         }
+
+        write(&fnEntry, sizeof(codefile::FunctionEntry));
+    }
+
+    // Code section
+    pad(sections[codefile::SectionCode].Offset);
+    for (Function* fn : codeOrder) {
+        pad(Align(written, codefile::SectionAlignment));
+        write(fn->Code.Buff.data(), fn->Code.Buff.size());
     }
 
     // ST section
+    pad(sections[codefile::SectionStrings].Offset);
     for (auto& s : Strings) {
-        UInt16 size = UInt16(s.Size + 1);
-        Output.write((const char*)&size, 2);
-        Output.write((const char*)s.Data, s.Size);
+        pad(Align(written, codefile::StringAlignment));
+        UInt32 size = UInt32(s.Size + 1);
+        write(&size, sizeof(UInt32));
+        write(s.Data, s.Size);
         Output.put('\0');
+        written++;
     }
+
+    // Exports section
+    pad(sections[codefile::SectionExports].Offset);
+    write(exports.data(), sizeof(codefile::ExportEntry) * exports.size());
+
+    // Imports section
+    pad(sections[codefile::SectionImports].Offset);
+    write(imports.data(), sizeof(codefile::ImportEntry) * imports.size());
+
+    // Sites section
+    pad(sections[codefile::SectionSites].Offset);
+    write(sites.data(), sizeof(codefile::SiteEntry) * sites.size());
 }
 
 void EmitterState::Warn(const SourceLocation& Location, Str Format, ...) {
@@ -154,57 +369,170 @@ void EmitterState::GlobalError(Str Format, ...) {
     Success = false;
 }
 
-TmpValue EmitterState::GetID(const StringView& ID, Function& Fn, const SourceLocation& Location) {
-    {
-        auto it = Fn.Locals.Find(ID);
-        if (it != Fn.Locals.end()) {
-            auto& local = Fn.Locals.Get(it->second);
-            return TmpValue{
-                .Ty = local.IsRegister ? TmpType::LocalReg : TmpType::Local,
-                .Data = local.Index,
-                .Index = (UInt32)it->second,
-                .Type = local.Type,
-            };
-        }
+TmpValue EmitterState::GetID(AST::Identifier* ID, Function& Fn) {
+    USize index = Fn.Locals.Find(ID->IDAtom);
+    if (index != Fn.Locals.NotFound) {
+        auto& local = Fn.Locals.Get(index);
+        return TmpValue{
+            .Ty = local.IsRegister ? TmpType::LocalReg : TmpType::Local,
+            .Data = local.Index,
+            .Index = (UInt32)index,
+            .Type = local.Type,
+        };
     }
 
-    {
-        auto it = Globals.Find(ID);
-        if (it == Globals.end()) {
-            Error(Location,
-                u8"Undefined reference to '%s'",
-                ID.data()
-            );
-        }
-        else {
-            auto& global = Globals.Get(it->second);
+    // A const is replaced by its value
+    for (SymbolTable<Constant>* constants : { &Fn.Constants, &Constants }) {
+        index = constants->Find(ID->IDAtom);
+        if (index != constants->NotFound) {
+            auto& constant = constants->Get(index);
             return TmpValue{
-                .Ty = TmpType::Global,
-                .Data = global.Index,
-                .Type = global.Type,
+                .Ty = TmpType::Constant,
+                .Data = constant.Unsigned,
+                .Type = constant.Type,
             };
         }
     }
 
-    return TmpValue();
+    index = Globals.Find(ID->IDAtom);
+    if (index == Globals.NotFound) {
+        Error(ID->Location,
+            u8"Undefined reference to '%.*s'",
+            (int)ID->ID.size(), ID->ID.data()
+        );
+        return TmpValue();
+    }
+
+    auto& global = Globals.Get(index);
+    return TmpValue{
+        .Ty = TmpType::Global,
+        .Data = global.Index,
+        .Type = global.Type,
+    };
 }
 
 Function* EmitterState::GetFn(AST::Expresion* Target) {
     if (Target->Type == AST::ExpresionType::Identifier) {
         auto id = (AST::Identifier*)Target;
-        auto it = Functions.Find(id->ID);
-        if (it != Functions.end() && (Functions.Get(it->second).IsDefined || Functions.Get(it->second).IsExtern)) {
-            return &Functions.Get(it->second);
+        USize index = Functions.Find(id->IDAtom);
+        if (index != Functions.NotFound && (Functions.Get(index).IsDefined || Functions.Get(index).IsExtern)) {
+            return &Functions.Get(index);
         }
 
         Error(id->Location,
-            u8"Undefined reference to function '%s'",
-            id->ID.c_str()
+            u8"Undefined reference to function '%.*s'",
+            (int)id->ID.size(), id->ID.data()
         );
     }
     return nullptr;
 }
 
+UInt64 EmitterState::GetFunctionKey(const AST::Function* ASTFn) const {
+    UInt64 key = HashValue(ModuleKey, ASTFn->BodyHash);
+    // The code of the inlined callees is part of the function
+    USize index = Functions.Find(ASTFn->NameAtom);
+    if (FunctionInliner && index != Functions.NotFound) {
+        key = HashValue(key, FunctionInliner->HashCallees(Functions.Get(index).Address));
+    }
+    return HashBytes(key, ASTFn->Name.data(), ASTFn->Name.size());
+}
+
+bool EmitterState::ReuseFunction(UInt64 Key, Function& Fn) {
+    const CachedFunction* cached = Cache.Find(Key);
+    if (!cached)
+        return false;
+
+    Fn.Code.Buff = cached->Code;
+    Fn.CountOfStackLocals = cached->CountOfStackLocals;
+    Fn.ProfileSites = cached->Sites;
+
+    // Relink the strings to the string table of this module
+    for (auto& str : cached->Strings) {
+        UInt32 index = AddString(str.Data, SourceLocation());
+        Fn.Code.Buff[str.IP] = Byte(index);
+        Fn.Code.Buff[str.IP + 1] = Byte(index >> 8);
+        Fn.Code.Buff[str.IP + 2] = Byte(index >> 16);
+        Fn.Code.Buff[str.IP + 3] = Byte(index >> 24);
+        Fn.StringRefs.emplace_back(StringReference{ .IP = str.IP, .Index = index });
+    }
+
+    return true;
+}
+
+void EmitterState::CacheFunction(UInt64 Key, const Function& Fn) {
+    CachedFunction cached = {
+        .Code = Fn.Code.Buff,
+        .Sites = Fn.ProfileSites,
+        .CountOfStackLocals = Fn.CountOfStackLocals,
+    };
+
+    for (auto& ref : Fn.StringRefs) {
+        const StringTmp& str = Strings[ref.Index];
+        cached.Strings.emplace_back(CachedString{ .IP = ref.IP, .Data = String(str.Data, str.Size) });
+    }
+
+    Cache.Add(Key, std::move(cached));
+}
+
+UInt32 EmitterState::AddString(const StringView& Data, const SourceLocation& Location) {
+    auto it = StringIndices.find(Data);
+    if (it != StringIndices.end()) {
+        return it->second;
+    }
+
+    auto& str = Strings.emplace_back(Data.data(), Data.size());
+    str.Location = Location;
+
+    UInt32 index = UInt32(Strings.size() - 1);
+    StringIndices.emplace(StringView(str.Data, str.Size), index);
+    return index;
+}
+
+UInt32 EmitterState::AddLiteral(const StringView& Literal, const SourceLocation& Location) {
+    if (Literal.find('\\') == StringView::npos) {
+        return AddString(Literal, Location);
+    }
+
+    // The lexer already validated the escape sequences
+    String decoded{};
+    decoded.reserve(Literal.size());
+    for (USize i = 0; i < Literal.size(); i++) {
+        Char c = Literal[i];
+        if (c == '\\') {
+            DecodeEscape(Literal[++i], c);
+        }
+        decoded.push_back(c);
+    }
+
+    auto it = StringIndices.find(decoded);
+    if (it != StringIndices.end()) {
+        return it->second;
+    }
+
+    return AddString(DecodedStrings.emplace_back(std::move(decoded)), Location);
+}
+
+Struct* EmitterState::GetStruct(const AST::TypeDecl& Type, const SourceLocation& Location) {
+    if (!Type.IsStruct()) {
+        Error(Location,
+            u8"'%s' is not a struct",
+            Type.ToString().c_str()
+        );
+        return nullptr;
+    }
+
+    USize index = Structs.Find(Type.StructAtom);
+    if (index == Structs.NotFound) {
+        Error(Location,
+            u8"Undefined reference to struct '%s'",
+            Type.ToString().c_str()
+        );
+        return nullptr;
+    }
+
+    return &Structs.Get(index);
+}
+
 void EmitterState::PushTmp(Function& Fn, const TmpValue& Tmp) {
     if (Tmp.IsRegister()) {
         CodeAssembler.Push(Fn, Tmp.Reg);
@@ -219,7 +547,14 @@ void EmitterState::PushTmp(Function& Fn, const TmpValue& Tmp) {
         CodeAssembler.Push(Fn, Tmp.Reg);
     }
     else if (Tmp.IsConstant()) {
-        if (Tmp.Data <= ByteMax) {
+        if (Tmp.Type.IsConstString()) {
+            // The string is loaded by his index
+            UInt8 reg = AllocateRegister();
+            MoveTmp(Fn, reg, Tmp);
+            CodeAssembler.Push(Fn, reg);
+            DeallocateRegister(reg);
+        }
+        else if (Tmp.Data <= ByteMax) {
             CodeAssembler.Push8(Fn, Byte(Tmp.Data));
         }
         else if(Tmp.Data <= Const16Max){
@@ -235,21 +570,25 @@ void EmitterState::PushTmp(Function& Fn, const TmpValue& Tmp) {
 }
 
 void EmitterState::MoveTmp(Function& Fn, UInt8 Reg, const TmpValue& Tmp) {
-    if (Tmp.IsRegister()) {
-        CodeAssembler.Mov(Fn, Reg, Tmp.Reg);
+    if (Tmp.IsRegister() || Tmp.IsLocalReg()) {
+        // A coalesced copy is already in the register
+        if (Tmp.Reg != Reg) {
+            CodeAssembler.Mov(Fn, Reg, Tmp.Reg);
+        }
     }
     else if (Tmp.IsLocal()) {
         CodeAssembler.LocalGet(Fn, Reg, Tmp.Local);
     }
-    else if (Tmp.IsLocalReg()) {
-        CodeAssembler.Mov(Fn, Reg, Tmp.Reg);
-    }
     else if (Tmp.IsGlobal()) {
         CodeAssembler.GlobalGet(Fn, Reg, Tmp.Global);
     }
     else if (Tmp.IsConstant()) {
         if (Tmp.Type.IsConstString()) {
             CodeAssembler.Ldsr(Fn, Reg, UInt32(Tmp.Data));
+            Fn.StringRefs.emplace_back(StringReference{
+                .IP = UInt32(Fn.Code.Buff.size() - sizeof(UInt32)),
+                .Index = UInt32(Tmp.Data),
+            });
         }
         else if (Tmp.Data <= Const4Max) {
             CodeAssembler.Mov4(Fn, Reg, Byte(Tmp.Data));
@@ -278,6 +617,8 @@ codefile::PrimitiveType EmitterState::TypeToPrimitive(const AST::TypeDecl& Type)
         return codefile::PrimitiveUInt;
     else if (Type.IsFloat())
         return codefile::PrimitiveFloat;
+    else if (Type.IsStruct())
+        return codefile::PrimitiveRef;
     
     return codefile::PrimitiveAny;
 }
@@ -303,6 +644,8 @@ void EmitterState::MoveConst(Function& Fn, Byte Dest, UInt64 Const) {
 codefile::ArrayElement EmitterState::TypeToArrayElement(const AST::TypeDecl& Type) {
     if (Type.IsByte())return codefile::AE_1B;
     else if (Type.IsInt() || Type.IsUInt() || Type.IsFloat()) return codefile::AE_8B;
+    // References to objects and arrays
+    else if (Type.Is(AST::TypeDecl::Type::Struct) || Type.IsAny() || Type.HasArray()) return codefile::AE_8B;
 
     assert(0 && "Invalid array element type");
     return codefile::AE_1B;
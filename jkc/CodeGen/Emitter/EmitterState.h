@@ -3,17 +3,36 @@
 #include "jkc/AST/Type.h"
 #include "jkc/AST/Enums.h"
 #include "jkc/CodeGen/Assembler.h"
+#include "jkc/CodeGen/Struct.h"
+#include "jkc/CodeGen/Emitter/EmitCache.h"
+#include "jkc/CodeGen/Emitter/EmitProfile.h"
+#include "jkc/CodeGen/Emitter/RegisterAllocator.h"
 #include <jkr/String.h>
 #include <jkr/CodeFile/Array.h>
 #include <jkr/CodeFile/Type.h>
 #include <iostream>
 #include <cassert>
+#include <deque>
+#include <memory>
+
+namespace IR {
+
+struct Inliner;
+
+}
 
 #define CHECK_UNINITIALIZED_LOCAL(Local, Location) \
     if (!(Local).IsInitialized) {\
         State.Error(Location, u8"Trying to use a uninitialized var");\
     }
 
+// The object of a var is destroyed when its function returns,
+// a copy of it in a other var would outlive it
+#define CHECK_OWNED_OBJECT(Local, Location) \
+    if ((Local).OwnsObject) {\
+        State.Error(Location, u8"The object of the var can't be copied, only passed or returned");\
+    }
+
 namespace CodeGen {
 
 enum class FileType {
@@ -31,9 +50,20 @@ enum Optimization {
     OPTIMIZATION_RELEASE_FAST,
 };
 
+// Default of EmitOptions::InlineThreshold
+inline constexpr UInt32 DefaultInlineThreshold = 40;
+
 struct EmitOptions {
     DebugLevel Debug;
     Optimization OptimizationLevel;
+    // Directory of the compilation cache, nullptr disables it
+    const char* CacheDirectory = nullptr;
+    // Limit of the size of a callee times its call sites to inline it, 0 disables the inliner
+    UInt32 InlineThreshold = DefaultInlineThreshold;
+    // Profile of a execution of a previous build of the module, nullptr disables it.
+    // It decides the inlining, the order of the blocks and of the functions and the
+    // values that stay in registers
+    const char* ProfilePath = nullptr;
 };
 
 struct RegisterInfo {
@@ -55,8 +85,19 @@ struct [[nodiscard]] EmitterState {
     void GlobalError(Str Format, ...);
 
     // Utility/Helper functions
-    TmpValue GetID(const StringView& ID, Function& Fn, const SourceLocation& Location);
+    TmpValue GetID(AST::Identifier* ID, Function& Fn);
     Function* GetFn(AST::Expresion* Target);
+    Struct* GetStruct(const AST::TypeDecl& Type, const SourceLocation& Location);
+    UInt32 AddString(const StringView& Data, const SourceLocation& Location);
+    // Adds a string literal of the source decoding its escape sequences
+    UInt32 AddLiteral(const StringView& Literal, const SourceLocation& Location);
+
+    // Compilation cache
+    constexpr bool IsCacheEnabled() const { return !CachePath.empty(); }
+    UInt64 GetFunctionKey(const AST::Function* ASTFn) const;
+    // Copies the cached code of the function, returns false if there isn't
+    bool ReuseFunction(UInt64 Key, Function& Fn);
+    void CacheFunction(UInt64 Key, const Function& Fn);
 
     // Utility/Helper for tmp values
     void PushTmp(Function& Fn, const TmpValue& Tmp);
@@ -85,6 +126,7 @@ struct [[nodiscard]] EmitterState {
     FILE* ErrorStream;
     bool Success = true;
     EmitOptions CurrentOptions;
+    FileType CurrentFileType = FileType::Executable;
 
     Assembler CodeAssembler;
     struct {
@@ -93,6 +135,7 @@ struct [[nodiscard]] EmitterState {
         bool IsLast;
         bool IsInIf;
         bool IsInElse;
+        bool IsInLoop;
     } Context;
 
     RegisterInfo Registers[32] = {
@@ -149,10 +192,28 @@ struct [[nodiscard]] EmitterState {
         {15, false },
     };
 
+    RegisterPlan LocalRegisters;
+
     SymbolTable<Function> Functions;
     SymbolTable<Global> Globals;
-    std::unordered_map<StringView, UInt32> NativeLibraries;
+    // The consts of the module, their uses are replaced by the value
+    SymbolTable<Constant> Constants;
+    SymbolTable<Struct> Structs;
+    // Index of each string in Strings, used to share the equal strings
+    std::unordered_map<StringView, UInt32> StringIndices;
     std::vector<StringTmp> Strings;
+    // The literals with escape sequences, the others are used from the source
+    std::deque<String> DecodedStrings;
+
+    EmitCache Cache;
+    String CachePath;
+    // Hash of the module declarations and the options
+    UInt64 ModuleKey = 0;
+
+    // Only when the inliner is enabled
+    std::unique_ptr<IR::Inliner> FunctionInliner;
+
+    EmitProfile Profile;
 };
 
 }
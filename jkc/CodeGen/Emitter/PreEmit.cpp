@@ -1,13 +1,17 @@
 #include "jkc/CodeGen/Emitter/EmitterState.h"
 #include "jkc/CodeGen/Emitter/PreEmit.h"
+#include "jkc/CodeGen/Emitter/ConstFold.h"
 #include "jkc/AST/Statements.h"
 #include "jkc/AST/Expresions.h"
+#include <jkr/CodeFile/OpCodes.h>
+#include <jkr/Align.h>
+#include <algorithm>
 
 namespace CodeGen {
 
 void PreEmit(EmitterState& State, AST::Program& Program) {
     for (auto& stat : Program.Statements) {
-        PreDeclareStatement(State, stat.get());
+        PreDeclareStatement(State, stat);
     }
 }
 
@@ -21,38 +25,36 @@ void PreDeclareStatement(EmitterState& State, AST::Statement* Stat) {
     else if (Stat->Type == AST::StatementType::ConstVal) {
         PreDeclareConstVal(State, (AST::ConstVal*)Stat);
     }
+    else if (Stat->Type == AST::StatementType::Struct) {
+        PreDeclareStruct(State, (AST::Struct*)Stat);
+    }
 }
 
 void PreDeclareFunction(EmitterState& State, AST::Function* ASTFn) {
     if (!ASTFn->IsDefined && !ASTFn->IsExtern)
         return;
 
-    auto& fn = State.Functions.Add(ASTFn->Name);
+    auto& fn = State.Functions.Add(ASTFn->NameAtom);
 
-    fn.Name = ASTFn->Name.data();
+    fn.Name = ASTFn->Name;
     fn.IsExtern = ASTFn->IsExtern;
     fn.HasMultiReturn = ASTFn->HasMultiReturn;
 
     if (ASTFn->IsExtern) {
-        auto it = State.NativeLibraries.find(ASTFn->LibraryRef);
-        if (it != State.NativeLibraries.end()) {
-            fn.LibraryAddress = it->second;
-        }
-        else {
-            StringTmp& str = State.Strings.emplace_back(ASTFn->LibraryRef.data(), ASTFn->LibraryRef.size());
-            fn.LibraryAddress = UInt16(State.Strings.size() - 1);
-            State.NativeLibraries.emplace(StringView(str.Data, str.Size), fn.LibraryAddress);
-        }
-
-        State.Strings.emplace_back(fn.Name, ASTFn->Name.size());
-        fn.EntryAddress = UInt16(State.Strings.size() - 1);
+        fn.IsImport = ASTFn->LibraryRef.ends_with(u8".jk");
+        fn.LibraryAddress = State.AddLiteral(ASTFn->LibraryRef, ASTFn->Location);
+        fn.EntryAddress = State.AddString(fn.Name, ASTFn->Location);
     }
 
-    if (ASTFn->IsExtern) {
+    // The functions shared between code files always uses the register convention,
+    // so a import and his export agrees independently of the optimization level
+    bool isShared = fn.IsImport || State.CurrentFileType == FileType::Library;
+
+    if (ASTFn->IsExtern && !fn.IsImport) {
         fn.CC = CallConv::Register;
         for (Byte i = 0; i < ASTFn->Parameters.size(); i++) {
-            auto& local = fn.Locals.Add(ASTFn->Parameters[i].Name);
-            local.Name = ASTFn->Parameters[i].Name.data();
+            auto& local = fn.Locals.Add(ASTFn->Parameters[i].NameAtom);
+            local.Name = ASTFn->Parameters[i].Name;
             local.Type = ASTFn->Parameters[i].Type;
             local.IsInitialized = true;
 
@@ -61,10 +63,10 @@ void PreDeclareFunction(EmitterState& State, AST::Function* ASTFn) {
             fn.RegisterArguments++;
         }
     }
-    else if (State.CurrentOptions.OptimizationLevel == OPTIMIZATION_NONE) {
+    else if (State.CurrentOptions.OptimizationLevel == OPTIMIZATION_NONE && !isShared) {
         for (auto& param : ASTFn->Parameters) {
-            auto& local = fn.Locals.Add(param.Name);
-            local.Name = param.Name.data();
+            auto& local = fn.Locals.Add(param.NameAtom);
+            local.Name = param.Name;
             local.Type = param.Type;
             local.IsInitialized = true;
             local.Index = fn.CountOfStackLocals++;
@@ -80,8 +82,8 @@ void PreDeclareFunction(EmitterState& State, AST::Function* ASTFn) {
             fn.CC = CallConv::RegS;
 
         for (Byte i = 0; i < ASTFn->Parameters.size(); i++) {
-            auto& local = fn.Locals.Add(ASTFn->Parameters[i].Name);
-            local.Name = ASTFn->Parameters[i].Name.data();
+            auto& local = fn.Locals.Add(ASTFn->Parameters[i].NameAtom);
+            local.Name = ASTFn->Parameters[i].Name;
             local.Type = ASTFn->Parameters[i].Type;
             local.IsInitialized = true;
 
@@ -104,12 +106,93 @@ void PreDeclareFunction(EmitterState& State, AST::Function* ASTFn) {
 }
 
 void PreDeclareVar(EmitterState& State, AST::Var* Var) {
-    auto& global = State.Globals.Add(Var->Name);
+    if (State.Constants.Find(Var->NameAtom) != State.Constants.NotFound) {
+        State.Error(Var->Location, u8"'%.*s' is already defined", (int)Var->Name.size(), Var->Name.data());
+        return;
+    }
+
+    auto& global = State.Globals.Add(Var->NameAtom);
     global.Type = Var->VarType;
     global.Index = UInt32(State.Globals.Size() - 1);
-    global.Name = Var->Name.data();
+    global.Name = Var->Name;
 }
 
-void PreDeclareConstVal(EmitterState& /*State*/, AST::ConstVal* /*ConstVal*/) {}
+// The consts are evaluated when they are declared, so they can be used
+// by every function and by the consts and the globals declared after them
+void PreDeclareConstVal(EmitterState& State, AST::ConstVal* ConstVal) {
+    if (State.Constants.Find(ConstVal->NameAtom) != State.Constants.NotFound ||
+        State.Globals.Find(ConstVal->NameAtom) != State.Globals.NotFound) {
+        State.Error(ConstVal->Location, u8"'%.*s' is already defined", (int)ConstVal->Name.size(), ConstVal->Name.data());
+        return;
+    }
+
+    Constant value = {};
+    if (EvaluateConstVal(State, ConstVal, nullptr, value)) {
+        State.Constants.Add(ConstVal->NameAtom) = value;
+    }
+}
+
+static constexpr UInt16 FieldSize(const AST::TypeDecl& Type) {
+    if (Type.IsByte())
+        return 1;
+
+    // Int, UInt, Float and references
+    return 8;
+}
+
+void PreDeclareStruct(EmitterState& State, AST::Struct* ASTStruct) {
+    if (State.Structs.Find(ASTStruct->NameAtom) != State.Structs.NotFound) {
+        State.Error(ASTStruct->Location, u8"'%.*s' is already defined", (int)ASTStruct->Name.size(), ASTStruct->Name.data());
+        return;
+    }
+
+    auto& _struct = State.Structs.Add(ASTStruct->NameAtom);
+    _struct.Name = ASTStruct->Name;
+
+    for (auto& astField : ASTStruct->Fields) {
+        if (_struct.Fields.Find(astField.NameAtom) != _struct.Fields.NotFound) {
+            State.Error(astField.Location, u8"The field '%.*s' is already defined",
+                        (int)astField.Name.size(), astField.Name.data());
+            continue;
+        }
+
+        auto& field = _struct.Fields.Add(astField.NameAtom);
+        field.Name = astField.Name;
+        field.Type = astField.Type;
+        field.Size = FieldSize(astField.Type);
+    }
+
+    // The fields are packed from the biggest to the smallest,
+    // every field is aligned to its size so there is no padding between them.
+    Vector<USize> order{};
+    order.reserve(_struct.Fields.Size());
+    for (USize i = 0; i < _struct.Fields.Size(); i++) {
+        order.emplace_back(i);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](USize A, USize B) {
+        return _struct.Fields.Get(A).Size > _struct.Fields.Get(B).Size;
+    });
+
+    USize offset = 0;
+    for (USize i : order) {
+        auto& field = _struct.Fields.Get(i);
+        offset = Align(offset, field.Size);
+        field.Offset = UInt16(offset);
+        offset += field.Size;
+
+        if (field.Size > _struct.Alignment) {
+            _struct.Alignment = field.Size;
+        }
+    }
+
+    offset = Align(offset, _struct.Alignment);
+    if (offset > codefile::MaxObjectSize) {
+        State.Error(ASTStruct->Location, u8"'%.*s' is too big", (int)ASTStruct->Name.size(), ASTStruct->Name.data());
+        return;
+    }
+
+    _struct.Size = UInt16(offset);
+}
 
 }
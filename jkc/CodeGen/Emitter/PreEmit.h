@@ -17,5 +17,6 @@ void PreDeclareStatement(EmitterState& State, AST::Statement* Stat);
 void PreDeclareFunction(EmitterState& State, AST::Function* ASTFn);
 void PreDeclareVar(EmitterState& State, AST::Var* Var);
 void PreDeclareConstVal(EmitterState& State, AST::ConstVal* ConstVal);
+void PreDeclareStruct(EmitterState& State, AST::Struct* ASTStruct);
 
 }
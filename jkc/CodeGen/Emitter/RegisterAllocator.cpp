@@ -0,0 +1,314 @@
+#include "jkc/CodeGen/Emitter/RegisterAllocator.h"
+#include "jkc/CodeGen/Emitter/EmitterState.h"
+#include "jkc/AST/Visitor.h"
+#include <algorithm>
+
+namespace CodeGen {
+
+// The epilogue destroys the arrays and the objects created by the locals,
+// so they keep their register until the end
+static bool IsDestroyedAtEnd(const AST::TypeDecl& Type, bool CreatesObject) {
+    if (Type.IsUnknown())
+        return true;
+
+    return (!Type.HasConst() && Type.HasArray() && !Type.IsConstString()) || (Type.IsStruct() && CreatesObject);
+}
+
+// Numbers the statements as EmitFunctionStatement visits them,
+// a local live in a loop is live until the end of the loop
+struct LivenessBuilder : AST::Visitor<LivenessBuilder> {
+    void VisitStatement(AST::Statement* Stat) {
+        Position++;
+        Visitor::VisitStatement(Stat);
+    }
+
+    // The value of a const is evaluated by the compiler
+    void VisitConstVal(AST::ConstVal*) {}
+
+    void VisitWhile(AST::While* While) {
+        AddLoop(While->Body, nullptr, While->Expr);
+    }
+
+    void VisitFor(AST::For* For) {
+        if (For->Init) {
+            VisitStatement(For->Init);
+        }
+        AddLoop(For->Body, For->Step, For->Expr);
+    }
+
+    // The step and the condition are emitted after the body
+    void AddLoop(AST::Block* Body, AST::Expresion* Step, AST::Expresion* Condition) {
+        UInt32 start = Position;
+        UInt32 weight = Weight;
+        if (Depth < MaxLoopDepth) {
+            Weight *= LoopUseWeight;
+        }
+        Depth++;
+
+        for (auto expr : { (AST::Expresion*)Body, Step, Condition }) {
+            if (expr) {
+                VisitExpresion(expr);
+            }
+        }
+
+        Depth--;
+        Weight = weight;
+
+        // The value of the next iteration is read after the back edge
+        for (auto& interval : Plan.Intervals.Items) {
+            if (interval.End >= start) {
+                interval.End = std::max(interval.End, Position);
+            }
+        }
+    }
+
+    void VisitVar(AST::Var* Var) {
+        Visitor::VisitVar(Var);
+        AST::TypeDecl type = Var->VarType;
+        if (type.IsUnknown() && Var->Value) {
+            type = InferType(Var->Value);
+        }
+
+        auto& interval = Plan.Intervals.Add(Var->NameAtom);
+        interval.Start = Position;
+        interval.End = Position;
+        interval.Uses = Weight;
+        interval.Type = type;
+        interval.LivesToEnd = IsDestroyedAtEnd(type, Var->Value == nullptr);
+        if (Var->Value && Var->Value->Type == AST::ExpresionType::Identifier) {
+            USize source = Plan.Intervals.Find(((AST::Identifier*)Var->Value)->IDAtom);
+            if (source != Plan.Intervals.NotFound) {
+                interval.CopyOf = UInt32(source);
+            }
+        }
+    }
+
+    void VisitIdentifier(AST::Identifier* ID) {
+        AddUse(ID->IDAtom);
+    }
+
+    // Only the types known without emitting the value, the rest are Unknown
+    AST::TypeDecl InferType(AST::Expresion* Expr) {
+        switch (Expr->Type) {
+        case AST::ExpresionType::Constant:
+            return ((AST::Constant*)Expr)->ValueType;
+        case AST::ExpresionType::Identifier: {
+            USize index = Plan.Intervals.Find(((AST::Identifier*)Expr)->IDAtom);
+            return index != Plan.Intervals.NotFound ? Plan.Intervals.Get(index).Type : AST::TypeDecl();
+        }
+        case AST::ExpresionType::Group:
+            return InferType(((AST::Group*)Expr)->Value);
+        case AST::ExpresionType::Call: {
+            auto target = ((AST::Call*)Expr)->Target;
+            if (target->Type != AST::ExpresionType::Identifier)
+                break;
+
+            USize index = State.Functions.Find(((AST::Identifier*)target)->IDAtom);
+            return index != State.Functions.NotFound ? State.Functions.Get(index).Type : AST::TypeDecl();
+        }
+        case AST::ExpresionType::BinaryOp:
+            return InferType(((AST::BinaryOp*)Expr)->Left);
+        case AST::ExpresionType::Unary:
+            return InferType(((AST::Unary*)Expr)->Value);
+        case AST::ExpresionType::IncDec:
+            return InferType(((AST::IncDec*)Expr)->Expr);
+        default:
+            break;
+        }
+
+        return AST::TypeDecl();
+    }
+
+    void AddUse(Atom Name) {
+        USize index = Plan.Intervals.Find(Name);
+        if (index == Plan.Intervals.NotFound)
+            return;
+
+        auto& interval = Plan.Intervals.Get(index);
+        interval.End = std::max(interval.End, Position);
+        interval.Uses += Weight;
+    }
+
+    EmitterState& State;
+    RegisterPlan& Plan;
+    UInt32 Position = 0;
+    // Weight of a use in the current loop nest
+    UInt32 Weight = 1;
+    UInt32 Depth = 0;
+};
+
+void LinearScan(Vector<LiveInterval>& Intervals) {
+    Vector<UInt32> order(Intervals.size());
+    for (UInt32 i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](UInt32 A, UInt32 B) {
+        return Intervals[A].Start < Intervals[B].Start;
+    });
+
+    Vector<UInt32> active = {};
+    bool isFree[LastLocalRegister + 1] = {};
+    for (Byte r = FirstLocalRegister; r <= LastLocalRegister; r++) {
+        isFree[r] = true;
+    }
+
+    for (UInt32 i = 0; i < Intervals.size(); i++) {
+        if (Intervals[i].IsFixed) {
+            active.emplace_back(i);
+            isFree[Intervals[i].Reg] = false;
+        }
+    }
+
+    for (UInt32 i : order) {
+        auto& current = Intervals[i];
+        if (current.IsFixed)
+            continue;
+
+        // A value used by a definition is still live when the definition writes its result
+        std::erase_if(active, [&](UInt32 Index) {
+            auto& interval = Intervals[Index];
+            if (interval.End < current.Start) {
+                isFree[interval.Reg] = true;
+                return true;
+            }
+            return false;
+        });
+
+        // A definition from a value that dies in it takes its register
+        if (current.CopyOf != LiveInterval::NoCopy) {
+            auto it = std::find(active.begin(), active.end(), current.CopyOf);
+            if (it != active.end() && Intervals[current.CopyOf].End == current.Start) {
+                current.Reg = Intervals[current.CopyOf].Reg;
+                *it = i;
+                continue;
+            }
+        }
+
+        auto freeReg = std::find(&isFree[FirstLocalRegister], std::end(isFree), true);
+        if (freeReg != std::end(isFree)) {
+            current.Reg = Byte(freeReg - isFree);
+            isFree[current.Reg] = false;
+            active.emplace_back(i);
+            continue;
+        }
+
+        // Spills the least used value, the longest one on a tie
+        UInt32 spill = i;
+        for (UInt32 index : active) {
+            auto& interval = Intervals[index];
+            auto& candidate = Intervals[spill];
+            if (!interval.IsFixed &&
+                (interval.Uses < candidate.Uses || (interval.Uses == candidate.Uses && interval.End > candidate.End))) {
+                spill = index;
+            }
+        }
+
+        if (spill == i) {
+            current.IsSpilled = true;
+            continue;
+        }
+
+        auto& spilled = Intervals[spill];
+        spilled.IsSpilled = true;
+        current.Reg = spilled.Reg;
+        *std::find(active.begin(), active.end(), spill) = i;
+    }
+}
+
+void AllocateRegisters(EmitterState& State, AST::Function* ASTFn, Function& Fn) {
+    RegisterPlan& plan = State.LocalRegisters;
+    plan.Intervals.Clear();
+    plan.ByEnd.clear();
+    plan.NextExpired = 0;
+    plan.Position = 0;
+    std::fill(std::begin(plan.Owners), std::end(plan.Owners), RegisterPlan::NoOwner);
+    plan.IsEnabled = true;
+
+    // The parameters in registers are live since the entry
+    for (auto& param : ASTFn->Parameters) {
+        USize index = Fn.Locals.Find(param.NameAtom);
+        if (index == Fn.Locals.NotFound || !Fn.Locals.Get(index).IsRegister)
+            continue;
+
+        auto& interval = plan.Intervals.Add(param.NameAtom);
+        interval.Reg = Fn.Locals.Get(index).Reg;
+        interval.Type = param.Type;
+        interval.IsFixed = true;
+        interval.LivesToEnd = IsDestroyedAtEnd(param.Type, false);
+        plan.Owners[interval.Reg] = UInt32(plan.Intervals.Size() - 1);
+    }
+
+    LivenessBuilder builder{ .State = State, .Plan = plan };
+    for (auto stat : ASTFn->Body->Statements) {
+        builder.VisitStatement(stat);
+    }
+
+    // The epilogue is after the last statement
+    for (auto& interval : plan.Intervals.Items) {
+        if (interval.LivesToEnd) {
+            interval.End = builder.Position + 1;
+        }
+    }
+
+    LinearScan(plan.Intervals.Items);
+
+    for (UInt32 i = 0; i < plan.Intervals.Size(); i++) {
+        if (!plan.Intervals.Get(i).IsSpilled) {
+            plan.ByEnd.emplace_back(i);
+        }
+    }
+
+    std::stable_sort(plan.ByEnd.begin(), plan.ByEnd.end(), [&](UInt32 A, UInt32 B) {
+        return plan.Intervals.Get(A).End < plan.Intervals.Get(B).End;
+    });
+}
+
+void AdvanceRegisters(EmitterState& State) {
+    RegisterPlan& plan = State.LocalRegisters;
+    if (!plan.IsEnabled)
+        return;
+
+    plan.Position++;
+    while (plan.NextExpired < plan.ByEnd.size()) {
+        UInt32 index = plan.ByEnd[plan.NextExpired];
+        auto& interval = plan.Intervals.Get(index);
+        if (interval.End >= plan.Position)
+            break;
+
+        // A coalesced copy keeps the register
+        if (plan.Owners[interval.Reg] == index) {
+            plan.Owners[interval.Reg] = RegisterPlan::NoOwner;
+            State.DeallocateRegister(interval.Reg);
+        }
+        plan.NextExpired++;
+    }
+}
+
+bool ClaimRegister(EmitterState& State, Atom Name, Byte& Reg) {
+    RegisterPlan& plan = State.LocalRegisters;
+    if (!plan.IsEnabled)
+        return false;
+
+    USize index = plan.Intervals.Find(Name);
+    if (index == plan.Intervals.NotFound || plan.Intervals.Get(index).IsSpilled)
+        return false;
+
+    Reg = plan.Intervals.Get(index).Reg;
+    plan.Owners[Reg] = UInt32(index);
+    State.Registers[Reg].IsAllocated = true;
+    return true;
+}
+
+void ReleaseRegisters(EmitterState& State) {
+    RegisterPlan& plan = State.LocalRegisters;
+    for (Byte r = FirstLocalRegister; r <= LastLocalRegister; r++) {
+        if (plan.Owners[r] != RegisterPlan::NoOwner) {
+            plan.Owners[r] = RegisterPlan::NoOwner;
+            State.DeallocateRegister(r);
+        }
+    }
+
+    plan.IsEnabled = false;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "jkc/CodeGen/SymbolTable.h"
+#include "jkc/AST/Type.h"
+#include <jkr/Vector.h>
+
+namespace AST {
+
+struct Function;
+
+}
+
+namespace CodeGen {
+
+struct EmitterState;
+struct Function;
+
+// Registers given to the locals by the linear scan, the parameters are received in r1-r10
+static constexpr Byte FirstLocalRegister = 1;
+static constexpr Byte LastLocalRegister = 10;
+// The uses in a loop count as this many uses for each level of nesting, up to MaxLoopDepth levels
+static constexpr UInt32 LoopUseWeight = 8;
+static constexpr UInt32 MaxLoopDepth = 4;
+
+// The positions of a function are numbered in emission order,
+// a value is live from the position that defines it to the last position that uses it,
+// or to the end of the last loop that uses it
+struct LiveInterval {
+    static constexpr UInt32 NoCopy = UInt32(-1);
+
+    UInt32 Start = 0;
+    UInt32 End = 0;
+    // The uses in the loops and in the hot blocks weight more, the least used value is spilled
+    UInt64 Uses = 0;
+    // Type of the value, Unknown if it can't be inferred before the emission
+    AST::TypeDecl Type = {};
+    // Interval copied or read by the definition, the result can share its register
+    UInt32 CopyOf = NoCopy;
+    Byte Reg = 0;
+    bool IsSpilled = false;
+    // A parameter received in a register
+    bool IsFixed = false;
+    // The epilogue destroys the array or the object of the local
+    bool LivesToEnd = false;
+};
+
+// Poletto and Sarkar linear scan over FirstLocalRegister-LastLocalRegister, the intervals are never split:
+// a spilled value lives in the stack for all its life
+void LinearScan(Vector<LiveInterval>& Intervals);
+
+// Registers of the locals of the function being emitted, computed with a linear scan
+// over the live intervals before the emission of the body
+struct RegisterPlan {
+    static constexpr UInt32 NoOwner = UInt32(-1);
+
+    SymbolTable<LiveInterval> Intervals;
+    // Indices of the intervals in register ordered by End
+    Vector<UInt32> ByEnd;
+    USize NextExpired = 0;
+    // Statement being emitted
+    UInt32 Position = 0;
+    // Interval that holds each register
+    UInt32 Owners[LastLocalRegister + 1] = {};
+    bool IsEnabled = false;
+};
+
+void AllocateRegisters(EmitterState& State, AST::Function* ASTFn, Function& Fn);
+// Called before each statement, releases the registers of the locals that are dead
+void AdvanceRegisters(EmitterState& State);
+// The register of a declared local, returns false if the local lives in the stack
+bool ClaimRegister(EmitterState& State, Atom Name, Byte& Reg);
+void ReleaseRegisters(EmitterState& State);
+
+}
@@ -16,20 +16,53 @@ enum class CallConv {
     RegS,
 };
 
-struct AddressToResolve {
-    // Pointer in code to the address to resolve,
-    // for now used for resolve jumps.
+// A position in the code that the jumps refer to before it's known
+using Label = UInt32;
+
+// A jump to a label, emitted in the near form until the labels are resolved
+struct Relocation {
+    // Pointer in code to the jump
+    UInt32 IP;
+    Label Target;
+};
+
+struct StringReference {
+    // Pointer in code to the index of the string
+    UInt32 IP;
+    UInt32 Index;
+};
+
+// A conditional jump or a call of a condition or a call of the source,
+// written to the sites section so the profile counts it by site
+struct ProfileSite {
+    // Pointer in code to the instruction
     UInt32 IP;
+    // Ordinal of the site in the function of the source, see IR::Instruction::Site
+    UInt32 Site;
+    UInt64 Function;
+    bool IsCall;
+    // The jump is taken when the condition is false
+    bool IsNegated;
 };
 
 struct [[nodiscard]] Function {
-    Str Name = u8"";
+    StringView Name = {};
 
     AST::TypeDecl Type = {};
     CodeBuffer Code = {};
 
-    std::vector<AddressToResolve> ResolveReturns;
+    // The offset of each label
+    std::vector<UInt32> Labels;
+    std::vector<Relocation> Relocations;
+    // The label of the epilogue, where the returns jump
+    Label ReturnLabel = 0;
+    // The strings loaded by the code, relocated when the code is cached
+    std::vector<StringReference> StringRefs;
+    // Only recorded for the code emitted from the IR
+    std::vector<ProfileSite> ProfileSites;
     SymbolTable<Local> Locals = {};
+    // The consts declared in the body
+    SymbolTable<Constant> Constants = {};
     Byte CountOfArguments = 0;
     Byte RegisterArguments = 0;
     Byte StackArguments = 0;
@@ -38,9 +71,13 @@ struct [[nodiscard]] Function {
 
     UInt32 LibraryAddress = 0;
     UInt32 EntryAddress = 0;
+    // Key of the function in the profile, see EmitProfile::GetFunctionKey
+    UInt64 ProfileKey = 0;
 
     bool IsDefined = false;
     bool IsExtern = false;
+    // A extern function defined in other code file
+    bool IsImport = false;
     bool HasMultiReturn = false;
     CallConv CC = CallConv::Stack;
 
@@ -0,0 +1,292 @@
+#include "jkc/CodeGen/Peephole.h"
+#include "jkc/CodeGen/Decoder.h"
+#include "jkc/CodeGen/Assembler.h"
+#include <algorithm>
+
+namespace CodeGen {
+
+constexpr UInt32 NoIndex = 0xFFFF'FFFF;
+// Instructions visited to prove that a register is dead
+constexpr UInt32 LivenessBudget = 64;
+
+struct PeepholeSlot {
+    DecodedInstruction Inst = {};
+    // Index of the target of a jump
+    UInt32 Target = NoIndex;
+    bool IsTarget = false;
+    bool IsRemoved = false;
+    // The condition of the jump was inverted
+    bool IsNegated = false;
+};
+
+struct PeepholeOptimizer {
+    bool Decode() {
+        const Vector<Byte>& code = Fn.Code.Buff;
+        UInt32 size = UInt32(code.size());
+        Vector<UInt32> indices(size, NoIndex);
+
+        for (UInt32 offset = 0; offset < size;) {
+            PeepholeSlot slot = {};
+            if (!CodeGen::Decode(code.data(), size, offset, slot.Inst))
+                return false;
+
+            indices[offset] = UInt32(Slots.size());
+            Slots.emplace_back(slot);
+            offset += slot.Inst.Size;
+        }
+
+        for (auto& slot : Slots) {
+            if (!slot.Inst.IsJump())
+                continue;
+
+            UInt32 target = slot.Inst.GetTarget();
+            if (target >= size || indices[target] == NoIndex)
+                return false;
+            slot.Target = indices[target];
+            // The form is picked again when the code is encoded
+            slot.Inst.Op = codefile::GetNearJump(slot.Inst.Op);
+        }
+        return true;
+    }
+
+    UInt32 NextLive(UInt32 Index) const {
+        while (Index < Slots.size() && Slots[Index].IsRemoved) {
+            Index++;
+        }
+        return Index;
+    }
+
+    // A jump to a removed instruction lands in the next one
+    void Remove(UInt32 Index) {
+        Slots[Index].IsRemoved = true;
+        UInt32 next = NextLive(Index + 1);
+        if (Slots[Index].IsTarget && next < Slots.size()) {
+            Slots[next].IsTarget = true;
+        }
+    }
+
+    bool IsOp(UInt32 Index, codefile::OpCode Op) const {
+        return Index < Slots.size() && Slots[Index].Inst.Op == Op;
+    }
+
+    void MarkTargets() {
+        for (auto& slot : Slots) {
+            slot.IsTarget = false;
+        }
+
+        for (auto& slot : Slots) {
+            UInt32 target = slot.IsRemoved ? NoIndex : NextLive(slot.Target);
+            if (slot.Inst.IsJump() && target < Slots.size()) {
+                Slots[target].IsTarget = true;
+            }
+        }
+    }
+
+    // Reg is written before it's read in every path from Index,
+    // only r0 is live in a ret because the calls save the registers of the caller
+    bool IsDead(UInt32 Index, Byte Reg, UInt32& Budget) const {
+        for (UInt32 i = NextLive(Index); i < Slots.size(); i = NextLive(i + 1)) {
+            const PeepholeSlot& slot = Slots[i];
+            if (Budget-- == 0 || slot.Inst.Reads(Reg))
+                return false;
+            if (slot.Inst.Writes(Reg))
+                return true;
+
+            switch (slot.Inst.Op) {
+            case codefile::OpCode::Ret:
+                return Reg != 0;
+            case codefile::OpCode::RetC:
+                return true;
+            case codefile::OpCode::Call:
+            case codefile::OpCode::Brk:
+                return false;
+            case codefile::OpCode::Jmp:
+                // The budget stops the loops
+                i = slot.Target - 1;
+                break;
+            default:
+                if (slot.Inst.IsJump() && !IsDead(slot.Target, Reg, Budget))
+                    return false;
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool Run() {
+        bool changed = false;
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            MarkTargets();
+
+            for (UInt32 i = NextLive(0); i < Slots.size(); i = NextLive(i + 1)) {
+                progress |= Rewrite(i);
+            }
+            changed |= progress;
+        }
+        return changed;
+    }
+
+    bool Rewrite(UInt32 Index) {
+        DecodedInstruction& inst = Slots[Index].Inst;
+        UInt32 next = NextLive(Index + 1);
+
+        if (inst.Op == codefile::OpCode::Mov) {
+            // A self move or a move to a register that is written before it's read
+            UInt32 budget = LivenessBudget;
+            if (inst.R1 == inst.R2 || IsDead(next, inst.R1, budget)) {
+                Remove(Index);
+                return true;
+            }
+        }
+        else if (inst.Op == codefile::OpCode::Push) {
+            // Another path could reach the pop
+            if (!IsOp(next, codefile::OpCode::Pop) || Slots[next].Inst.R1 != inst.R1 || Slots[next].IsTarget)
+                return false;
+
+            Remove(Index);
+            Remove(next);
+            return true;
+        }
+        else if (inst.IsJump()) {
+            return RewriteJump(Index, next);
+        }
+
+        return ForwardMove(Index, next);
+    }
+
+    // The value is put directly in the destination of the next mov,
+    // like a constant that the emitter moves to other register
+    bool ForwardMove(UInt32 Index, UInt32 Next) {
+        DecodedInstruction& inst = Slots[Index].Inst;
+        const InstructionInfo& info = InstructionInfos[Byte(inst.Op)];
+        if (info.Writes != OperandR1 || (info.Reads & OperandR1) ||
+            !IsOp(Next, codefile::OpCode::Mov) || Slots[Next].IsTarget)
+            return false;
+
+        const DecodedInstruction& mov = Slots[Next].Inst;
+        UInt32 budget = LivenessBudget;
+        if (mov.R2 != inst.R1 || mov.R1 == inst.R1 || !IsDead(Next + 1, inst.R1, budget))
+            return false;
+
+        inst.R1 = mov.R1;
+        Remove(Next);
+        return true;
+    }
+
+    bool RewriteJump(UInt32 Index, UInt32 Next) {
+        PeepholeSlot& slot = Slots[Index];
+        bool changed = false;
+
+        // A loop of jumps is followed once
+        UInt32 target = NextLive(slot.Target);
+        for (UInt32 i = 0; i < Slots.size() && target != Index && IsOp(target, codefile::OpCode::Jmp); i++) {
+            target = NextLive(Slots[target].Target);
+        }
+
+        if (target != slot.Target) {
+            slot.Target = target;
+            changed = true;
+        }
+
+        if (target == Next) {
+            Remove(Index);
+            return true;
+        }
+
+        // A conditional jump over a jmp goes where the jmp goes with the opposite condition,
+        // as the back edge of a loop after the block of its phi moves was emptied
+        if (slot.Inst.Op != codefile::OpCode::Jmp && IsOp(Next, codefile::OpCode::Jmp) &&
+            !Slots[Next].IsTarget && target == NextLive(Next + 1)) {
+            slot.Inst.Op = codefile::GetNegatedJump(slot.Inst.Op);
+            slot.IsNegated = !slot.IsNegated;
+            slot.Target = Slots[Next].Target;
+            Slots[slot.Target].IsTarget = true;
+            Remove(Next);
+            return true;
+        }
+
+        if (slot.Inst.Op == codefile::OpCode::Jmp && IsOp(target, codefile::OpCode::Ret)) {
+            slot.Inst = {
+                .Op = codefile::OpCode::Ret,
+                .Offset = slot.Inst.Offset,
+                .Size = codefile::InstructionSizes[Byte(codefile::OpCode::Ret)],
+            };
+            slot.Target = NoIndex;
+            return true;
+        }
+
+        if (target < Slots.size()) {
+            Slots[target].IsTarget = true;
+        }
+
+        return changed;
+    }
+
+    // Index of the instruction that contains the offset
+    UInt32 Find(UInt32 Offset) const {
+        auto it = std::upper_bound(Slots.begin(), Slots.end(), Offset, [](UInt32 IP, const PeepholeSlot& Slot) {
+            return IP < Slot.Inst.Offset;
+        });
+        return UInt32(it - Slots.begin()) - 1;
+    }
+
+    void Encode() {
+        Assembler assembler = {};
+        Fn.Code.Clear();
+
+        // A label by instruction, a removed one is bound where the next starts
+        Label first = Label(Fn.Labels.size());
+        for (UInt32 i = 0; i <= Slots.size(); i++) {
+            (void)assembler.CreateLabel(Fn);
+        }
+
+        Vector<UInt32> offsets(Slots.size(), 0);
+        for (UInt32 i = 0; i < Slots.size(); i++) {
+            PeepholeSlot& slot = Slots[i];
+            assembler.BindLabel(Fn, first + i);
+            offsets[i] = UInt32(Fn.Code.Buff.size());
+            if (slot.IsRemoved)
+                continue;
+
+            if (slot.Inst.IsJump()) {
+                assembler.Jump(Fn, slot.Inst.Op, first + slot.Target);
+            }
+            else {
+                CodeGen::Encode(slot.Inst, Fn.Code.Buff);
+            }
+        }
+        assembler.BindLabel(Fn, first + UInt32(Slots.size()));
+
+        // The string references don't move inside of its instruction
+        for (auto& ref : Fn.StringRefs) {
+            UInt32 i = Find(ref.IP);
+            ref.IP = offsets[i] + (ref.IP - Slots[i].Inst.Offset);
+        }
+
+        // The sites of the removed jumps are never executed
+        std::erase_if(Fn.ProfileSites, [&](ProfileSite& Site) {
+            UInt32 i = Find(Site.IP);
+            Site.IP = offsets[i];
+            Site.IsNegated ^= Slots[i].IsNegated;
+            return Slots[i].IsRemoved;
+        });
+
+        assembler.ResolveLabels(Fn);
+    }
+
+    Function& Fn;
+    Vector<PeepholeSlot> Slots = {};
+};
+
+bool OptimizePeephole(Function& Fn) {
+    PeepholeOptimizer optimizer{ .Fn = Fn };
+    if (!optimizer.Decode() || !optimizer.Run())
+        return false;
+
+    optimizer.Encode();
+    return true;
+}
+
+}
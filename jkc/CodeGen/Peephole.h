@@ -0,0 +1,14 @@
+#pragma once
+#include "jkc/CodeGen/Function.h"
+
+namespace CodeGen {
+
+// Removes the self moves and the moves to dead registers, the push and pop of
+// the same register, the values and constants moved to other register and the
+// jumps over nothing, inverts the conditional jumps over a jmp, threads the jumps
+// to a jmp and replaces a jmp to a ret by a ret.
+// The jumps are relaxed again and the string references and profile sites relocated.
+// Returns true if the code changed
+bool OptimizePeephole(Function& Fn);
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "jkc/CodeGen/SymbolTable.h"
+#include "jkc/AST/Type.h"
+
+namespace CodeGen {
+
+struct [[nodiscard]] Field {
+    StringView Name = {};
+    AST::TypeDecl Type = {};
+    // Offset in bytes from the start of the object
+    UInt16 Offset = 0;
+    UInt16 Size = 0;
+};
+
+struct [[nodiscard]] Struct {
+    StringView Name = {};
+    SymbolTable<Field> Fields = {};
+    // Size in bytes of the packed fields
+    UInt16 Size = 0;
+    UInt16 Alignment = 1;
+};
+
+}
@@ -1,49 +1,72 @@
 #pragma once
-#include <jkr/String.h>
+#include "jkc/Lexer/Atom.h"
 #include <jkr/Vector.h>
 #include <unordered_map>
 #include <cassert>
 
+// Symbols keyed by the atom of their name. Most tables are small,
+// they are searched linearly until they grow past FlatSize
 template<typename T>
 struct SymbolTable {
-    using MapType = std::unordered_map<StringView, USize>;
     using VectorType = Vector<T>;
 
+    static constexpr USize FlatSize = 16;
+    static constexpr USize NotFound = USize(-1);
+
     SymbolTable() {}
     ~SymbolTable() {}
 
-    [[nodiscard]] MapType::iterator begin() { return Map.begin(); }
-
-    [[nodiscard]] MapType::const_iterator begin() const { return Map.begin(); }
+    decltype(auto) Add(Atom Key) {
+        auto& element = Items.emplace_back();
+        Keys.emplace_back(Key);
 
-    [[nodiscard]] MapType::iterator end() { return Map.end(); }
+        if (!Lookup.empty()) {
+            Lookup.emplace(Key, Keys.size() - 1);
+        }
+        else if (Keys.size() > FlatSize) {
+            for (USize i = 0; i < Keys.size(); i++) {
+                Lookup.emplace(Keys[i], i);
+            }
+        }
 
-    [[nodiscard]] MapType::const_iterator end() const { return Map.end(); }
-    
-    decltype(auto) Add(const StringView& Key) {
-        auto& element = Items.emplace_back();
-        Map.emplace(
-            Key, Items.size() - 1
-        );
         return element;
     }
 
-    MapType::iterator Find(const StringView& Key) {
-        return Map.find(Key);
+    // Returns the index of the symbol or NotFound
+    [[nodiscard]] USize Find(Atom Key) const {
+        if (!Lookup.empty()) {
+            auto it = Lookup.find(Key);
+            return it != Lookup.end() ? it->second : NotFound;
+        }
+
+        for (USize i = 0; i < Keys.size(); i++) {
+            if (Keys[i] == Key)
+                return i;
+        }
+
+        return NotFound;
     }
 
     [[nodiscard]] constexpr T& Get(USize Index) {
         assert(Index < Items.size() && "Index out of range");
-        return Items[Index]; 
+        return Items[Index];
     }
 
-    [[nodiscard]] constexpr USize Size() { return Items.size(); }
-    
+    [[nodiscard]] constexpr const T& Get(USize Index) const {
+        assert(Index < Items.size() && "Index out of range");
+        return Items[Index];
+    }
+
+    [[nodiscard]] constexpr USize Size() const { return Items.size(); }
+
     void Clear() {
-        Map.clear();
+        Keys.clear();
+        Lookup.clear();
         Items.clear();
     }
 
-    MapType Map;
+    Vector<Atom> Keys;
+    // Only used when there are more than FlatSize symbols
+    std::unordered_map<Atom, USize> Lookup;
     VectorType Items;
 };
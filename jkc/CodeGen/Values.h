@@ -18,7 +18,7 @@ struct Constant {
 };
 
 struct [[nodiscard]] Local {
-    Str Name = u8"";
+    StringView Name = {};
     AST::TypeDecl Type = {};
     union {
         Byte Index = 0;
@@ -26,10 +26,13 @@ struct [[nodiscard]] Local {
     };
     bool IsInitialized = false;
     bool IsRegister = false;
+    // The object was created by this function
+    // and must to be destroyed in the epilogue
+    bool OwnsObject = false;
 };
 
 struct [[nodiscard]] Global {
-    Str Name = u8"";
+    StringView Name = {};
     AST::TypeDecl Type = {};
     UInt32 Index = 0;
     Constant Value;
@@ -1,8 +1,13 @@
 #include "jkc/Compiler.h"
 #include "jkc/Parser/Parser.h"
 #include "jkc/AST/Utility.h"
+#include "jkc/AST/Statements.h"
 #include "jkc/CodeGen/Disassembler.h"
+#include "jkc/JobScheduler.h"
+#include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <unordered_map>
 
 static inline std::vector<Char> ReadFileContent(FILE* ErrorStream, const char* FileName, bool& Success) {
     std::ifstream file{ FileName, std::ios::ate | std::ios::binary };
@@ -23,12 +28,143 @@ static inline std::vector<Char> ReadFileContent(FILE* ErrorStream, const char* F
     return content;
 }
 
+static inline String GetOutputFile(const char* FileName) {
+    String outputFile = (Str)FileName;
+    outputFile = outputFile.substr(0, outputFile.find_last_of('.'));
+    outputFile += u8".jk";
+    return outputFile;
+}
+
+// The libraries are referenced by the name of its file
+static inline StringView GetFileName(const StringView& Path) {
+    USize separator = Path.find_last_of(u8"/\\");
+    return separator == StringView::npos ? Path : Path.substr(separator + 1);
+}
+
+// State of a module in a multi module build, it's kept by the compiler
+// so the next build only parses and emits the modules that changed
+struct ModuleJob {
+    std::vector<Char> Content = {};
+    AST::Program Program = AST::Program(String());
+    String OutputFile = {};
+    // The diagnostics of the job, they are printed in the order of the modules
+    FILE* Errors = nullptr;
+    bool Success = false;
+
+    // Program is valid for a source with this write time
+    std::filesystem::file_time_type WriteTime = {};
+    bool IsParsed = false;
+    bool Reparsed = false;
+
+    // Emitted code file and the options used
+    std::string Output = {};
+    CodeGen::FileType OutputType = CodeGen::FileType::Executable;
+    CodeGen::EmitOptions OutputOptions = {};
+
+    ModuleJob() = default;
+    ModuleJob(const ModuleJob&) = delete;
+    ModuleJob& operator=(const ModuleJob&) = delete;
+
+    ~ModuleJob() {
+        if (Errors)
+            fclose(Errors);
+    }
+
+    FILE* OpenErrors(FILE* ErrorStream) {
+        if (!Errors)
+            Errors = tmpfile();
+        return Errors ? Errors : ErrorStream;
+    }
+
+    void FlushErrors(FILE* ErrorStream) {
+        if (!Errors)
+            return;
+
+        char buffer[1024];
+        rewind(Errors);
+        while (USize size = fread(buffer, 1, sizeof(buffer), Errors)) {
+            fwrite(buffer, 1, size, ErrorStream);
+        }
+        fclose(Errors);
+        Errors = nullptr;
+    }
+};
+
+static bool SameSignature(const AST::Function* A, const AST::Function* B) {
+    if (A->FunctionType != B->FunctionType || A->Parameters.size() != B->Parameters.size())
+        return false;
+
+    for (USize i = 0; i < A->Parameters.size(); i++) {
+        if (A->Parameters[i].Type != B->Parameters[i].Type)
+            return false;
+    }
+
+    return true;
+}
+
+// Merges the declarations of the modules, an extern function of a library
+// that is in the build must match its definition
+static bool CheckImports(FILE* ErrorStream, const Vector<ModuleJob*>& Jobs, const Vector<SourceModule>& Modules) {
+    using FunctionTable = std::unordered_map<Atom, const AST::Function*>;
+    std::unordered_map<StringView, FunctionTable> libraries = {};
+
+    for (USize i = 0; i < Jobs.size(); i++) {
+        if (Modules[i].FileTy != CodeGen::FileType::Library)
+            continue;
+
+        FunctionTable& functions = libraries[GetFileName(Jobs[i]->OutputFile)];
+        for (auto stat : Jobs[i]->Program.Statements) {
+            if (stat->Type != AST::StatementType::Function)
+                continue;
+
+            auto fn = (const AST::Function*)stat;
+            if (fn->IsDefined)
+                functions.emplace(fn->NameAtom, fn);
+        }
+    }
+
+    bool success = true;
+    for (auto job : Jobs) {
+        for (auto stat : job->Program.Statements) {
+            if (stat->Type != AST::StatementType::Function)
+                continue;
+
+            auto fn = (const AST::Function*)stat;
+            if (!fn->IsExtern)
+                continue;
+
+            StringView libName = GetFileName(fn->LibraryRef);
+            auto lib = libraries.find(libName);
+            if (lib == libraries.end())
+                continue;
+
+            auto def = lib->second.find(fn->NameAtom);
+            if (def == lib->second.end()) {
+                fprintf(ErrorStream, "%s:%llu: Error: '%.*s' isn't defined in '%.*s'\n",
+                        fn->Location.FileName, fn->Location.Line,
+                        (int)fn->Name.size(), (const char*)fn->Name.data(),
+                        (int)libName.size(), (const char*)libName.data());
+                success = false;
+            }
+            else if (!SameSignature(fn, def->second)) {
+                fprintf(ErrorStream, "%s:%llu: Error: '%.*s' doesn't match its definition in '%.*s'\n",
+                        fn->Location.FileName, fn->Location.Line,
+                        (int)fn->Name.size(), (const char*)fn->Name.data(),
+                        (int)libName.size(), (const char*)libName.data());
+                success = false;
+            }
+        }
+    }
+
+    return success;
+}
+
 Compiler::Compiler(FILE* ErrorStream, const ProfileData& PD) :
     ErrorStream(ErrorStream), Emitter(ErrorStream), PD(PD), SourceParser(ErrorStream) {}
 
 Compiler::~Compiler() {}
 
-CompileResult Compiler::CompileFromSource(const char* FileName, CodeGen::EmitOptions Options) {
+CompileResult Compiler::CompileFromSource(const char* FileName, CodeGen::EmitOptions Options, CodeGen::FileType FileTy) {
     bool success = true;
     std::vector<Char> content = ReadFileContent(ErrorStream, FileName, success);
     if (!success)
@@ -45,9 +181,7 @@ CompileResult Compiler::CompileFromSource(const char* FileName, CodeGen::EmitOpt
         return CompileResult(false);
     }
 
-    String outputFile = (Str)FileName;
-    outputFile = outputFile.substr(0, outputFile.find_last_of('.'));
-    outputFile += u8".jk";
+    String outputFile = GetOutputFile(FileName);
 
     // CodeGen
     std::ofstream file{ (const char*)outputFile.c_str(), std::ios::binary};
@@ -55,7 +189,7 @@ CompileResult Compiler::CompileFromSource(const char* FileName, CodeGen::EmitOpt
     BeginAction(FileName, ActionType::CodeGen, false);
     Emitter.Emit(
         program,
-        CodeGen::FileType::Executable,
+        FileTy,
         Options,
         file
     );
@@ -70,6 +204,112 @@ CompileResult Compiler::CompileFromSource(const char* FileName, CodeGen::EmitOpt
     return CompileResult(true);
 }
 
+CompileResult Compiler::CompileModules(const Vector<SourceModule>& Modules, CodeGen::EmitOptions Options,
+                                       UInt32 Jobs) {
+    JobScheduler scheduler = JobScheduler(Jobs);
+    Vector<ModuleJob*> jobs = {};
+    bool success = true;
+
+    for (auto& module : Modules) {
+        auto& job = KeptModules[(Str)module.FileName];
+        if (!job) {
+            job = std::make_unique<ModuleJob>();
+        }
+
+        if (std::find(jobs.begin(), jobs.end(), job.get()) != jobs.end()) {
+            fprintf(ErrorStream, "Error: the module '%s' is repeated\n", module.FileName);
+            return CompileResult(false);
+        }
+        jobs.emplace_back(job.get());
+    }
+
+    // Parsing, each job has its own parser
+    BeginAction(nullptr, ActionType::Parsing, false);
+    scheduler.Run(Modules.size(), [&](USize Index) {
+        ModuleJob& job = *jobs[Index];
+        const char* fileName = Modules[Index].FileName;
+        FILE* errors = job.OpenErrors(ErrorStream);
+
+        // A module parsed by a previous build is reused while the source doesn't change
+        std::error_code error;
+        std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(fileName, error);
+        if (job.IsParsed && !error && writeTime == job.WriteTime) {
+            job.Reparsed = false;
+            job.Success = true;
+            return;
+        }
+
+        job.IsParsed = false;
+        job.Reparsed = true;
+        job.Output.clear();
+
+        bool read = true;
+        job.Content = ReadFileContent(errors, fileName, read);
+        if (!read) {
+            job.Success = false;
+            return;
+        }
+
+        Parser parser = Parser(errors);
+        job.Program = parser.ParseContent(fileName, StringView(job.Content.data(), job.Content.size()));
+        job.OutputFile = GetOutputFile(fileName);
+        job.Success = parser.Success();
+        job.IsParsed = job.Success;
+        job.WriteTime = writeTime;
+    });
+
+    for (auto job : jobs) {
+        job->FlushErrors(ErrorStream);
+        success &= job->Success;
+    }
+    success = success && CheckImports(ErrorStream, jobs, Modules);
+    EndAction(nullptr, ActionType::Parsing, !success);
+
+    if (!success) {
+        return CompileResult(false);
+    }
+
+    // CodeGen, each job has its own emitter
+    BeginAction(nullptr, ActionType::CodeGen, false);
+    scheduler.Run(Modules.size(), [&](USize Index) {
+        ModuleJob& job = *jobs[Index];
+        CodeGen::FileType fileTy = Modules[Index].FileTy;
+
+        // The code file only depends of the module and the options,
+        // a profile can change without its path
+        bool reuse = !job.Reparsed && !job.Output.empty() &&
+            job.OutputType == fileTy &&
+            job.OutputOptions.Debug == Options.Debug &&
+            job.OutputOptions.OptimizationLevel == Options.OptimizationLevel &&
+            job.OutputOptions.InlineThreshold == Options.InlineThreshold &&
+            !job.OutputOptions.ProfilePath && !Options.ProfilePath;
+
+        if (!reuse) {
+            CodeGen::EmitterState emitter = CodeGen::EmitterState(job.OpenErrors(ErrorStream));
+            std::ostringstream output = {};
+            emitter.Emit(job.Program, fileTy, Options, output);
+
+            job.Success = emitter.Success;
+            job.Output = job.Success ? output.str() : std::string();
+            job.OutputType = fileTy;
+            job.OutputOptions = Options;
+        }
+
+        if (job.Success) {
+            std::ofstream file{ (const char*)job.OutputFile.c_str(), std::ios::binary };
+            file.write(job.Output.data(), job.Output.size());
+        }
+    });
+
+    for (auto job : jobs) {
+        job->FlushErrors(ErrorStream);
+        success &= job->Success;
+    }
+    EndAction(nullptr, ActionType::CodeGen, !success);
+
+    return CompileResult(success);
+}
+
 CompileResult Compiler::Disassembly(const char* FileName, FILE* Output) {
     bool success = true;
 
@@ -1,7 +1,9 @@
 #pragma once
 #include "jkc/Parser/Parser.h"
 #include "jkc/CodeGen/Emitter/EmitterState.h"
+#include <memory>
 #include <stdio.h>
+#include <unordered_map>
 
 enum class ActionType {
     Parsing,
@@ -13,20 +15,34 @@ enum CompilerOption {
     OptionNone = 0,
 };
 
+// FileName is nullptr for the phases of a multi module build
 struct ProfileData {
     void(*BeginAction)(const char*, ActionType, bool);
     void(*EndAction)(const char*, ActionType, bool);
 };
 
+struct ModuleJob;
+
 struct CompileResult {
     bool Success;
 };
 
+struct SourceModule {
+    const char* FileName;
+    CodeGen::FileType FileTy = CodeGen::FileType::Executable;
+};
+
 struct Compiler {
     Compiler(FILE* ErrorStream, const ProfileData& PD);
     ~Compiler();
 
-    CompileResult CompileFromSource(const char* FileName, CodeGen::EmitOptions Options);
+    CompileResult CompileFromSource(const char* FileName, CodeGen::EmitOptions Options,
+                                    CodeGen::FileType FileTy = CodeGen::FileType::Executable);
+    // Parses and emits the modules in parallel, each one in its own file,
+    // the extern functions of a library in the build are checked against it.
+    // The modules are kept, so the next call only rebuilds the changed ones
+    CompileResult CompileModules(const Vector<SourceModule>& Modules, CodeGen::EmitOptions Options,
+                                 UInt32 Jobs = 0);
     CompileResult Disassembly(const char* FileName, FILE* Output);
 
     constexpr void BeginAction(const char* FileName, ActionType Type, bool Error) {
@@ -46,5 +62,8 @@ struct Compiler {
     ProfileData PD;
 
     Parser SourceParser;
+
+    // The modules of the previous builds by file name
+    std::unordered_map<String, std::unique_ptr<ModuleJob>> KeptModules;
 };
 
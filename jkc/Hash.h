@@ -0,0 +1,20 @@
+#pragma once
+#include <jkr/CoreTypes.h>
+
+// 64 bits FNV-1a, the hashes are stored in the compilation cache
+inline constexpr UInt64 HashSeed = 0xCBF2'9CE4'8422'2325;
+
+inline UInt64 HashBytes(UInt64 Hash, const void* Data, USize Size) {
+    const Byte* bytes = (const Byte*)Data;
+    for (USize i = 0; i < Size; i++) {
+        Hash ^= bytes[i];
+        Hash *= 0x0000'0100'0000'01B3;
+    }
+
+    return Hash;
+}
+
+template<typename T>
+inline UInt64 HashValue(UInt64 Hash, const T& Value) {
+    return HashBytes(Hash, &Value, sizeof(T));
+}
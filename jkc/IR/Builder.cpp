@@ -0,0 +1,798 @@
+#include "jkc/IR/Builder.h"
+#include "jkc/CodeGen/Emitter/EmitterState.h"
+#include "jkc/CodeGen/Emitter/ConstFold.h"
+#include "jkc/AST/Visitor.h"
+#include <jkr/Utility.h>
+#include <unordered_map>
+#include <bit>
+
+namespace IR {
+
+static constexpr bool IsInteger(const AST::TypeDecl& Type) {
+    return Type.IsInt() || Type.IsUInt();
+}
+
+static constexpr bool IsArithmetic(const AST::TypeDecl& Type) {
+    return IsInteger(Type) || Type.IsFloat();
+}
+
+// The epilogue of the emitter destroys the arrays of the locals
+static constexpr bool IsOwnedArray(const AST::TypeDecl& Type) {
+    return !Type.HasConst() && Type.HasArray() && !Type.IsConstString();
+}
+
+static OpCode ToOpCode(AST::BinaryOperation Op) {
+    switch (Op) {
+    case AST::BinaryOperation::Add:
+    case AST::BinaryOperation::AddEqual:
+        return OpCode::Add;
+    case AST::BinaryOperation::Sub:
+    case AST::BinaryOperation::SubEqual:
+        return OpCode::Sub;
+    case AST::BinaryOperation::Mul:
+    case AST::BinaryOperation::MulEqual:
+        return OpCode::Mul;
+    case AST::BinaryOperation::Div:
+    case AST::BinaryOperation::DivEqual:
+        return OpCode::Div;
+    case AST::BinaryOperation::BinaryAnd:
+    case AST::BinaryOperation::BinaryAndEqual:
+        return OpCode::And;
+    case AST::BinaryOperation::BinaryOr:
+    case AST::BinaryOperation::BinaryOrEqual:
+        return OpCode::Or;
+    case AST::BinaryOperation::BinaryXOr:
+    case AST::BinaryOperation::BinaryXOrEqual:
+        return OpCode::XOr;
+    case AST::BinaryOperation::BinaryShl:
+    case AST::BinaryOperation::BinaryShlEqual:
+        return OpCode::Shl;
+    default:
+        return OpCode::Shr;
+    }
+}
+
+struct FunctionBuilder : AST::Visitor<FunctionBuilder, bool, Instruction*> {
+    struct Variable {
+        AST::TypeDecl Type = {};
+    };
+
+    bool Build(AST::Function* ASTFn) {
+        if (Fn.CC != CodeGen::CallConv::Register)
+            return false;
+
+        Result.Name = ASTFn->Name;
+        Result.ReturnType = Fn.Type;
+        Result.Location = ASTFn->Location;
+        SiteFunction = CodeGen::EmitProfile::GetFunctionKey(ASTFn);
+        Result.Entry = Block = CreateBlock();
+        SealBlock(Block);
+
+        for (USize i = 0; i < ASTFn->Parameters.size(); i++) {
+            auto& param = ASTFn->Parameters[i];
+            if (IsOwnedArray(param.Type) || param.Type.IsUnknown())
+                return false;
+
+            Variables.Add(param.NameAtom).Type = param.Type;
+            Instruction* value = Result.Create(Block, OpCode::Param, param.Type);
+            value->Imm = i;
+            WriteVariable(param.NameAtom, Block, value);
+        }
+
+        if (!BuildBlock(ASTFn->Body) || IsUndefined)
+            return false;
+
+        if (Block->GetTerminator() == nullptr) {
+            Result.Create(Block, OpCode::Return, AST::TypeDecl::Void());
+        }
+
+        ComputeOrder(Result);
+        return true;
+    }
+
+    BasicBlock* CreateBlock() {
+        BasicBlock* block = Result.CreateBlock();
+        Definitions.emplace_back();
+        Sealed.emplace_back(false);
+        Unreachable.emplace_back(false);
+        return block;
+    }
+
+    // All the predecessors of the block are known
+    void SealBlock(BasicBlock* Target) {
+        Sealed[Target->Id] = true;
+        Unreachable[Target->Id] = Target->Preds.empty() && Target != Result.Entry;
+
+        for (USize i = 0; i < IncompletePhis.size();) {
+            auto [name, phi] = IncompletePhis[i];
+            if (phi->Parent != Target) {
+                i++;
+                continue;
+            }
+
+            IncompletePhis.erase(IncompletePhis.begin() + i);
+            if (AddPhiOperands(name, phi) == nullptr) {
+                IsUndefined = true;
+            }
+        }
+    }
+
+    // The code after a return is unreachable, it's built in a block without predecessors
+    void EndBlock() {
+        Block = CreateBlock();
+        SealBlock(Block);
+    }
+
+    // The unreachable blocks don't flow into the reachable ones
+    void AddSuccessor(BasicBlock* Target) {
+        if (!Unreachable[Block->Id]) {
+            AddEdge(Block, Target);
+        }
+    }
+
+    void Jump(BasicBlock* Target) {
+        Result.Create(Block, OpCode::Jump, AST::TypeDecl::Void());
+        AddSuccessor(Target);
+    }
+
+    // Variables
+
+    void WriteVariable(Atom Name, BasicBlock* Target, Instruction* Value) {
+        Definitions[Target->Id].insert_or_assign(Name, Value);
+    }
+
+    Instruction* ReadVariable(Atom Name, BasicBlock* Target) {
+        auto& definitions = Definitions[Target->Id];
+        auto it = definitions.find(Name);
+        if (it != definitions.end())
+            return Resolve(it->second);
+
+        return ReadVariableRecursive(Name, Target);
+    }
+
+    Instruction* ReadVariableRecursive(Atom Name, BasicBlock* Target) {
+        const AST::TypeDecl& type = Variables.Get(Variables.Find(Name)).Type;
+        Instruction* value = nullptr;
+
+        if (!Sealed[Target->Id]) {
+            value = Result.Create(Target, OpCode::Phi, type);
+            IncompletePhis.emplace_back(Name, value);
+        }
+        else if (Target->Preds.size() == 1) {
+            value = ReadVariable(Name, Target->Preds[0]);
+        }
+        else if (Target == Result.Entry) {
+            // Used before it's initialized
+            return nullptr;
+        }
+        else if (Target->Preds.empty()) {
+            // Any value, the block is removed
+            value = Result.CreateConst(Target, type, 0);
+        }
+        else {
+            Instruction* phi = Result.Create(Target, OpCode::Phi, type);
+            WriteVariable(Name, Target, phi);
+            value = AddPhiOperands(Name, phi);
+        }
+
+        if (value) {
+            WriteVariable(Name, Target, value);
+        }
+        return value;
+    }
+
+    Instruction* AddPhiOperands(Atom Name, Instruction* Phi) {
+        for (BasicBlock* pred : Phi->Parent->Preds) {
+            Instruction* value = ReadVariable(Name, pred);
+            if (value == nullptr)
+                return nullptr;
+
+            AddOperand(Phi, value);
+        }
+
+        return TryRemoveTrivialPhi(Phi);
+    }
+
+    // A phi that only merges one value is replaced by the value
+    Instruction* TryRemoveTrivialPhi(Instruction* Phi) {
+        Instruction* same = nullptr;
+        for (Instruction* operand : Phi->Operands) {
+            if (operand == same || operand == Phi)
+                continue;
+            if (same != nullptr)
+                return Phi;
+            same = operand;
+        }
+
+        if (same == nullptr)
+            return nullptr;
+
+        Vector<Instruction*> users = {};
+        for (Instruction* user : Phi->Users) {
+            if (user != Phi && user->Is(OpCode::Phi)) {
+                users.emplace_back(user);
+            }
+        }
+
+        ReplaceAllUses(Phi, same);
+        RemoveInstruction(Phi);
+        Forwards.insert_or_assign(Phi, same);
+
+        for (Instruction* user : users) {
+            if (!user->IsDead) {
+                (void)TryRemoveTrivialPhi(user);
+            }
+        }
+
+        return Resolve(same);
+    }
+
+    // The definitions can point to a removed phi
+    Instruction* Resolve(Instruction* Value) {
+        while (Value->IsDead) {
+            Value = Forwards.at(Value);
+        }
+        return Value;
+    }
+
+    // Statements
+
+    bool BuildBlock(AST::Block* Body) {
+        for (auto stat : Body->Statements) {
+            if (!VisitStatement(stat))
+                return false;
+        }
+        return true;
+    }
+
+    bool VisitConstVal(AST::ConstVal* ConstVal) {
+        if (IsDeclared(ConstVal->NameAtom))
+            return false;
+
+        CodeGen::Constant value = {};
+        if (!CodeGen::EvaluateConstant(State, ConstVal->Value, &Constants, value) ||
+            value.Type != ConstVal->ConstType)
+            return false;
+
+        Constants.Add(ConstVal->NameAtom) = value;
+        return true;
+    }
+
+    bool VisitExpresionStatement(AST::ExpresionStatement* Stat) {
+        auto value = Stat->Value;
+        if (value->Type == AST::ExpresionType::Block)
+            return BuildBlock((AST::Block*)value);
+
+        return BuildUnused(value);
+    }
+
+    bool VisitWhile(AST::While* While) {
+        return BuildLoop(While->Body, nullptr, While->Expr);
+    }
+
+    bool VisitFor(AST::For* For) {
+        if (For->Init && !VisitStatement(For->Init))
+            return false;
+
+        return BuildLoop(For->Body, For->Step, For->Expr);
+    }
+
+    // A expresion whose value is dropped
+    bool BuildUnused(AST::Expresion* Value) {
+        while (Value->Type == AST::ExpresionType::Group) {
+            Value = ((AST::Group*)Value)->Value;
+        }
+
+        // The result of a call can be unused
+        if (Value->Type == AST::ExpresionType::Call)
+            return BuildCall((AST::Call*)Value, true) != nullptr;
+
+        return VisitExpresion(Value) != nullptr;
+    }
+
+    bool VisitReturn(AST::Return* Ret) {
+        Instruction* ret = nullptr;
+        if (Ret->Value) {
+            Instruction* value = VisitExpresion(Ret->Value);
+            if (value == nullptr || value->Type != Fn.Type)
+                return false;
+
+            ret = Result.Create(Block, OpCode::Return, AST::TypeDecl::Void());
+            AddOperand(ret, value);
+        }
+        else if (Fn.Type.IsVoid()) {
+            ret = Result.Create(Block, OpCode::Return, AST::TypeDecl::Void());
+        }
+        else {
+            return false;
+        }
+
+        ret->Location = Ret->Location;
+        EndBlock();
+        return true;
+    }
+
+    // The redefinitions are reported by the emitter
+    bool IsDeclared(Atom Name) {
+        return Variables.Find(Name) != Variables.NotFound ||
+            Constants.Find(Name) != Constants.NotFound ||
+            State.Globals.Find(Name) != State.Globals.NotFound ||
+            State.Constants.Find(Name) != State.Constants.NotFound;
+    }
+
+    bool VisitVar(AST::Var* Var) {
+        if (IsDeclared(Var->NameAtom))
+            return false;
+
+        AST::TypeDecl type = Var->VarType;
+        if (Var->Value == nullptr) {
+            // The arrays and the objects are created by the local
+            if (!IsArithmetic(type) && !type.IsByte())
+                return false;
+
+            Variables.Add(Var->NameAtom).Type = type;
+            return true;
+        }
+
+        if (Var->Value->Type == AST::ExpresionType::ArrayList)
+            return false;
+
+        Instruction* value = VisitExpresion(Var->Value);
+        if (value == nullptr || value->Type.IsVoid())
+            return false;
+
+        if (type.IsUnknown()) {
+            type = value->Type;
+        }
+        else if (type != value->Type) {
+            return false;
+        }
+
+        if (IsOwnedArray(type))
+            return false;
+
+        Variables.Add(Var->NameAtom).Type = type;
+        WriteVariable(Var->NameAtom, Block, value);
+        return true;
+    }
+
+    bool VisitIf(AST::If* If) {
+        BasicBlock* then = CreateBlock();
+        BasicBlock* otherwise = CreateBlock();
+        if (!BuildCondition(If->Expr, then, otherwise))
+            return false;
+
+        SealBlock(then);
+        SealBlock(otherwise);
+
+        BasicBlock* join = CreateBlock();
+        Block = then;
+        if (!BuildBlock(If->Body))
+            return false;
+        Jump(join);
+
+        Block = otherwise;
+        if (If->Elif) {
+            if (!VisitIf(If->Elif))
+                return false;
+        }
+        else if (If->ElseBlock) {
+            if (!BuildBlock(If->ElseBlock))
+                return false;
+        }
+        Jump(join);
+
+        SealBlock(join);
+        Block = join;
+        return true;
+    }
+
+    // The loop is inverted, a guard skips it and the condition is tested again at the
+    // bottom of the body. The body is sealed after the back edge, with the phis of the
+    // values that change in the loop. Each edge to a block with phis comes from a block
+    // with a single successor
+    bool BuildLoop(AST::Block* Body, AST::Expresion* Step, AST::Expresion* Condition) {
+        BasicBlock* body = CreateBlock();
+        BasicBlock* exit = CreateBlock();
+
+        if (Condition) {
+            BasicBlock* preheader = CreateBlock();
+            BasicBlock* skip = CreateBlock();
+            if (!BuildCondition(Condition, preheader, skip))
+                return false;
+
+            SealBlock(preheader);
+            SealBlock(skip);
+            Block = skip;
+            Jump(exit);
+            Block = preheader;
+        }
+        Jump(body);
+
+        Block = body;
+        if (!BuildBlock(Body) || (Step && !BuildUnused(Step)))
+            return false;
+
+        BasicBlock* latch = CreateBlock();
+        if (Condition) {
+            BasicBlock* done = CreateBlock();
+            if (!BuildCondition(Condition, latch, done))
+                return false;
+
+            SealBlock(done);
+            Block = done;
+            Jump(exit);
+        }
+        else {
+            Jump(latch);
+        }
+
+        SealBlock(latch);
+        Block = latch;
+        Jump(body);
+        SealBlock(body);
+
+        SealBlock(exit);
+        Block = exit;
+        return true;
+    }
+
+    bool BuildCondition(AST::Expresion* Expr, BasicBlock* Then, BasicBlock* Otherwise) {
+        while (Expr->Type == AST::ExpresionType::Group) {
+            Expr = ((AST::Group*)Expr)->Value;
+        }
+
+        Instruction* left = nullptr;
+        Instruction* right = nullptr;
+        Predicate predicate = Predicate::NotEqual;
+
+        auto binOp = (AST::BinaryOp*)Expr;
+        if (Expr->Type == AST::ExpresionType::BinaryOp && binOp->Op >= AST::BinaryOperation::Comparision) {
+            left = VisitExpresion(binOp->Left);
+            right = VisitExpresion(binOp->Right);
+            if (left == nullptr || right == nullptr || left->Type != right->Type || !IsArithmetic(left->Type))
+                return false;
+
+            predicate = Predicate(UInt(binOp->Op) - UInt(AST::BinaryOperation::Comparision));
+        }
+        else {
+            // A value is true if it isn't zero
+            left = VisitExpresion(Expr);
+            if (left == nullptr || !IsInteger(left->Type))
+                return false;
+
+            right = Result.CreateConst(Block, left->Type, 0);
+        }
+
+        Instruction* branch = Result.Create(Block, OpCode::Branch, AST::TypeDecl::Void());
+        branch->Aux = Byte(predicate);
+        branch->Location = Expr->Location;
+        branch->Site = ++CountOfSites;
+        branch->SiteFunction = SiteFunction;
+        if (const CodeGen::SiteCounts* counts = State.Profile.Find(SiteFunction, branch->Site)) {
+            branch->Counts[0] = counts->Counts[0];
+            branch->Counts[1] = counts->Counts[1];
+        }
+        AddOperand(branch, left);
+        AddOperand(branch, right);
+        AddSuccessor(Then);
+        AddSuccessor(Otherwise);
+        return true;
+    }
+
+    // Expresions, nullptr if the expresion can't be built
+
+    Instruction* VisitGroup(AST::Group* Group) {
+        return VisitExpresion(Group->Value);
+    }
+
+    Instruction* VisitCall(AST::Call* Call) {
+        return BuildCall(Call, false);
+    }
+
+    Instruction* VisitConstant(AST::Constant* Constant) {
+        const AST::TypeDecl& type = Constant->ValueType;
+        if (type.IsConstString()) {
+            Instruction* string = Result.Create(Block, OpCode::ConstString, type);
+            string->String = Constant->String;
+            string->Location = Constant->Location;
+            return string;
+        }
+
+        if (!IsArithmetic(type) && !type.IsByte())
+            return nullptr;
+
+        return Result.CreateConst(Block, type, Constant->Unsigned);
+    }
+
+    Instruction* VisitIdentifier(AST::Identifier* ID) {
+        if (Variables.Find(ID->IDAtom) != Variables.NotFound)
+            return ReadVariable(ID->IDAtom, Block);
+
+        for (SymbolTable<CodeGen::Constant>* constants : { &Constants, &State.Constants }) {
+            USize index = constants->Find(ID->IDAtom);
+            if (index != constants->NotFound) {
+                auto& constant = constants->Get(index);
+                return Result.CreateConst(Block, constant.Type, constant.Unsigned);
+            }
+        }
+
+        USize index = State.Globals.Find(ID->IDAtom);
+        if (index == State.Globals.NotFound)
+            return nullptr;
+
+        auto& global = State.Globals.Get(index);
+        // The type of a global without type is known after the emission of its value
+        if (global.Type.IsUnknown() || global.Index > Const16Max)
+            return nullptr;
+
+        Instruction* value = Result.Create(Block, OpCode::GlobalGet, global.Type);
+        value->Imm = global.Index;
+        return value;
+    }
+
+    Instruction* BuildCall(AST::Call* Call, bool IsUnused) {
+        if (Call->Target->Type != AST::ExpresionType::Identifier)
+            return nullptr;
+
+        USize index = State.Functions.Find(((AST::Identifier*)Call->Target)->IDAtom);
+        if (index == State.Functions.NotFound)
+            return nullptr;
+
+        CodeGen::Function& target = State.Functions.Get(index);
+        if ((!target.IsDefined && !target.IsExtern) ||
+            target.CC != CodeGen::CallConv::Register ||
+            target.CountOfArguments != Call->Arguments.size() ||
+            target.Address > Const32Max)
+            return nullptr;
+
+        if (target.Type.IsVoid() && !IsUnused)
+            return nullptr;
+
+        // The arguments are evaluated from the last to the first like the emitter does
+        Vector<Instruction*> arguments(Call->Arguments.size(), nullptr);
+        for (USize i = Call->Arguments.size(); i > 0; i--) {
+            Instruction* arg = VisitExpresion(Call->Arguments[i - 1]);
+            if (arg == nullptr || arg->Type != target.Locals.Get(i - 1).Type)
+                return nullptr;
+            arguments[i - 1] = arg;
+        }
+
+        Instruction* call = Result.Create(Block, OpCode::Call, target.Type);
+        call->Imm = target.Address;
+        call->Location = Call->Location;
+        call->Site = ++CountOfSites;
+        call->SiteFunction = SiteFunction;
+        for (Instruction* arg : arguments) {
+            AddOperand(call, arg);
+        }
+        return call;
+    }
+
+    Instruction* BuildArithmetic(OpCode Op, Instruction* Left, Instruction* Right) {
+        if (Left->Type != Right->Type)
+            return nullptr;
+
+        // The bitwise operations are only for integers
+        if (Op <= OpCode::Div ? !IsArithmetic(Left->Type) : !IsInteger(Left->Type))
+            return nullptr;
+
+        Instruction* value = Result.Create(Block, Op, Left->Type);
+        AddOperand(value, Left);
+        AddOperand(value, Right);
+        return value;
+    }
+
+    Instruction* VisitBinaryOp(AST::BinaryOp* BinOp) {
+        // The comparisions are only used by the conditions
+        if (BinOp->Op >= AST::BinaryOperation::Comparision)
+            return nullptr;
+
+        Instruction* left = VisitExpresion(BinOp->Left);
+        if (left == nullptr)
+            return nullptr;
+        Instruction* right = VisitExpresion(BinOp->Right);
+        if (right == nullptr)
+            return nullptr;
+
+        Instruction* value = BuildArithmetic(ToOpCode(BinOp->Op), left, right);
+        if (value == nullptr)
+            return nullptr;
+
+        value->Location = BinOp->Location;
+        if (BinOp->Op >= AST::BinaryOperation::AddEqual) {
+            return Store(BinOp->Left, value) ? value : nullptr;
+        }
+        return value;
+    }
+
+    Instruction* VisitUnary(AST::Unary* Unary) {
+        Instruction* operand = VisitExpresion(Unary->Value);
+        if (operand == nullptr)
+            return nullptr;
+
+        // The negative literals of every type are constants
+        UInt64 folded = 0;
+        if (operand->Is(OpCode::Const) && CodeGen::FoldUnary(Unary->Op, operand->Type, operand->Imm, folded))
+            return Result.CreateConst(Block, operand->Type, folded);
+
+        if (!IsInteger(operand->Type))
+            return nullptr;
+
+        OpCode op = Unary->Op == AST::UnaryOperation::Negate ? OpCode::Neg : OpCode::Not;
+        Instruction* value = Result.Create(Block, op, operand->Type);
+        AddOperand(value, operand);
+        return value;
+    }
+
+    const CodeGen::Field* GetField(Instruction* Object, AST::Dot* Dot) {
+        if (!Object->Type.IsStruct() || Dot->Right == nullptr)
+            return nullptr;
+
+        USize index = State.Structs.Find(Object->Type.StructAtom);
+        if (index == State.Structs.NotFound)
+            return nullptr;
+
+        auto& fields = State.Structs.Get(index).Fields;
+        USize field = fields.Find(((AST::Identifier*)Dot->Right)->IDAtom);
+        if (field == fields.NotFound)
+            return nullptr;
+
+        const AST::TypeDecl& type = fields.Get(field).Type;
+        if (!type.IsNumeric() && !type.IsStruct() && !type.HasArray())
+            return nullptr;
+
+        return &fields.Get(field);
+    }
+
+    Instruction* VisitDot(AST::Dot* Dot) {
+        Instruction* object = VisitExpresion(Dot->Left);
+        if (object == nullptr)
+            return nullptr;
+
+        const CodeGen::Field* field = GetField(object, Dot);
+        if (field == nullptr)
+            return nullptr;
+
+        Instruction* value = Result.Create(Block, OpCode::LoadField, field->Type);
+        value->Imm = field->Offset;
+        value->Aux = Byte(State.TypeToArrayElement(field->Type));
+        AddOperand(value, object);
+        return value;
+    }
+
+    Instruction* VisitArrayAccess(AST::ArrayAccess* ArrayAccess) {
+        Instruction* array = VisitExpresion(ArrayAccess->Expr);
+        if (array == nullptr)
+            return nullptr;
+        Instruction* index = VisitExpresion(ArrayAccess->IndexExpr);
+        if (index == nullptr)
+            return nullptr;
+
+        if (array->IsConstant() || !array->Type.HasArray() || !IsInteger(index->Type))
+            return nullptr;
+
+        AST::TypeDecl elementType = array->Type;
+        elementType.Flags ^= AST::TypeDecl::Array;
+        elementType.ArrayLen = 0;
+
+        Instruction* value = Result.Create(Block, OpCode::ArrayLoad, elementType);
+        value->Location = ArrayAccess->Location;
+        AddOperand(value, array);
+        AddOperand(value, index);
+        return value;
+    }
+
+    Instruction* VisitIncDec(AST::IncDec* IncDec) {
+        Instruction* old = VisitExpresion(IncDec->Expr);
+        if (old == nullptr || IncDec->Expr->Type != AST::ExpresionType::Identifier)
+            return nullptr;
+
+        UInt64 one = old->Type.IsFloat() ? std::bit_cast<UInt64>(1.0) : 1;
+        Instruction* value = BuildArithmetic(
+            IncDec->Increment ? OpCode::Add : OpCode::Sub,
+            old, Result.CreateConst(Block, old->Type, one)
+        );
+        if (value == nullptr || !Store(IncDec->Expr, value))
+            return nullptr;
+
+        return IncDec->After ? old : value;
+    }
+
+    Instruction* VisitAssignment(AST::Assignment* Assignment) {
+        if (Assignment->Source->Type == AST::ExpresionType::ArrayList)
+            return nullptr;
+
+        if (Assignment->Target->Type == AST::ExpresionType::Dot) {
+            auto dot = (AST::Dot*)Assignment->Target;
+            Instruction* object = VisitExpresion(dot->Left);
+            if (object == nullptr)
+                return nullptr;
+
+            const CodeGen::Field* field = GetField(object, dot);
+            Instruction* source = VisitExpresion(Assignment->Source);
+            if (field == nullptr || source == nullptr)
+                return nullptr;
+
+            // A integer constant that fits is stored in a Byte field, as in the emitter
+            if (field->Type.IsByte() && source->Is(OpCode::Const) && IsInteger(source->Type) && source->Imm <= ByteMax) {
+                source = Result.CreateConst(Block, field->Type, source->Imm);
+            }
+            if (source->Type != field->Type)
+                return nullptr;
+
+            Instruction* store = Result.Create(Block, OpCode::StoreField, AST::TypeDecl::Void());
+            store->Imm = field->Offset;
+            store->Aux = Byte(State.TypeToArrayElement(field->Type));
+            AddOperand(store, source);
+            AddOperand(store, object);
+            return source;
+        }
+
+        Instruction* source = VisitExpresion(Assignment->Source);
+        if (source == nullptr || !Store(Assignment->Target, source))
+            return nullptr;
+
+        return source;
+    }
+
+    // Assigns a value to a local or a global
+    bool Store(AST::Expresion* Target, Instruction* Value) {
+        if (Target->Type != AST::ExpresionType::Identifier)
+            return false;
+
+        auto id = (AST::Identifier*)Target;
+        USize index = Variables.Find(id->IDAtom);
+        if (index != Variables.NotFound) {
+            if (Variables.Get(index).Type != Value->Type)
+                return false;
+
+            WriteVariable(id->IDAtom, Block, Value);
+            return true;
+        }
+
+        index = State.Globals.Find(id->IDAtom);
+        if (index == State.Globals.NotFound)
+            return false;
+
+        auto& global = State.Globals.Get(index);
+        if (global.Type != Value->Type || global.Index > Const16Max)
+            return false;
+
+        Instruction* store = Result.Create(Block, OpCode::GlobalSet, AST::TypeDecl::Void());
+        store->Imm = global.Index;
+        AddOperand(store, Value);
+        return true;
+    }
+
+    CodeGen::EmitterState& State;
+    CodeGen::Function& Fn;
+    Function& Result;
+    BasicBlock* Block = nullptr;
+
+    SymbolTable<Variable> Variables = {};
+    // The consts of the function
+    SymbolTable<CodeGen::Constant> Constants = {};
+    // Current definition of each variable in each block
+    Vector<std::unordered_map<Atom, Instruction*>> Definitions = {};
+    Vector<bool> Sealed = {};
+    // Blocks without predecessors after a return
+    Vector<bool> Unreachable = {};
+    // Phis of the blocks that weren't sealed, completed when the block is sealed
+    Vector<std::pair<Atom, Instruction*>> IncompletePhis = {};
+    // The value that replaced each trivial phi
+    std::unordered_map<Instruction*, Instruction*> Forwards = {};
+    // A phi completed by SealBlock used a uninitialized variable
+    bool IsUndefined = false;
+    // The conditions and calls are numbered in the order they are built,
+    // the same for every build of the same function
+    UInt64 SiteFunction = 0;
+    UInt32 CountOfSites = 0;
+};
+
+bool BuildFunction(CodeGen::EmitterState& State, AST::Function* ASTFn, CodeGen::Function& Fn, Function& Result) {
+    FunctionBuilder builder{ .State = State, .Fn = Fn, .Result = Result };
+    return builder.Build(ASTFn);
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "jkc/IR/IR.h"
+
+namespace AST {
+
+struct Function;
+
+}
+
+namespace CodeGen {
+
+struct EmitterState;
+struct Function;
+
+}
+
+namespace IR {
+
+// Builds the SSA form of a function with the algorithm of Braun et al.
+// Returns false without reporting errors if the function uses something
+// that the IR can't represent or that the emitter must to diagnose,
+// then the function is emitted directly from the AST
+bool BuildFunction(CodeGen::EmitterState& State, AST::Function* ASTFn, CodeGen::Function& Fn, Function& Result);
+
+}
@@ -0,0 +1,246 @@
+#include "jkc/IR/IR.h"
+#include <algorithm>
+#include <cassert>
+
+namespace IR {
+
+BasicBlock* Function::CreateBlock() {
+    BasicBlock& block = BlockPool.emplace_back();
+    block.Id = UInt32(BlockPool.size() - 1);
+    return &block;
+}
+
+Instruction* Function::Create(BasicBlock* Block, OpCode Op, const AST::TypeDecl& Type) {
+    Instruction& inst = InstructionPool.emplace_back();
+    inst.Op = Op;
+    inst.Type = Type;
+    inst.Parent = Block;
+    inst.Id = UInt32(InstructionPool.size() - 1);
+
+    if (Op == OpCode::Phi) {
+        auto it = std::find_if(Block->Instructions.begin(), Block->Instructions.end(), [](Instruction* I) {
+            return !I->Is(OpCode::Phi);
+        });
+        Block->Instructions.insert(it, &inst);
+    }
+    else {
+        Block->Instructions.emplace_back(&inst);
+    }
+
+    return &inst;
+}
+
+Instruction* Function::CreateConst(BasicBlock* Block, const AST::TypeDecl& Type, UInt64 Value) {
+    Instruction* inst = Create(Block, OpCode::Const, Type);
+    inst->Imm = Value;
+    return inst;
+}
+
+static void RemoveUser(Instruction* Operand, Instruction* User) {
+    auto it = std::find(Operand->Users.begin(), Operand->Users.end(), User);
+    assert(it != Operand->Users.end() && "The instruction isn't a user");
+    Operand->Users.erase(it);
+}
+
+void AddOperand(Instruction* Inst, Instruction* Operand) {
+    Inst->Operands.emplace_back(Operand);
+    Operand->Users.emplace_back(Inst);
+}
+
+void DropOperands(Instruction* Inst) {
+    for (Instruction* operand : Inst->Operands) {
+        RemoveUser(operand, Inst);
+    }
+    Inst->Operands.clear();
+}
+
+void SetOperand(Instruction* Inst, USize Index, Instruction* Operand) {
+    RemoveUser(Inst->Operands[Index], Inst);
+    Inst->Operands[Index] = Operand;
+    Operand->Users.emplace_back(Inst);
+}
+
+void ReplaceAllUses(Instruction* From, Instruction* To) {
+    assert(From != To && "Replacing a instruction with itself");
+    for (Instruction* user : From->Users) {
+        for (auto& operand : user->Operands) {
+            if (operand == From) {
+                operand = To;
+                To->Users.emplace_back(user);
+                // A user appears once for each use
+                break;
+            }
+        }
+    }
+    From->Users.clear();
+}
+
+void RemoveInstruction(Instruction* Inst) {
+    assert(Inst->Users.empty() && "Removing a used instruction");
+    DropOperands(Inst);
+
+    auto& instructions = Inst->Parent->Instructions;
+    instructions.erase(std::find(instructions.begin(), instructions.end(), Inst));
+    Inst->IsDead = true;
+}
+
+void MoveBeforeTerminator(Instruction* Inst, BasicBlock* Block) {
+    auto& from = Inst->Parent->Instructions;
+    from.erase(std::find(from.begin(), from.end(), Inst));
+
+    auto& to = Block->Instructions;
+    to.insert(Block->GetTerminator() ? to.end() - 1 : to.end(), Inst);
+    Inst->Parent = Block;
+}
+
+void AddEdge(BasicBlock* From, BasicBlock* To) {
+    From->Succs.emplace_back(To);
+    To->Preds.emplace_back(From);
+}
+
+void RemoveEdge(BasicBlock* From, BasicBlock* To) {
+    auto succ = std::find(From->Succs.begin(), From->Succs.end(), To);
+    assert(succ != From->Succs.end() && "The blocks aren't connected");
+    From->Succs.erase(succ);
+
+    auto pred = std::find(To->Preds.begin(), To->Preds.end(), From);
+    USize index = USize(pred - To->Preds.begin());
+    To->Preds.erase(pred);
+
+    for (Instruction* inst : To->Instructions) {
+        if (!inst->Is(OpCode::Phi))
+            break;
+
+        RemoveUser(inst->Operands[index], inst);
+        inst->Operands.erase(inst->Operands.begin() + index);
+    }
+}
+
+// The values of the unreachable blocks are only used by unreachable blocks
+static void RemoveBlocks(const Vector<BasicBlock*>& Blocks) {
+    for (BasicBlock* block : Blocks) {
+        while (!block->Succs.empty()) {
+            RemoveEdge(block, block->Succs.back());
+        }
+    }
+
+    for (BasicBlock* block : Blocks) {
+        block->IsDead = true;
+        for (Instruction* inst : block->Instructions) {
+            inst->IsDead = true;
+        }
+    }
+
+    for (BasicBlock* block : Blocks) {
+        for (Instruction* inst : block->Instructions) {
+            for (Instruction* operand : inst->Operands) {
+                if (!operand->IsDead) {
+                    RemoveUser(operand, inst);
+                }
+            }
+            inst->Operands.clear();
+            inst->Users.clear();
+        }
+        block->Instructions.clear();
+    }
+}
+
+// The profile puts the successor of a branch that runs more times next
+static bool IsFalseHotter(const BasicBlock* Block) {
+    const Instruction* last = Block->Instructions.empty() ? nullptr : Block->Instructions.back();
+    return last && last->Is(OpCode::Branch) && last->Counts[1] > last->Counts[0];
+}
+
+void ComputeOrder(Function& Fn) {
+    Vector<BasicBlock*> postOrder = {};
+    Vector<bool> visited(Fn.BlockPool.size(), false);
+    // Block and count of the successors visited, the last one is visited first
+    // so the target of a taken branch is the next block, like the body of a loop before its exit
+    Vector<std::pair<BasicBlock*, USize>> stack = {};
+
+    stack.emplace_back(Fn.Entry, 0);
+    visited[Fn.Entry->Id] = true;
+    while (!stack.empty()) {
+        auto& [block, next] = stack.back();
+        if (next < block->Succs.size()) {
+            USize index = block->Succs.size() - ++next;
+            if (IsFalseHotter(block)) {
+                index = block->Succs.size() - 1 - index;
+            }
+
+            BasicBlock* succ = block->Succs[index];
+            if (!visited[succ->Id]) {
+                visited[succ->Id] = true;
+                stack.emplace_back(succ, 0);
+            }
+            continue;
+        }
+
+        postOrder.emplace_back(block);
+        stack.pop_back();
+    }
+
+    Vector<BasicBlock*> unreachable = {};
+    for (auto& block : Fn.BlockPool) {
+        if (!block.IsDead && !visited[block.Id]) {
+            unreachable.emplace_back(&block);
+        }
+    }
+    RemoveBlocks(unreachable);
+
+    Fn.Blocks.assign(postOrder.rbegin(), postOrder.rend());
+    for (UInt32 i = 0; i < Fn.Blocks.size(); i++) {
+        Fn.Blocks[i]->Order = i;
+    }
+}
+
+static BasicBlock* Intersect(BasicBlock* A, BasicBlock* B) {
+    while (A != B) {
+        while (A->Order > B->Order) {
+            A = A->IDom;
+        }
+        while (B->Order > A->Order) {
+            B = B->IDom;
+        }
+    }
+    return A;
+}
+
+void ComputeDominators(Function& Fn) {
+    for (BasicBlock* block : Fn.Blocks) {
+        block->IDom = nullptr;
+    }
+    Fn.Entry->IDom = Fn.Entry;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (BasicBlock* block : Fn.Blocks) {
+            if (block == Fn.Entry)
+                continue;
+
+            BasicBlock* idom = nullptr;
+            for (BasicBlock* pred : block->Preds) {
+                if (pred->IDom == nullptr)
+                    continue;
+                idom = idom ? Intersect(pred, idom) : pred;
+            }
+
+            if (block->IDom != idom) {
+                block->IDom = idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool Dominates(const BasicBlock* A, const BasicBlock* B) {
+    while (B != A) {
+        if (B->IDom == B)
+            return false;
+        B = B->IDom;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include "jkc/AST/Type.h"
+#include "jkc/Lexer/Token.h"
+#include <jkr/Vector.h>
+#include <deque>
+
+// Typed SSA form of a function between the AST and the bytecode,
+// every optimization that needs to see more than one expression works on it
+namespace IR {
+
+enum class OpCode : Byte {
+    // Values
+    Const,
+    ConstString,
+    Param,
+    Phi,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    And,
+    Or,
+    XOr,
+    Shl,
+    Shr,
+    Neg,
+    Not,
+    GlobalGet,
+    LoadField,
+    ArrayLoad,
+    Call,
+
+    // Side effects
+    GlobalSet,
+    StoreField,
+
+    // Terminators
+    Jump,
+    Branch,
+    Return,
+};
+
+enum class Predicate : Byte {
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+};
+
+struct BasicBlock;
+
+struct [[nodiscard]] Instruction {
+    OpCode Op = OpCode::Const;
+    AST::TypeDecl Type = {};
+    Vector<Instruction*> Operands;
+    // The instructions that have this one as operand, once per use
+    Vector<Instruction*> Users;
+
+    // Const: the bits of the value
+    // Param: index of the parameter
+    // GlobalGet/GlobalSet: index of the global
+    // LoadField/StoreField: offset of the field
+    // Call: address of the function
+    UInt64 Imm = 0;
+    // LoadField/StoreField: codefile::ArrayElement of the field
+    // Branch: Predicate
+    Byte Aux = 0;
+    // ConstString: the literal as written in the source
+    StringView String = {};
+    SourceLocation Location = SourceLocation();
+    // Branch/Call: ordinal of the condition or the call of the source in the function
+    // SiteFunction, the key of its profile counts. 0 if it isn't a site
+    UInt32 Site = 0;
+    UInt64 SiteFunction = 0;
+    // Branch: times the condition was true and false in the profile, zero without it
+    UInt64 Counts[2] = {};
+
+    BasicBlock* Parent = nullptr;
+    UInt32 Id = 0;
+    bool IsDead = false;
+
+    [[nodiscard]] constexpr bool Is(OpCode Code) const { return Op == Code; }
+    [[nodiscard]] constexpr bool IsConstant() const { return Op == OpCode::Const || Op == OpCode::ConstString; }
+    [[nodiscard]] constexpr bool IsTerminator() const { return Op >= OpCode::Jump; }
+    [[nodiscard]] constexpr bool IsBinary() const { return Op >= OpCode::Add && Op <= OpCode::Shr; }
+    [[nodiscard]] constexpr bool IsCommutative() const {
+        return Op == OpCode::Add || Op == OpCode::Mul || Op == OpCode::And || Op == OpCode::Or || Op == OpCode::XOr;
+    }
+    // Without side effects and only depends on its operands
+    [[nodiscard]] constexpr bool IsPure() const {
+        return IsConstant() || (Op >= OpCode::Add && Op <= OpCode::Not);
+    }
+    // Needs a register or a stack slot
+    [[nodiscard]] constexpr bool HasValue() const {
+        return !IsConstant() && Op < OpCode::GlobalSet && !Type.IsVoid();
+    }
+};
+
+struct [[nodiscard]] BasicBlock {
+    // The phis are first and the terminator is the last instruction
+    Vector<Instruction*> Instructions;
+    // The operands of the phis are in the order of Preds
+    Vector<BasicBlock*> Preds;
+    // Jump: the target, Branch: the target if true and the target if false
+    Vector<BasicBlock*> Succs;
+
+    BasicBlock* IDom = nullptr;
+    // Index in the reverse post order
+    UInt32 Order = 0;
+    UInt32 Id = 0;
+    bool IsDead = false;
+
+    [[nodiscard]] Instruction* GetTerminator() const {
+        if (Instructions.empty() || !Instructions.back()->IsTerminator())
+            return nullptr;
+        return Instructions.back();
+    }
+};
+
+struct [[nodiscard]] Function {
+    BasicBlock* CreateBlock();
+    // Appends the instruction to Block, a phi is put before the other instructions
+    Instruction* Create(BasicBlock* Block, OpCode Op, const AST::TypeDecl& Type);
+    Instruction* CreateConst(BasicBlock* Block, const AST::TypeDecl& Type, UInt64 Value);
+
+    StringView Name = {};
+    AST::TypeDecl ReturnType = {};
+    SourceLocation Location = SourceLocation();
+    BasicBlock* Entry = nullptr;
+    // The live blocks in reverse post order, updated by ComputeOrder
+    Vector<BasicBlock*> Blocks;
+
+    // Stable storage, the removed ones are marked as dead
+    std::deque<Instruction> InstructionPool;
+    std::deque<BasicBlock> BlockPool;
+};
+
+void AddOperand(Instruction* Inst, Instruction* Operand);
+// Removes the instruction from the users of its operands
+void DropOperands(Instruction* Inst);
+void SetOperand(Instruction* Inst, USize Index, Instruction* Operand);
+void ReplaceAllUses(Instruction* From, Instruction* To);
+// Removes the instruction from its block, it must to be unused
+void RemoveInstruction(Instruction* Inst);
+// Inserts Inst before the terminator of Block
+void MoveBeforeTerminator(Instruction* Inst, BasicBlock* Block);
+
+void AddEdge(BasicBlock* From, BasicBlock* To);
+// Removes a edge and the operands of the phis that came from it
+void RemoveEdge(BasicBlock* From, BasicBlock* To);
+
+// Orders the blocks in reverse post order and removes the unreachable ones,
+// the first successor of a block is put after it when it can, or the one that
+// the profile counts more times for a branch
+void ComputeOrder(Function& Fn);
+// Immediate dominators, Cooper, Harvey and Kennedy over the reverse post order
+void ComputeDominators(Function& Fn);
+[[nodiscard]] bool Dominates(const BasicBlock* A, const BasicBlock* B);
+
+}
@@ -0,0 +1,252 @@
+#include "jkc/IR/Inliner.h"
+#include "jkc/IR/Builder.h"
+#include "jkc/IR/PassManager.h"
+#include "jkc/AST/Visitor.h"
+#include "jkc/Hash.h"
+#include <algorithm>
+
+namespace IR {
+
+// Collects the calls to the functions of the module in a body
+struct CallCollector : AST::Visitor<CallCollector> {
+    // The value of a const is evaluated by the compiler
+    void VisitConstVal(AST::ConstVal*) {}
+
+    void VisitCall(AST::Call* Call) {
+        Visitor::VisitCall(Call);
+
+        if (Call->Target->Type != AST::ExpresionType::Identifier)
+            return;
+
+        USize index = State.Functions.Find(((AST::Identifier*)Call->Target)->IDAtom);
+        if (index == State.Functions.NotFound || Callees[index].Declaration == nullptr)
+            return;
+
+        Callees[index].CallSites++;
+        if (std::find(Calls.begin(), Calls.end(), UInt32(index)) == Calls.end()) {
+            Calls.emplace_back(UInt32(index));
+        }
+    }
+
+    CodeGen::EmitterState& State;
+    Vector<Inliner::Callee>& Callees;
+    Vector<UInt32>& Calls;
+};
+
+void Inliner::Analyze(AST::Program& Program) {
+    Callees.clear();
+    Callees.resize(State.Functions.Size());
+
+    for (auto stat : Program.Statements) {
+        if (stat->Type != AST::StatementType::Function)
+            continue;
+
+        auto fn = (AST::Function*)stat;
+        USize index = State.Functions.Find(fn->NameAtom);
+        if (fn->IsDefined && index != State.Functions.NotFound) {
+            Callees[index].Declaration = fn;
+        }
+    }
+
+    for (auto& callee : Callees) {
+        if (callee.Declaration == nullptr)
+            continue;
+
+        CallCollector collector{ .State = State, .Callees = Callees, .Calls = callee.Calls };
+        collector.VisitExpresion(callee.Declaration->Body);
+    }
+}
+
+UInt64 Inliner::HashCallees(UInt32 Address) const {
+    UInt64 hash = HashSeed;
+    Vector<UInt32> current = { Address };
+    for (UInt32 depth = 0; depth < MaxDepth && !current.empty(); depth++) {
+        Vector<UInt32> next = {};
+        for (UInt32 caller : current) {
+            for (UInt32 address : Callees[caller].Calls) {
+                // The call sites decide if it's inlined
+                const Callee& callee = Callees[address];
+                hash = HashValue(hash, callee.Declaration->BodyHash);
+                hash = HashValue(hash, callee.CallSites);
+                next.emplace_back(address);
+            }
+        }
+        current = std::move(next);
+    }
+    return hash;
+}
+
+// The instructions that emit code, the constants are put in the instructions that use them
+static UInt32 Measure(const Function& Fn) {
+    UInt32 size = 0;
+    for (BasicBlock* block : Fn.Blocks) {
+        for (Instruction* inst : block->Instructions) {
+            if (!inst->IsConstant() && !inst->Is(OpCode::Param) && !inst->Is(OpCode::Phi)) {
+                size++;
+            }
+        }
+    }
+    return size;
+}
+
+Function* Inliner::GetBody(UInt32 Address) {
+    Callee& callee = Callees[Address];
+    if (callee.IsBuilt)
+        return callee.Body.get();
+
+    callee.IsBuilt = true;
+    // A recursive function would be inlined until MaxDepth for nothing
+    if (callee.Declaration == nullptr ||
+        std::find(callee.Calls.begin(), callee.Calls.end(), Address) != callee.Calls.end())
+        return nullptr;
+
+    auto body = std::make_unique<Function>();
+    if (!BuildFunction(State, callee.Declaration, State.Functions.Get(Address), *body))
+        return nullptr;
+
+    PassManager passes{ State.CurrentOptions.OptimizationLevel };
+    passes.Run(*body);
+
+    callee.Size = Measure(*body);
+    callee.Body = std::move(body);
+    return callee.Body.get();
+}
+
+// Each call site gets a copy of the body. With a profile a call that never ran
+// stays a call and one that ran is inlined by the size of its own copy
+bool Inliner::ShouldInline(const Instruction* Call, const Callee& Target) const {
+    if (Target.Size <= AlwaysInlineSize)
+        return true;
+
+    if (const CodeGen::SiteCounts* counts = State.Profile.Find(Call->SiteFunction, Call->Site))
+        return counts->Counts[0] != 0 && Target.Size <= State.CurrentOptions.InlineThreshold;
+
+    return Target.Size * Target.CallSites <= State.CurrentOptions.InlineThreshold;
+}
+
+static void InlineCall(Function& Fn, Instruction* Call, const Function& Body) {
+    BasicBlock* block = Call->Parent;
+    BasicBlock* next = Fn.CreateBlock();
+
+    // The code after the call continues in a new block
+    auto position = std::find(block->Instructions.begin(), block->Instructions.end(), Call) + 1;
+    next->Instructions.assign(position, block->Instructions.end());
+    block->Instructions.erase(position, block->Instructions.end());
+    for (Instruction* inst : next->Instructions) {
+        inst->Parent = next;
+    }
+
+    next->Succs = std::move(block->Succs);
+    block->Succs.clear();
+    for (BasicBlock* succ : next->Succs) {
+        std::replace(succ->Preds.begin(), succ->Preds.end(), block, next);
+    }
+
+    Vector<BasicBlock*> blocks(Body.BlockPool.size(), nullptr);
+    Vector<Instruction*> values(Body.InstructionPool.size(), nullptr);
+    for (BasicBlock* from : Body.Blocks) {
+        blocks[from->Id] = Fn.CreateBlock();
+    }
+
+    // The operands are set after, a phi can use a value defined later
+    Vector<Instruction*> returns = {};
+    for (BasicBlock* from : Body.Blocks) {
+        BasicBlock* to = blocks[from->Id];
+        for (BasicBlock* pred : from->Preds) {
+            to->Preds.emplace_back(blocks[pred->Id]);
+        }
+        for (BasicBlock* succ : from->Succs) {
+            to->Succs.emplace_back(blocks[succ->Id]);
+        }
+
+        for (Instruction* inst : from->Instructions) {
+            if (inst->Is(OpCode::Param)) {
+                values[inst->Id] = Call->Operands[inst->Imm];
+            }
+            else if (inst->Is(OpCode::Return)) {
+                values[inst->Id] = Fn.Create(to, OpCode::Jump, AST::TypeDecl::Void());
+                AddEdge(to, next);
+                returns.emplace_back(inst);
+            }
+            else {
+                Instruction* clone = Fn.Create(to, inst->Op, inst->Type);
+                clone->Imm = inst->Imm;
+                clone->Aux = inst->Aux;
+                clone->String = inst->String;
+                clone->Location = inst->Location;
+                clone->Site = inst->Site;
+                clone->SiteFunction = inst->SiteFunction;
+                clone->Counts[0] = inst->Counts[0];
+                clone->Counts[1] = inst->Counts[1];
+                values[inst->Id] = clone;
+            }
+        }
+    }
+
+    for (BasicBlock* from : Body.Blocks) {
+        for (Instruction* inst : from->Instructions) {
+            if (inst->Is(OpCode::Param) || inst->Is(OpCode::Return))
+                continue;
+
+            for (Instruction* operand : inst->Operands) {
+                AddOperand(values[inst->Id], values[operand->Id]);
+            }
+        }
+    }
+
+    Fn.Create(block, OpCode::Jump, AST::TypeDecl::Void());
+    AddEdge(block, blocks[Body.Entry->Id]);
+
+    // The returned values meet in the new block, in the order of its predecessors
+    if (!Call->Users.empty()) {
+        Instruction* result = nullptr;
+        if (returns.size() == 1) {
+            result = values[returns[0]->Operands[0]->Id];
+        }
+        else {
+            result = Fn.Create(next, OpCode::Phi, Call->Type);
+            for (Instruction* ret : returns) {
+                AddOperand(result, values[ret->Operands[0]->Id]);
+            }
+        }
+        ReplaceAllUses(Call, result);
+    }
+    RemoveInstruction(Call);
+}
+
+bool Inliner::Run(Function& Fn, UInt32 Address) {
+    UInt32 size = Measure(Fn);
+    bool changed = false;
+
+    for (UInt32 depth = 0; depth < MaxDepth; depth++) {
+        Vector<Instruction*> calls = {};
+        for (BasicBlock* block : Fn.Blocks) {
+            for (Instruction* inst : block->Instructions) {
+                if (inst->Is(OpCode::Call) && inst->Imm != Address) {
+                    calls.emplace_back(inst);
+                }
+            }
+        }
+
+        bool inlined = false;
+        for (Instruction* call : calls) {
+            UInt32 callee = UInt32(call->Imm);
+            Function* body = GetBody(callee);
+            if (body == nullptr || !ShouldInline(call, Callees[callee]) || size + Callees[callee].Size > MaxCallerSize)
+                continue;
+
+            InlineCall(Fn, call, *body);
+            size += Callees[callee].Size;
+            inlined = true;
+        }
+
+        if (!inlined)
+            break;
+
+        ComputeOrder(Fn);
+        changed = true;
+    }
+    return changed;
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "jkc/IR/IR.h"
+#include <memory>
+
+namespace AST {
+
+struct Program;
+struct Function;
+
+}
+
+namespace CodeGen {
+
+struct EmitterState;
+
+}
+
+namespace IR {
+
+// Replaces the calls to the small functions of the module by a copy of
+// their body, the arguments take the place of the parameters and the
+// returns jump to the code after the call
+struct Inliner {
+    // A callee of this size costs less than the call, it's inlined everywhere
+    static constexpr UInt32 AlwaysInlineSize = 8;
+    // Rounds of inlining, the calls of a inlined body are inlined in the next one
+    static constexpr UInt32 MaxDepth = 3;
+    // The caller stops growing at this size
+    static constexpr UInt32 MaxCallerSize = 512;
+
+    struct Callee {
+        AST::Function* Declaration = nullptr;
+        // Addresses of the functions of the module that it calls
+        Vector<UInt32> Calls;
+        // Calls to it in the module
+        UInt32 CallSites = 0;
+        UInt32 Size = 0;
+        bool IsBuilt = false;
+        // The optimized body, nullptr if it can't be inlined
+        std::unique_ptr<Function> Body;
+    };
+
+    explicit Inliner(CodeGen::EmitterState& State) : State(State) {}
+
+    // Finds the functions of the module and counts their call sites
+    void Analyze(AST::Program& Program);
+    // Hash of the bodies that can be inlined in the function, part of its cache key
+    [[nodiscard]] UInt64 HashCallees(UInt32 Address) const;
+    // Inlines the calls of the function, returns true if any was inlined
+    bool Run(Function& Fn, UInt32 Address);
+    // Builds and optimizes the callee the first time, nullptr if it can't be inlined
+    Function* GetBody(UInt32 Address);
+    // Decides by the size of the callee and the profile counts of the call
+    [[nodiscard]] bool ShouldInline(const Instruction* Call, const Callee& Target) const;
+
+    CodeGen::EmitterState& State;
+    // By address of the function
+    Vector<Callee> Callees;
+};
+
+}
@@ -0,0 +1,855 @@
+#include "jkc/IR/Lowering.h"
+#include "jkc/CodeGen/Emitter/EmitterState.h"
+#include "jkc/CodeGen/Emitter/RegisterAllocator.h"
+#include <jkr/Utility.h>
+#include <algorithm>
+#include <bit>
+
+namespace IR {
+
+using CodeGen::Assembler;
+using CodeGen::LiveInterval;
+
+// The values are kept in the registers of the locals,
+// the operands and the result of a instruction that lives in the stack or is a constant in the next ones
+static constexpr Byte ScratchLeft = CodeGen::LastLocalRegister + 1;
+static constexpr Byte ScratchRight = CodeGen::LastLocalRegister + 2;
+static constexpr Byte ScratchResult = CodeGen::LastLocalRegister + 3;
+static constexpr Byte ReturnRegister = 0;
+static constexpr UInt32 MaxStackLocals = 0xFF;
+// Frequency of the blocks that always run
+static constexpr UInt32 MaxFrequency = 256;
+
+using RegisterOp = void (Assembler::*)(CodeGen::Function&, Byte, Byte, Byte);
+using Immediate16Op = void (Assembler::*)(CodeGen::Function&, Byte, Byte, UInt16);
+using UnaryOp = void (Assembler::*)(CodeGen::Function&, Byte);
+
+// Indexed by the opcode from Add to Shr
+static constexpr RegisterOp UIntOps[] = {
+    &Assembler::Add, &Assembler::Sub, &Assembler::Mul, &Assembler::Div,
+    &Assembler::And, &Assembler::Or, &Assembler::XOr, &Assembler::Shl, &Assembler::Shr,
+};
+static constexpr RegisterOp IntOps[] = {
+    &Assembler::IAdd, &Assembler::ISub, &Assembler::IMul, &Assembler::IDiv,
+    &Assembler::And, &Assembler::Or, &Assembler::XOr, &Assembler::Shl, &Assembler::Shr,
+};
+static constexpr RegisterOp FloatOps[] = {
+    &Assembler::FAdd, &Assembler::FSub, &Assembler::FMul, &Assembler::FDiv,
+};
+static constexpr RegisterOp UInt8Ops[] = {
+    &Assembler::Add8, &Assembler::Sub8, &Assembler::Mul8, &Assembler::Div8,
+    &Assembler::And8, &Assembler::Or8, &Assembler::XOr8, &Assembler::Shl8, &Assembler::Shr8,
+};
+static constexpr RegisterOp Int8Ops[] = {
+    &Assembler::IAdd8, &Assembler::ISub8, &Assembler::IMul8, &Assembler::IDiv8,
+    &Assembler::And8, &Assembler::Or8, &Assembler::XOr8, &Assembler::Shl8, &Assembler::Shr8,
+};
+static constexpr Immediate16Op UInt16Ops[] = {
+    &Assembler::Add16, &Assembler::Sub16, &Assembler::Mul16, &Assembler::Div16,
+    &Assembler::And16, &Assembler::Or16, &Assembler::XOr16,
+};
+static constexpr Immediate16Op Int16Ops[] = {
+    &Assembler::IAdd16, &Assembler::ISub16, &Assembler::IMul16, &Assembler::IDiv16,
+    &Assembler::And16, &Assembler::Or16, &Assembler::XOr16,
+};
+
+enum class ImmediateForm {
+    None,
+    // x + 1 and x - 1
+    IncDec,
+    Imm8,
+    Imm16,
+};
+
+static ImmediateForm SelectImmediate(OpCode Op, const AST::TypeDecl& Type, UInt64 Imm) {
+    UInt64 one = Type.IsFloat() ? std::bit_cast<UInt64>(1.0) : 1;
+    if ((Op == OpCode::Add || Op == OpCode::Sub) && Imm == one)
+        return ImmediateForm::IncDec;
+
+    if (Type.IsFloat())
+        return ImmediateForm::None;
+
+    bool isBitwise = Op >= OpCode::And;
+    // The immediates of the signed arithmetic are sign extended
+    UInt64 max8 = Type.IsInt() && !isBitwise ? 0x7F : ByteMax;
+    UInt64 max16 = Type.IsInt() && !isBitwise ? 0x7FFF : Const16Max;
+
+    if (Imm <= max8)
+        return ImmediateForm::Imm8;
+    if (Imm <= max16 && Op != OpCode::Shl && Op != OpCode::Shr)
+        return ImmediateForm::Imm16;
+    return ImmediateForm::None;
+}
+
+static codefile::OpCode ToJump(Predicate P) {
+    switch (P) {
+    case Predicate::Equal: return codefile::OpCode::Je;
+    case Predicate::NotEqual: return codefile::OpCode::Jne;
+    case Predicate::Less: return codefile::OpCode::Jl;
+    case Predicate::LessEqual: return codefile::OpCode::Jle;
+    case Predicate::Greater: return codefile::OpCode::Jg;
+    default: return codefile::OpCode::Jge;
+    }
+}
+
+static Predicate Negate(Predicate P) {
+    switch (P) {
+    case Predicate::Equal: return Predicate::NotEqual;
+    case Predicate::NotEqual: return Predicate::Equal;
+    case Predicate::Less: return Predicate::GreaterEqual;
+    case Predicate::LessEqual: return Predicate::Greater;
+    case Predicate::Greater: return Predicate::LessEqual;
+    default: return Predicate::Less;
+    }
+}
+
+// The predicate with the operands swapped
+static Predicate Mirror(Predicate P) {
+    switch (P) {
+    case Predicate::Less: return Predicate::Greater;
+    case Predicate::LessEqual: return Predicate::GreaterEqual;
+    case Predicate::Greater: return Predicate::Less;
+    case Predicate::GreaterEqual: return Predicate::LessEqual;
+    default: return P;
+    }
+}
+
+static bool HasPhis(const BasicBlock* Block) {
+    return !Block->Instructions.empty() && Block->Instructions[0]->Is(OpCode::Phi);
+}
+
+struct Location {
+    enum class Kind : Byte {
+        Register,
+        Slot,
+        Constant,
+    };
+
+    Kind Ty = Kind::Register;
+    Byte Index = 0;
+    Instruction* Value = nullptr;
+
+    [[nodiscard]] constexpr bool operator==(const Location& RHS) const {
+        return Ty != Kind::Constant && Ty == RHS.Ty && Index == RHS.Index;
+    }
+};
+
+struct Move {
+    Location Dest;
+    Location Src;
+};
+
+struct FunctionLowering {
+    // Planning, nothing is emitted until the plan succeeds
+
+    bool Plan() {
+        SplitCriticalEdges();
+        ComputeLoopDepths();
+        ComputeFrequencies();
+        ComputeLayout();
+        NumberInstructions();
+        ComputeLiveness();
+        BuildIntervals();
+        return AllocateRegisters();
+    }
+
+    // The phi moves are put at the end of the predecessor,
+    // a predecessor with other successors needs its own block for them
+    void SplitCriticalEdges() {
+        Vector<BasicBlock*> blocks = IRFn.Blocks;
+        for (BasicBlock* block : blocks) {
+            if (block->Succs.size() < 2)
+                continue;
+
+            for (auto& succ : block->Succs) {
+                if (!HasPhis(succ))
+                    continue;
+
+                BasicBlock* edge = IRFn.CreateBlock();
+                IRFn.Create(edge, OpCode::Jump, AST::TypeDecl::Void());
+                *std::find(succ->Preds.begin(), succ->Preds.end(), block) = edge;
+                edge->Preds.emplace_back(block);
+                edge->Succs.emplace_back(succ);
+                succ = edge;
+            }
+        }
+
+        ComputeOrder(IRFn);
+    }
+
+    // A edge to a block that isn't after in the reverse post order is a back edge,
+    // the blocks of the natural loop of a header are the ones that reach its latches without it
+    void ComputeLoopDepths() {
+        LoopDepth.assign(IRFn.BlockPool.size(), 0);
+        for (BasicBlock* header : IRFn.Blocks) {
+            Vector<BasicBlock*> worklist = {};
+            for (BasicBlock* pred : header->Preds) {
+                if (pred->Order >= header->Order) {
+                    worklist.emplace_back(pred);
+                }
+            }
+            if (worklist.empty())
+                continue;
+
+            Vector<bool> inLoop(IRFn.BlockPool.size(), false);
+            inLoop[header->Id] = true;
+            for (BasicBlock* latch : worklist) {
+                inLoop[latch->Id] = true;
+            }
+
+            while (!worklist.empty()) {
+                BasicBlock* block = worklist.back();
+                worklist.pop_back();
+                for (BasicBlock* pred : block->Preds) {
+                    if (!inLoop[pred->Id]) {
+                        inLoop[pred->Id] = true;
+                        worklist.emplace_back(pred);
+                    }
+                }
+            }
+
+            for (BasicBlock* block : IRFn.Blocks) {
+                if (inLoop[block->Id]) {
+                    LoopDepth[block->Id]++;
+                }
+            }
+        }
+    }
+
+    // The part of the executions of the function that reach each block, in the order without
+    // the back edges. A branch splits it by the counts of the profile, all the blocks are
+    // reached without them
+    void ComputeFrequencies() {
+        Frequency.assign(IRFn.BlockPool.size(), 0);
+        Frequency[IRFn.Entry->Id] = MaxFrequency;
+        for (BasicBlock* block : IRFn.Blocks) {
+            const Instruction* last = block->Instructions.back();
+            UInt64 total = last->Is(OpCode::Branch) ? last->Counts[0] + last->Counts[1] : 0;
+            for (USize i = 0; i < block->Succs.size(); i++) {
+                BasicBlock* succ = block->Succs[i];
+                if (succ->Order <= block->Order)
+                    continue;
+
+                UInt64 frequency = Frequency[block->Id];
+                if (total) {
+                    frequency = UInt64(Float(frequency) * Float(last->Counts[i]) / Float(total));
+                }
+                Frequency[succ->Id] = UInt32(std::min<UInt64>(Frequency[succ->Id] + frequency, MaxFrequency));
+            }
+        }
+    }
+
+    // The blocks that the profile never reaches go after the others, so the hot path falls
+    // through. The intervals are built on this order, the analyses keep the reverse post order
+    void ComputeLayout() {
+        Layout = IRFn.Blocks;
+        std::stable_partition(Layout.begin(), Layout.end(), [&](BasicBlock* Block) {
+            return Frequency[Block->Id] != 0;
+        });
+    }
+
+    // Each use costs more by each loop around it and by how often its block runs
+    UInt64 UseWeight(const BasicBlock* Block) const {
+        UInt64 weight = Frequency[Block->Id];
+        for (UInt32 depth = std::min(LoopDepth[Block->Id], CodeGen::MaxLoopDepth); depth > 0; depth--) {
+            weight *= CodeGen::LoopUseWeight;
+        }
+        return weight;
+    }
+
+    // The phis are at the start of the block and the terminator at the end,
+    // the other instructions are numbered in steps of 2
+    void NumberInstructions() {
+        Positions.assign(IRFn.InstructionPool.size(), 0);
+        BlockStart.assign(IRFn.BlockPool.size(), 0);
+        BlockEnd.assign(IRFn.BlockPool.size(), 0);
+        ValueIndex.assign(IRFn.InstructionPool.size(), NoValue);
+
+        UInt32 position = 0;
+        for (BasicBlock* block : Layout) {
+            BlockStart[block->Id] = position;
+            for (Instruction* inst : block->Instructions) {
+                if (!inst->Is(OpCode::Phi)) {
+                    position += 2;
+                }
+                Positions[inst->Id] = position;
+
+                if (inst->HasValue()) {
+                    ValueIndex[inst->Id] = UInt32(Intervals.size());
+                    Intervals.emplace_back();
+                    Values.emplace_back(inst);
+                }
+            }
+            BlockEnd[block->Id] = position;
+            position += 2;
+        }
+    }
+
+    bool IsValue(const Instruction* Inst) const {
+        return ValueIndex[Inst->Id] != NoValue;
+    }
+
+    // Values live at the end of each block, the operands of the phis
+    // of a successor are used at the end of the predecessor
+    void ComputeLiveness() {
+        USize count = Intervals.size();
+        Vector<Vector<bool>> liveIn(IRFn.BlockPool.size(), Vector<bool>(count, false));
+        LiveOut.assign(IRFn.BlockPool.size(), Vector<bool>(count, false));
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (USize i = IRFn.Blocks.size(); i > 0; i--) {
+                BasicBlock* block = IRFn.Blocks[i - 1];
+                Vector<bool> live(count, false);
+
+                for (BasicBlock* succ : block->Succs) {
+                    for (USize v = 0; v < count; v++) {
+                        if (liveIn[succ->Id][v]) {
+                            live[v] = true;
+                        }
+                    }
+
+                    USize predIndex = std::find(succ->Preds.begin(), succ->Preds.end(), block) - succ->Preds.begin();
+                    for (Instruction* inst : succ->Instructions) {
+                        if (!inst->Is(OpCode::Phi))
+                            break;
+
+                        Instruction* operand = inst->Operands[predIndex];
+                        if (IsValue(operand)) {
+                            live[ValueIndex[operand->Id]] = true;
+                        }
+                    }
+                }
+                LiveOut[block->Id] = live;
+
+                for (USize j = block->Instructions.size(); j > 0; j--) {
+                    Instruction* inst = block->Instructions[j - 1];
+                    if (IsValue(inst)) {
+                        live[ValueIndex[inst->Id]] = false;
+                    }
+                    if (inst->Is(OpCode::Phi))
+                        continue;
+
+                    for (Instruction* operand : inst->Operands) {
+                        if (IsValue(operand)) {
+                            live[ValueIndex[operand->Id]] = true;
+                        }
+                    }
+                }
+
+                if (live != liveIn[block->Id]) {
+                    liveIn[block->Id] = std::move(live);
+                    changed = true;
+                }
+            }
+        }
+
+        LiveIn = std::move(liveIn);
+    }
+
+    // A interval covers from the definition to the last use,
+    // with the holes between them
+    void BuildIntervals() {
+        for (USize v = 0; v < Intervals.size(); v++) {
+            auto& interval = Intervals[v];
+            Instruction* value = Values[v];
+            interval.Start = interval.End = Positions[value->Id];
+            if (value->Is(OpCode::Param)) {
+                interval.Start = 0;
+                interval.Reg = Byte(value->Imm + 1);
+                interval.IsFixed = true;
+            }
+
+            // A operation reads its operands before it writes the result, it can take the register
+            // of its left operand when it's the last use, as the increment of a induction variable
+            if ((value->IsBinary() || value->Is(OpCode::Neg) || value->Is(OpCode::Not)) && IsValue(value->Operands[0])) {
+                interval.CopyOf = ValueIndex[value->Operands[0]->Id];
+            }
+        }
+
+        for (BasicBlock* block : IRFn.Blocks) {
+            for (Instruction* inst : block->Instructions) {
+                for (Instruction* operand : inst->Operands) {
+                    if (!IsValue(operand))
+                        continue;
+
+                    // The operands of a phi are live until the end of the predecessor
+                    auto& interval = Intervals[ValueIndex[operand->Id]];
+                    if (!inst->Is(OpCode::Phi)) {
+                        interval.End = std::max(interval.End, Positions[inst->Id]);
+                        interval.Uses += UseWeight(block);
+                    }
+                }
+            }
+
+            // The operands of the phis are moved at the end of the predecessors
+            for (BasicBlock* succ : block->Succs) {
+                USize predIndex = std::find(succ->Preds.begin(), succ->Preds.end(), block) - succ->Preds.begin();
+                for (Instruction* inst : succ->Instructions) {
+                    if (!inst->Is(OpCode::Phi))
+                        break;
+
+                    Instruction* operand = inst->Operands[predIndex];
+                    if (IsValue(operand)) {
+                        Intervals[ValueIndex[operand->Id]].Uses += UseWeight(block);
+                    }
+                    Intervals[ValueIndex[inst->Id]].Uses += UseWeight(block);
+                }
+            }
+
+            for (USize v = 0; v < Intervals.size(); v++) {
+                auto& interval = Intervals[v];
+                if (LiveIn[block->Id][v]) {
+                    interval.Start = std::min(interval.Start, BlockStart[block->Id]);
+                }
+                if (LiveOut[block->Id][v]) {
+                    interval.End = std::max(interval.End, BlockEnd[block->Id]);
+                }
+            }
+        }
+    }
+
+    // A spilled value gets a stack slot for all its life
+    bool AllocateRegisters() {
+        CodeGen::LinearScan(Intervals);
+
+        Slots.assign(Intervals.size(), 0);
+        UInt32 slots = 0;
+        for (USize v = 0; v < Intervals.size(); v++) {
+            if (Intervals[v].IsSpilled) {
+                Slots[v] = Byte(Fn.CountOfStackLocals + slots);
+                slots++;
+            }
+        }
+
+        if (Fn.CountOfStackLocals + slots > MaxStackLocals)
+            return false;
+
+        Fn.CountOfStackLocals = Byte(Fn.CountOfStackLocals + slots);
+        return true;
+    }
+
+    // Emission
+
+    void Emit() {
+        BlockLabels.assign(IRFn.BlockPool.size(), 0);
+        for (BasicBlock* block : IRFn.Blocks) {
+            BlockLabels[block->Id] = Asm.CreateLabel(Fn);
+        }
+
+        for (USize i = 0; i < Layout.size(); i++) {
+            BasicBlock* block = Layout[i];
+            Next = i + 1 < Layout.size() ? Layout[i + 1] : nullptr;
+            Asm.BindLabel(Fn, BlockLabels[block->Id]);
+
+            for (Instruction* inst : block->Instructions) {
+                EmitInstruction(inst);
+            }
+        }
+
+        Asm.ResolveLabels(Fn);
+    }
+
+    // A block with only a jump is skipped by the jumps to it
+    BasicBlock* Forward(BasicBlock* Block) const {
+        for (USize i = 0; i < IRFn.Blocks.size(); i++) {
+            if (Block->Instructions.size() != 1 || !Block->Instructions[0]->Is(OpCode::Jump) || HasPhis(Block->Succs[0]))
+                break;
+            Block = Block->Succs[0];
+        }
+        return Block;
+    }
+
+    // Falling through to the next block
+    bool IsNext(BasicBlock* Target) const {
+        return Next && Forward(Target) == Forward(Next);
+    }
+
+    void JumpTo(codefile::OpCode OpCode, BasicBlock* Target) {
+        Asm.Jump(Fn, OpCode, BlockLabels[Forward(Target)->Id]);
+    }
+
+    Location GetLocation(Instruction* Value) const {
+        if (Value->IsConstant())
+            return Location{ .Ty = Location::Kind::Constant, .Value = Value };
+
+        UInt32 index = ValueIndex[Value->Id];
+        auto& interval = Intervals[index];
+        if (interval.IsSpilled)
+            return Location{ .Ty = Location::Kind::Slot, .Index = Slots[index] };
+        return Location{ .Ty = Location::Kind::Register, .Index = interval.Reg };
+    }
+
+    void Materialize(Instruction* Constant, Byte Reg) {
+        if (Constant->Is(OpCode::ConstString)) {
+            UInt32 index = State.AddLiteral(Constant->String, Constant->Location);
+            Asm.Ldsr(Fn, Reg, index);
+            Fn.StringRefs.emplace_back(CodeGen::StringReference{
+                .IP = UInt32(Fn.Code.Buff.size() - sizeof(UInt32)),
+                .Index = index,
+            });
+        }
+        else {
+            State.MoveConst(Fn, Reg, Constant->Imm);
+        }
+    }
+
+    // The register with the value, a constant or a value in the stack is loaded in Scratch
+    Byte Load(Instruction* Value, Byte Scratch) {
+        Location location = GetLocation(Value);
+        if (location.Ty == Location::Kind::Register)
+            return location.Index;
+
+        EmitMove(Location{ .Index = Scratch }, location);
+        return Scratch;
+    }
+
+    // The register where the instruction puts its result
+    Byte ResultRegister(Instruction* Inst) const {
+        Location location = GetLocation(Inst);
+        return location.Ty == Location::Kind::Register ? location.Index : ScratchResult;
+    }
+
+    // Saves the result of a instruction that lives in the stack
+    void StoreResult(Instruction* Inst, Byte Reg) {
+        Location location = GetLocation(Inst);
+        if (location.Ty == Location::Kind::Slot) {
+            Asm.LocalSet(Fn, Reg, location.Index);
+        }
+    }
+
+    void EmitMove(const Location& Dest, const Location& Src) {
+        if (Dest == Src)
+            return;
+
+        if (Dest.Ty == Location::Kind::Register) {
+            if (Src.Ty == Location::Kind::Register) {
+                Asm.Mov(Fn, Dest.Index, Src.Index);
+            }
+            else if (Src.Ty == Location::Kind::Slot) {
+                Asm.LocalGet(Fn, Dest.Index, Src.Index);
+            }
+            else {
+                Materialize(Src.Value, Dest.Index);
+            }
+        }
+        else if (Src.Ty == Location::Kind::Register) {
+            Asm.LocalSet(Fn, Src.Index, Dest.Index);
+        }
+        else {
+            EmitMove(Location{ .Index = ScratchRight }, Src);
+            Asm.LocalSet(Fn, ScratchRight, Dest.Index);
+        }
+    }
+
+    // The moves happen at the same time, a cycle is broken with ScratchResult
+    void EmitParallelMove(Vector<Move>& Moves) {
+        std::erase_if(Moves, [](const Move& M) { return M.Dest == M.Src; });
+
+        while (!Moves.empty()) {
+            bool emitted = false;
+            for (USize i = 0; i < Moves.size(); i++) {
+                bool isRead = std::any_of(Moves.begin(), Moves.end(), [&](const Move& M) {
+                    return M.Src == Moves[i].Dest;
+                });
+                if (isRead)
+                    continue;
+
+                EmitMove(Moves[i].Dest, Moves[i].Src);
+                Moves.erase(Moves.begin() + i);
+                emitted = true;
+                break;
+            }
+
+            if (!emitted) {
+                Location saved = Moves[0].Dest;
+                Location scratch = Location{ .Index = ScratchResult };
+                EmitMove(scratch, saved);
+                for (auto& move : Moves) {
+                    if (move.Src == saved) {
+                        move.Src = scratch;
+                    }
+                }
+            }
+        }
+    }
+
+    void EmitPhiMoves(BasicBlock* Block, BasicBlock* Succ) {
+        USize predIndex = std::find(Succ->Preds.begin(), Succ->Preds.end(), Block) - Succ->Preds.begin();
+
+        Vector<Move> moves = {};
+        for (Instruction* inst : Succ->Instructions) {
+            if (!inst->Is(OpCode::Phi))
+                break;
+            moves.emplace_back(Move{ GetLocation(inst), GetLocation(inst->Operands[predIndex]) });
+        }
+        EmitParallelMove(moves);
+    }
+
+    void EmitInstruction(Instruction* Inst) {
+        switch (Inst->Op) {
+        // The constants are put in the instructions that use them
+        case OpCode::Const:
+        case OpCode::ConstString:
+        case OpCode::Param:
+        case OpCode::Phi:
+            break;
+        case OpCode::Add:
+        case OpCode::Sub:
+        case OpCode::Mul:
+        case OpCode::Div:
+        case OpCode::And:
+        case OpCode::Or:
+        case OpCode::XOr:
+        case OpCode::Shl:
+        case OpCode::Shr:
+            EmitBinary(Inst);
+            break;
+        case OpCode::Neg:
+        case OpCode::Not: {
+            Byte src = Load(Inst->Operands[0], ScratchLeft);
+            Byte dest = ResultRegister(Inst);
+            if (dest != src) {
+                Asm.Mov(Fn, dest, src);
+            }
+            if (Inst->Is(OpCode::Neg)) {
+                Asm.Neg(Fn, dest);
+            }
+            else {
+                Asm.Not(Fn, dest);
+            }
+            StoreResult(Inst, dest);
+            break;
+        }
+        case OpCode::GlobalGet: {
+            Byte dest = ResultRegister(Inst);
+            Asm.GlobalGet(Fn, dest, UInt16(Inst->Imm));
+            StoreResult(Inst, dest);
+            break;
+        }
+        case OpCode::GlobalSet:
+            Asm.GlobalSet(Fn, Load(Inst->Operands[0], ScratchLeft), UInt16(Inst->Imm));
+            break;
+        case OpCode::LoadField: {
+            Byte object = Load(Inst->Operands[0], ScratchLeft);
+            Byte dest = ResultRegister(Inst);
+            Asm.LoadField(Fn, dest, object, codefile::ArrayElement(Inst->Aux), UInt16(Inst->Imm));
+            StoreResult(Inst, dest);
+            break;
+        }
+        case OpCode::StoreField: {
+            Byte src = Load(Inst->Operands[0], ScratchLeft);
+            Byte object = Load(Inst->Operands[1], ScratchRight);
+            Asm.StoreField(Fn, src, object, codefile::ArrayElement(Inst->Aux), UInt16(Inst->Imm));
+            break;
+        }
+        case OpCode::ArrayLoad: {
+            Byte array = Load(Inst->Operands[0], ScratchLeft);
+            Byte index = Load(Inst->Operands[1], ScratchRight);
+            Byte dest = ResultRegister(Inst);
+            Asm.ArrayLoad(Fn, array, index, dest);
+            StoreResult(Inst, dest);
+            break;
+        }
+        case OpCode::Call:
+            EmitCall(Inst);
+            break;
+        case OpCode::Jump:
+            if (HasPhis(Inst->Parent->Succs[0])) {
+                EmitPhiMoves(Inst->Parent, Inst->Parent->Succs[0]);
+            }
+            if (!IsNext(Inst->Parent->Succs[0])) {
+                JumpTo(codefile::OpCode::Jmp, Inst->Parent->Succs[0]);
+            }
+            break;
+        case OpCode::Branch:
+            EmitBranch(Inst);
+            break;
+        case OpCode::Return:
+            if (!Inst->Operands.empty()) {
+                EmitMove(Location{ .Index = ReturnRegister }, GetLocation(Inst->Operands[0]));
+            }
+            Asm.Ret(Fn);
+            break;
+        }
+    }
+
+    void EmitBinary(Instruction* Inst) {
+        Instruction* left = Inst->Operands[0];
+        Instruction* right = Inst->Operands[1];
+        const AST::TypeDecl& type = Inst->Type;
+        USize op = USize(Inst->Op) - USize(OpCode::Add);
+
+        ImmediateForm form = ImmediateForm::None;
+        if (right->Is(OpCode::Const)) {
+            form = SelectImmediate(Inst->Op, type, right->Imm);
+        }
+
+        Byte src = Load(left, ScratchLeft);
+        Byte dest = ResultRegister(Inst);
+
+        if (form == ImmediateForm::IncDec) {
+            if (dest != src) {
+                Asm.Mov(Fn, dest, src);
+            }
+
+            UnaryOp incDec = nullptr;
+            if (Inst->Is(OpCode::Add)) {
+                incDec = type.IsInt() ? &Assembler::IInc : type.IsFloat() ? &Assembler::FInc : &Assembler::Inc;
+            }
+            else {
+                incDec = type.IsInt() ? &Assembler::IDec : type.IsFloat() ? &Assembler::FDec : &Assembler::Dec;
+            }
+            (Asm.*incDec)(Fn, dest);
+        }
+        else if (form == ImmediateForm::Imm8) {
+            RegisterOp imm8 = type.IsInt() ? Int8Ops[op] : UInt8Ops[op];
+            (Asm.*imm8)(Fn, dest, src, Byte(right->Imm));
+        }
+        else if (form == ImmediateForm::Imm16) {
+            Immediate16Op imm16 = type.IsInt() ? Int16Ops[op] : UInt16Ops[op];
+            (Asm.*imm16)(Fn, dest, src, UInt16(right->Imm));
+        }
+        else {
+            RegisterOp registerOp = type.IsFloat() ? FloatOps[op] : type.IsInt() ? IntOps[op] : UIntOps[op];
+            (Asm.*registerOp)(Fn, dest, src, Load(right, ScratchRight));
+        }
+
+        StoreResult(Inst, dest);
+    }
+
+    void EmitBranch(Instruction* Inst) {
+        Instruction* left = Inst->Operands[0];
+        Instruction* right = Inst->Operands[1];
+        Predicate predicate = Predicate(Inst->Aux);
+
+        bool isZeroTest = (predicate == Predicate::Equal || predicate == Predicate::NotEqual) &&
+            !left->Type.IsFloat() && right->Is(OpCode::Const) && right->Imm == 0;
+
+        if (isZeroTest) {
+            Asm.TestZ(Fn, Load(left, ScratchLeft));
+        }
+        else {
+            if (left->IsConstant() && !right->IsConstant()) {
+                std::swap(left, right);
+                predicate = Mirror(predicate);
+            }
+
+            Byte a = Load(left, ScratchLeft);
+            Byte b = Load(right, ScratchRight);
+            if (left->Type.IsFloat()) {
+                Asm.FCmp(Fn, a, b);
+            }
+            else {
+                Asm.Cmp(Fn, a, b);
+            }
+        }
+
+        BasicBlock* then = Inst->Parent->Succs[0];
+        BasicBlock* otherwise = Inst->Parent->Succs[1];
+        if (IsNext(otherwise)) {
+            MarkSite(Inst, false);
+            JumpTo(ToJump(predicate), then);
+        }
+        else if (IsNext(then)) {
+            MarkSite(Inst, true);
+            JumpTo(ToJump(Negate(predicate)), otherwise);
+        }
+        else {
+            MarkSite(Inst, false);
+            JumpTo(ToJump(predicate), then);
+            JumpTo(codefile::OpCode::Jmp, otherwise);
+        }
+    }
+
+    // The profile counts the next jump or call for the site of the instruction
+    void MarkSite(const Instruction* Inst, bool IsNegated) {
+        if (Inst->Site) {
+            Fn.ProfileSites.emplace_back(CodeGen::ProfileSite{
+                .IP = UInt32(Fn.Code.Buff.size()),
+                .Site = Inst->Site,
+                .Function = Inst->SiteFunction,
+                .IsCall = Inst->Is(OpCode::Call),
+                .IsNegated = IsNegated,
+            });
+        }
+    }
+
+    // The registers are shared with the callee, the values that are live
+    // after the call are saved in the stack
+    void EmitCall(Instruction* Inst) {
+        UInt32 position = Positions[Inst->Id];
+
+        Vector<Byte> saved = {};
+        for (auto& interval : Intervals) {
+            if (!interval.IsSpilled && interval.Start < position && interval.End > position) {
+                saved.emplace_back(interval.Reg);
+            }
+        }
+        std::sort(saved.begin(), saved.end());
+
+        for (Byte reg : saved) {
+            Asm.Push(Fn, reg);
+        }
+
+        Vector<Move> arguments = {};
+        for (USize i = 0; i < Inst->Operands.size(); i++) {
+            arguments.emplace_back(Move{
+                Location{ .Index = Byte(i + 1) },
+                GetLocation(Inst->Operands[i]),
+            });
+        }
+        EmitParallelMove(arguments);
+
+        MarkSite(Inst, false);
+        Asm.Call(Fn, UInt32(Inst->Imm));
+
+        for (USize i = saved.size(); i > 0; i--) {
+            Asm.Pop(Fn, saved[i - 1]);
+        }
+
+        if (Inst->HasValue()) {
+            EmitMove(GetLocation(Inst), Location{ .Index = ReturnRegister });
+        }
+    }
+
+    static constexpr UInt32 NoValue = UInt32(-1);
+
+    CodeGen::EmitterState& State;
+    Function& IRFn;
+    CodeGen::Function& Fn;
+    Assembler& Asm;
+
+    Vector<UInt32> Positions = {};
+    Vector<UInt32> BlockStart = {};
+    Vector<UInt32> BlockEnd = {};
+    // Index of the interval of each instruction, NoValue if it doesn't need one
+    Vector<UInt32> ValueIndex = {};
+    Vector<LiveInterval> Intervals = {};
+    // The instruction and the stack slot of each interval
+    Vector<Instruction*> Values = {};
+    Vector<Byte> Slots = {};
+    // Number of loops around each block
+    Vector<UInt32> LoopDepth = {};
+    // Up to MaxFrequency by block
+    Vector<UInt32> Frequency = {};
+    // Order of emission of the blocks
+    Vector<BasicBlock*> Layout = {};
+    Vector<Vector<bool>> LiveIn = {};
+    Vector<Vector<bool>> LiveOut = {};
+
+    Vector<CodeGen::Label> BlockLabels = {};
+    BasicBlock* Next = nullptr;
+};
+
+bool LowerFunction(CodeGen::EmitterState& State, Function& IRFn, CodeGen::Function& Fn) {
+    FunctionLowering lowering{ .State = State, .IRFn = IRFn, .Fn = Fn, .Asm = State.CodeAssembler };
+    if (!lowering.Plan())
+        return false;
+
+    lowering.Emit();
+    return true;
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "jkc/IR/IR.h"
+
+namespace CodeGen {
+
+struct EmitterState;
+struct Function;
+
+}
+
+namespace IR {
+
+// Emits the bytecode of the function, the values are put in registers
+// with a linear scan over their live intervals. Returns false before
+// emitting anything if the function can't be lowered, then it's emitted from the AST
+bool LowerFunction(CodeGen::EmitterState& State, Function& IRFn, CodeGen::Function& Fn);
+
+}
@@ -0,0 +1,31 @@
+#include "jkc/IR/PassManager.h"
+#include "jkc/IR/Passes.h"
+
+namespace IR {
+
+PassManager::PassManager(CodeGen::Optimization Level) {
+    if (Level == CodeGen::OPTIMIZATION_RELEASE_FAST) {
+        Passes = {
+            FoldConstants,
+            NumberValues,
+            HoistLoopInvariants,
+            ReduceInductionVariables,
+            ReduceStrength,
+            EliminateDeadCode,
+        };
+    }
+}
+
+void PassManager::Run(Function& Fn) {
+    for (UInt32 round = 0; round < MaxRounds; round++) {
+        bool changed = false;
+        for (Pass pass : Passes) {
+            changed |= pass(Fn);
+        }
+
+        if (!changed)
+            break;
+    }
+}
+
+}
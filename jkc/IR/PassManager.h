@@ -0,0 +1,21 @@
+#pragma once
+#include "jkc/IR/IR.h"
+#include "jkc/CodeGen/Emitter/EmitterState.h"
+
+namespace IR {
+
+using Pass = bool(*)(Function& Fn);
+
+// The pipeline of passes of a optimization level
+struct PassManager {
+    // Rounds of the pipeline, a round stops early if no pass changed the function
+    static constexpr UInt32 MaxRounds = 4;
+
+    explicit PassManager(CodeGen::Optimization Level);
+
+    void Run(Function& Fn);
+
+    Vector<Pass> Passes;
+};
+
+}
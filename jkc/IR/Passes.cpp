@@ -0,0 +1,677 @@
+#include "jkc/IR/Passes.h"
+#include "jkc/CodeGen/Emitter/ConstFold.h"
+#include "jkc/Hash.h"
+#include <unordered_map>
+#include <algorithm>
+#include <bit>
+
+namespace IR {
+
+// Constant folding
+
+// The binary opcodes are in the same order than the operations of the AST
+static bool EvaluateBinary(OpCode Op, const AST::TypeDecl& Type, UInt64 A, UInt64 B, UInt64& Result) {
+    auto op = AST::BinaryOperation(UInt32(Op) - UInt32(OpCode::Add) + UInt32(AST::BinaryOperation::Add));
+    return CodeGen::FoldBinary(op, Type, A, B, Result);
+}
+
+template<typename T>
+static bool Compare(Predicate P, T A, T B) {
+    switch (P) {
+    case Predicate::Equal: return A == B;
+    case Predicate::NotEqual: return A != B;
+    case Predicate::Less: return A < B;
+    case Predicate::LessEqual: return A <= B;
+    case Predicate::Greater: return A > B;
+    default: return A >= B;
+    }
+}
+
+// The Cmp of the virtual machine compares the integers as signed, UInt too
+static bool EvaluatePredicate(Predicate P, const AST::TypeDecl& Type, UInt64 A, UInt64 B) {
+    if (Type.IsFloat())
+        return Compare(P, std::bit_cast<Float64>(A), std::bit_cast<Float64>(B));
+    return Compare(P, Int64(A), Int64(B));
+}
+
+static void MakeConstant(Instruction* Inst, UInt64 Value) {
+    DropOperands(Inst);
+    Inst->Op = OpCode::Const;
+    Inst->Imm = Value;
+}
+
+static void Replace(Instruction* Inst, Instruction* Value) {
+    ReplaceAllUses(Inst, Value);
+    RemoveInstruction(Inst);
+}
+
+static bool IsConstant(const Instruction* Inst, UInt64 Value) {
+    return Inst->Is(OpCode::Const) && Inst->Imm == Value;
+}
+
+// x + 0, x * 1, x & 0... only for the integers, the floats have signed zeros
+static bool SimplifyIdentity(Instruction* Inst) {
+    Instruction* left = Inst->Operands[0];
+    Instruction* right = Inst->Operands[1];
+    if (Inst->Type.IsFloat() || !right->Is(OpCode::Const))
+        return false;
+
+    switch (Inst->Op) {
+    case OpCode::Add:
+    case OpCode::Sub:
+    case OpCode::Or:
+    case OpCode::XOr:
+    case OpCode::Shl:
+    case OpCode::Shr:
+        if (IsConstant(right, 0)) {
+            Replace(Inst, left);
+            return true;
+        }
+        break;
+    case OpCode::Mul:
+        if (IsConstant(right, 0)) {
+            MakeConstant(Inst, 0);
+            return true;
+        }
+        [[fallthrough]];
+    case OpCode::Div:
+        if (IsConstant(right, 1)) {
+            Replace(Inst, left);
+            return true;
+        }
+        break;
+    case OpCode::And:
+        if (IsConstant(right, 0)) {
+            MakeConstant(Inst, 0);
+            return true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+// Returns true if the branch was replaced by a jump
+static bool FoldBranch(Instruction* Branch) {
+    Instruction* left = Branch->Operands[0];
+    Instruction* right = Branch->Operands[1];
+    Predicate predicate = Predicate(Branch->Aux);
+
+    bool taken = false;
+    if (left->Is(OpCode::Const) && right->Is(OpCode::Const)) {
+        taken = EvaluatePredicate(predicate, left->Type, left->Imm, right->Imm);
+    }
+    else if (left == right && !left->Type.IsFloat()) {
+        taken = predicate == Predicate::Equal || predicate == Predicate::LessEqual || predicate == Predicate::GreaterEqual;
+    }
+    else {
+        return false;
+    }
+
+    BasicBlock* block = Branch->Parent;
+    RemoveEdge(block, block->Succs[taken ? 1 : 0]);
+    DropOperands(Branch);
+    Branch->Op = OpCode::Jump;
+    Branch->Aux = 0;
+    return true;
+}
+
+// Returns true if the instruction changed
+static bool FoldInstruction(Instruction* Inst, bool& RemovedEdges) {
+    if (Inst->IsBinary()) {
+        // The constant is the right operand, as the immediate of the bytecode
+        if (Inst->IsCommutative() && Inst->Operands[0]->Is(OpCode::Const) && !Inst->Operands[1]->Is(OpCode::Const)) {
+            std::swap(Inst->Operands[0], Inst->Operands[1]);
+        }
+
+        Instruction* left = Inst->Operands[0];
+        Instruction* right = Inst->Operands[1];
+        UInt64 value = 0;
+        if (left->Is(OpCode::Const) && right->Is(OpCode::Const) &&
+            EvaluateBinary(Inst->Op, Inst->Type, left->Imm, right->Imm, value)) {
+            MakeConstant(Inst, value);
+            return true;
+        }
+
+        return SimplifyIdentity(Inst);
+    }
+
+    switch (Inst->Op) {
+    case OpCode::Neg:
+        if (Inst->Operands[0]->Is(OpCode::Const)) {
+            MakeConstant(Inst, 0 - Inst->Operands[0]->Imm);
+            return true;
+        }
+        break;
+    case OpCode::Not:
+        if (Inst->Operands[0]->Is(OpCode::Const)) {
+            MakeConstant(Inst, ~Inst->Operands[0]->Imm);
+            return true;
+        }
+        break;
+    case OpCode::Phi: {
+        Instruction* same = nullptr;
+        for (Instruction* operand : Inst->Operands) {
+            if (operand == same || operand == Inst)
+                continue;
+            if (same != nullptr)
+                return false;
+            same = operand;
+        }
+
+        if (same != nullptr) {
+            Replace(Inst, same);
+            return true;
+        }
+        break;
+    }
+    case OpCode::Branch:
+        if (FoldBranch(Inst)) {
+            RemovedEdges = true;
+            return true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+bool FoldConstants(Function& Fn) {
+    bool changed = false;
+    bool folded = true;
+
+    while (folded) {
+        folded = false;
+        bool removedEdges = false;
+
+        for (BasicBlock* block : Fn.Blocks) {
+            // The folded instructions can be removed from the block
+            Vector<Instruction*> instructions = block->Instructions;
+            for (Instruction* inst : instructions) {
+                if (!inst->IsDead && FoldInstruction(inst, removedEdges)) {
+                    folded = true;
+                }
+            }
+        }
+
+        if (removedEdges) {
+            ComputeOrder(Fn);
+        }
+        changed |= folded;
+    }
+
+    return changed;
+}
+
+// Dead code elimination
+
+static bool HasSideEffects(const Instruction* Inst) {
+    switch (Inst->Op) {
+    case OpCode::Call:
+    case OpCode::GlobalSet:
+    case OpCode::StoreField:
+    // The loads trap with a invalid object or index
+    case OpCode::LoadField:
+    case OpCode::ArrayLoad:
+        return true;
+    default:
+        return Inst->IsTerminator();
+    }
+}
+
+bool EliminateDeadCode(Function& Fn) {
+    Vector<bool> isLive(Fn.InstructionPool.size(), false);
+    Vector<Instruction*> worklist = {};
+
+    for (BasicBlock* block : Fn.Blocks) {
+        for (Instruction* inst : block->Instructions) {
+            if (HasSideEffects(inst)) {
+                isLive[inst->Id] = true;
+                worklist.emplace_back(inst);
+            }
+        }
+    }
+
+    while (!worklist.empty()) {
+        Instruction* inst = worklist.back();
+        worklist.pop_back();
+
+        for (Instruction* operand : inst->Operands) {
+            if (!isLive[operand->Id]) {
+                isLive[operand->Id] = true;
+                worklist.emplace_back(operand);
+            }
+        }
+    }
+
+    Vector<Instruction*> dead = {};
+    for (BasicBlock* block : Fn.Blocks) {
+        for (Instruction* inst : block->Instructions) {
+            if (!isLive[inst->Id]) {
+                dead.emplace_back(inst);
+            }
+        }
+    }
+
+    // The users of a dead instruction are dead
+    for (Instruction* inst : dead) {
+        DropOperands(inst);
+    }
+    for (Instruction* inst : dead) {
+        RemoveInstruction(inst);
+    }
+
+    return !dead.empty();
+}
+
+// Value numbering
+
+struct ValueKey {
+    OpCode Op;
+    AST::TypeDecl::Type Primitive;
+    UInt8 Flags;
+    UInt64 Imm;
+    // Id + 1 of the operands, 0 if there isn't
+    UInt32 Left;
+    UInt32 Right;
+    StringView String;
+
+    bool operator==(const ValueKey&) const = default;
+};
+
+struct ValueKeyHash {
+    USize operator()(const ValueKey& Key) const {
+        UInt64 hash = HashValue(HashSeed, Key.Op);
+        hash = HashValue(hash, Key.Primitive);
+        hash = HashValue(hash, Key.Flags);
+        hash = HashValue(hash, Key.Imm);
+        hash = HashValue(hash, Key.Left);
+        hash = HashValue(hash, Key.Right);
+        return USize(HashBytes(hash, Key.String.data(), Key.String.size()));
+    }
+};
+
+static ValueKey GetKey(const Instruction* Inst) {
+    ValueKey key{
+        .Op = Inst->Op,
+        .Primitive = Inst->Type.Primitive,
+        .Flags = Inst->Type.Flags,
+        .Imm = Inst->Imm,
+        .Left = Inst->Operands.size() > 0 ? Inst->Operands[0]->Id + 1 : 0,
+        .Right = Inst->Operands.size() > 1 ? Inst->Operands[1]->Id + 1 : 0,
+        .String = Inst->String,
+    };
+
+    if (Inst->IsCommutative() && key.Left > key.Right) {
+        std::swap(key.Left, key.Right);
+    }
+    return key;
+}
+
+struct ValueNumbering {
+    void Visit(BasicBlock* Block) {
+        Vector<ValueKey> scope = {};
+
+        Vector<Instruction*> instructions = Block->Instructions;
+        for (Instruction* inst : instructions) {
+            if (!inst->IsPure())
+                continue;
+
+            ValueKey key = GetKey(inst);
+            auto it = Values.find(key);
+            if (it != Values.end()) {
+                Replace(inst, it->second);
+                Changed = true;
+            }
+            else {
+                Values.emplace(key, inst);
+                scope.emplace_back(key);
+            }
+        }
+
+        for (BasicBlock* child : Children[Block->Order]) {
+            Visit(child);
+        }
+
+        // The values of the block only dominate its subtree
+        for (auto& key : scope) {
+            Values.erase(key);
+        }
+    }
+
+    Vector<Vector<BasicBlock*>> Children;
+    std::unordered_map<ValueKey, Instruction*, ValueKeyHash> Values;
+    bool Changed = false;
+};
+
+bool NumberValues(Function& Fn) {
+    ComputeDominators(Fn);
+
+    ValueNumbering numbering{};
+    numbering.Children.resize(Fn.Blocks.size());
+    for (BasicBlock* block : Fn.Blocks) {
+        if (block != Fn.Entry) {
+            numbering.Children[block->IDom->Order].emplace_back(block);
+        }
+    }
+
+    numbering.Visit(Fn.Entry);
+    return numbering.Changed;
+}
+
+// Loop invariant code motion
+
+bool HoistLoopInvariants(Function& Fn) {
+    ComputeDominators(Fn);
+    bool changed = false;
+
+    // A inner loop has its header after the header of the outer loop,
+    // so the instructions hoisted from it can be hoisted again from the outer loop
+    for (USize i = Fn.Blocks.size(); i > 0; i--) {
+        BasicBlock* header = Fn.Blocks[i - 1];
+
+        // The back edges comes from the blocks dominated by the header
+        Vector<BasicBlock*> worklist = {};
+        for (BasicBlock* pred : header->Preds) {
+            if (Dominates(header, pred)) {
+                worklist.emplace_back(pred);
+            }
+        }
+        if (worklist.empty())
+            continue;
+
+        Vector<bool> inLoop(Fn.BlockPool.size(), false);
+        inLoop[header->Id] = true;
+        for (BasicBlock* latch : worklist) {
+            inLoop[latch->Id] = true;
+        }
+
+        while (!worklist.empty()) {
+            BasicBlock* block = worklist.back();
+            worklist.pop_back();
+
+            for (BasicBlock* pred : block->Preds) {
+                if (!inLoop[pred->Id]) {
+                    inLoop[pred->Id] = true;
+                    worklist.emplace_back(pred);
+                }
+            }
+        }
+
+        // The only entry of the loop, without other successors
+        BasicBlock* preheader = nullptr;
+        USize entries = 0;
+        for (BasicBlock* pred : header->Preds) {
+            if (!inLoop[pred->Id]) {
+                preheader = pred;
+                entries++;
+            }
+        }
+        if (entries != 1 || preheader->Succs.size() != 1)
+            continue;
+
+        for (BasicBlock* block : Fn.Blocks) {
+            if (!inLoop[block->Id])
+                continue;
+
+            Vector<Instruction*> instructions = block->Instructions;
+            for (Instruction* inst : instructions) {
+                // A division can trap in a iteration that never happens
+                if (!inst->IsPure() || inst->Is(OpCode::Div))
+                    continue;
+
+                bool isInvariant = std::none_of(inst->Operands.begin(), inst->Operands.end(), [&](Instruction* Operand) {
+                    return inLoop[Operand->Parent->Id];
+                });
+
+                if (isInvariant) {
+                    MoveBeforeTerminator(inst, preheader);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+// Strength reduction
+
+// Creates the instruction before Position, in its block
+static Instruction* CreateBefore(Function& Fn, Instruction* Position, OpCode Op, const AST::TypeDecl& Type) {
+    auto& instructions = Position->Parent->Instructions;
+    Instruction* inst = Fn.Create(Position->Parent, Op, Type);
+    instructions.pop_back();
+    instructions.insert(std::find(instructions.begin(), instructions.end(), Position), inst);
+    return inst;
+}
+
+static Instruction* CreateConstBefore(Function& Fn, Instruction* Position, const AST::TypeDecl& Type, UInt64 Value) {
+    Instruction* inst = CreateBefore(Fn, Position, OpCode::Const, Type);
+    inst->Imm = Value;
+    return inst;
+}
+
+static bool IsPowerOfTwo(const Instruction* Inst) {
+    return Inst->Is(OpCode::Const) && Inst->Imm > 1 && std::has_single_bit(Inst->Imm);
+}
+
+// The bits of the value that can be set, a value narrower than its type
+// comes from a mask, a shift or a load of a Byte, that is zero extended
+static UInt32 KnownWidth(const Instruction* Inst) {
+    switch (Inst->Op) {
+    case OpCode::Const:
+        return UInt32(std::bit_width(Inst->Imm));
+    case OpCode::And:
+        return std::min(KnownWidth(Inst->Operands[0]), KnownWidth(Inst->Operands[1]));
+    case OpCode::Shr: {
+        UInt32 width = KnownWidth(Inst->Operands[0]);
+        const Instruction* amount = Inst->Operands[1];
+        if (!amount->Is(OpCode::Const) || amount->Imm >= 64)
+            return width;
+        return amount->Imm >= width ? 0 : width - UInt32(amount->Imm);
+    }
+    default:
+        return std::min(Inst->Type.SizeInBits, 64U);
+    }
+}
+
+// Changes the operation to Op with a constant as right operand
+static void Rewrite(Function& Fn, Instruction* Inst, OpCode Op, UInt64 Value) {
+    Inst->Op = Op;
+    SetOperand(Inst, 1, CreateConstBefore(Fn, Inst, Inst->Type, Value));
+}
+
+// Returns true if the instruction changed
+static bool ReduceInstruction(Function& Fn, Instruction* Inst) {
+    if (!Inst->IsBinary() || !(Inst->Type.IsInt() || Inst->Type.IsUInt()))
+        return false;
+
+    Instruction* left = Inst->Operands[0];
+    Instruction* right = Inst->Operands[1];
+    switch (Inst->Op) {
+    case OpCode::Mul:
+        // The product is the same for the signed and the unsigned values
+        if (IsPowerOfTwo(right)) {
+            Rewrite(Fn, Inst, OpCode::Shl, std::countr_zero(right->Imm));
+            return true;
+        }
+        if (Inst->Type.IsInt() && IsConstant(right, UInt64(-1))) {
+            DropOperands(Inst);
+            Inst->Op = OpCode::Neg;
+            AddOperand(Inst, left);
+            return true;
+        }
+        break;
+    case OpCode::Div:
+        // The signed division rounds to zero, the shift only agrees with it for the positive values
+        if (IsPowerOfTwo(right) && (Inst->Type.IsUInt() || KnownWidth(left) < 64)) {
+            Rewrite(Fn, Inst, OpCode::Shr, std::countr_zero(right->Imm));
+            return true;
+        }
+        break;
+    case OpCode::Sub: {
+        // x - x / 2^k * 2^k, the remainder of a division that was reduced to shifts
+        if (!right->Is(OpCode::Shl) || !right->Operands[1]->Is(OpCode::Const))
+            break;
+
+        Instruction* shift = right->Operands[0];
+        UInt64 amount = right->Operands[1]->Imm;
+        if (shift->Is(OpCode::Shr) && shift->Operands[0] == left && IsConstant(shift->Operands[1], amount) && amount < 64) {
+            Rewrite(Fn, Inst, OpCode::And, (UInt64(1) << amount) - 1);
+            return true;
+        }
+        break;
+    }
+    case OpCode::And: {
+        // A mask that keeps every bit that the value can have
+        UInt32 width = KnownWidth(left);
+        if (right->Is(OpCode::Const) && width < 64 && (right->Imm | ((UInt64(1) << width) - 1)) == right->Imm) {
+            Replace(Inst, left);
+            return true;
+        }
+        break;
+    }
+    case OpCode::Shr:
+        if (right->Is(OpCode::Const) && right->Imm < 64 && KnownWidth(left) <= right->Imm) {
+            MakeConstant(Inst, 0);
+            return true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+bool ReduceStrength(Function& Fn) {
+    bool changed = false;
+    for (BasicBlock* block : Fn.Blocks) {
+        Vector<Instruction*> instructions = block->Instructions;
+        for (Instruction* inst : instructions) {
+            if (!inst->IsDead && ReduceInstruction(Fn, inst)) {
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// Induction variables
+
+// The value of a phi of the header that is increased by a constant in each iteration
+static bool GetStep(Instruction* Phi, USize Latch, UInt64& Step) {
+    Instruction* next = Phi->Operands[Latch];
+    if (!(next->Is(OpCode::Add) || next->Is(OpCode::Sub)) || next->Operands[0] != Phi || !next->Operands[1]->Is(OpCode::Const))
+        return false;
+
+    Step = next->Is(OpCode::Add) ? next->Operands[1]->Imm : 0 - next->Operands[1]->Imm;
+    return true;
+}
+
+// The factor of a product of the phi by a constant, 0 if it isn't one
+static UInt64 GetFactor(const Instruction* Inst, const Instruction* Phi) {
+    if (Inst->Operands.size() != 2 || Inst->Operands[0] != Phi || !Inst->Operands[1]->Is(OpCode::Const))
+        return 0;
+
+    UInt64 imm = Inst->Operands[1]->Imm;
+    if (Inst->Is(OpCode::Mul))
+        return imm;
+    if (Inst->Is(OpCode::Shl) && imm < 64)
+        return UInt64(1) << imm;
+    return 0;
+}
+
+// i * k is replaced by a new variable j that starts at init * k and is increased by step * k
+// where i is increased, the multiplication of each iteration becomes a addition
+static void ReduceProduct(Function& Fn, Instruction* Phi, USize Latch, UInt64 Step, UInt64 Factor, const Vector<Instruction*>& Products) {
+    BasicBlock* header = Phi->Parent;
+    BasicBlock* preheader = header->Preds[1 - Latch];
+    Instruction* next = Phi->Operands[Latch];
+
+    Instruction* init = CreateBefore(Fn, preheader->GetTerminator(), OpCode::Mul, Phi->Type);
+    AddOperand(init, Phi->Operands[1 - Latch]);
+    AddOperand(init, CreateConstBefore(Fn, init, Phi->Type, Factor));
+
+    Instruction* variable = Fn.Create(header, OpCode::Phi, Phi->Type);
+    variable->Location = Phi->Location;
+
+    // After the increment of i, where the next value of j is also needed
+    auto& instructions = next->Parent->Instructions;
+    Instruction* increment = Fn.Create(next->Parent, OpCode::Add, Phi->Type);
+    instructions.pop_back();
+    instructions.insert(std::find(instructions.begin(), instructions.end(), next) + 1, increment);
+    AddOperand(increment, variable);
+    AddOperand(increment, CreateConstBefore(Fn, increment, Phi->Type, Step * Factor));
+
+    for (USize i = 0; i < header->Preds.size(); i++) {
+        AddOperand(variable, i == Latch ? increment : init);
+    }
+
+    for (Instruction* product : Products) {
+        Replace(product, variable);
+    }
+}
+
+bool ReduceInductionVariables(Function& Fn) {
+    ComputeDominators(Fn);
+    bool changed = false;
+
+    for (BasicBlock* header : Fn.Blocks) {
+        // A single back edge and a preheader that only goes to the loop, as the loops that the builder makes
+        if (header->Preds.size() != 2)
+            continue;
+
+        USize latch = Dominates(header, header->Preds[0]) ? 0 : 1;
+        BasicBlock* preheader = header->Preds[1 - latch];
+        if (!Dominates(header, header->Preds[latch]) || Dominates(header, preheader) || preheader->Succs.size() != 1)
+            continue;
+
+        Vector<Instruction*> phis = {};
+        for (Instruction* inst : header->Instructions) {
+            if (!inst->Is(OpCode::Phi))
+                break;
+            if (inst->Type.IsInt() || inst->Type.IsUInt()) {
+                phis.emplace_back(inst);
+            }
+        }
+
+        for (Instruction* phi : phis) {
+            UInt64 step = 0;
+            if (!GetStep(phi, latch, step))
+                continue;
+
+            // The products by the same factor share the variable,
+            // a use dominated by the header sees i and j of the same iteration
+            Vector<Instruction*> users = phi->Users;
+            for (USize i = 0; i < users.size(); i++) {
+                if (users[i] == nullptr)
+                    continue;
+
+                UInt64 factor = GetFactor(users[i], phi);
+                if (factor < 2 || !Dominates(header, users[i]->Parent))
+                    continue;
+
+                Vector<Instruction*> products = { users[i] };
+                for (USize j = i + 1; j < users.size(); j++) {
+                    if (users[j] != nullptr && GetFactor(users[j], phi) == factor && Dominates(header, users[j]->Parent)) {
+                        products.emplace_back(users[j]);
+                        users[j] = nullptr;
+                    }
+                }
+
+                ReduceProduct(Fn, phi, latch, step, factor, products);
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+}
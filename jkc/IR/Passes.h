@@ -0,0 +1,27 @@
+#pragma once
+#include "jkc/IR/IR.h"
+
+namespace IR {
+
+// The passes returns true if they changed the function
+
+// Folds the operations of constants, the identities, the phis of a single value
+// and the branches of known direction, the unreachable blocks are removed
+bool FoldConstants(Function& Fn);
+// Removes the values without side effects that aren't used
+bool EliminateDeadCode(Function& Fn);
+// Dominator based value numbering, a pure operation is replaced
+// by the equal operation that dominates it
+bool NumberValues(Function& Fn);
+// Moves the pure operations of a natural loop that only depends on values
+// defined outside the loop to its preheader
+bool HoistLoopInvariants(Function& Fn);
+// Replaces the multiplications and divisions by a power of two with shifts and
+// the remainders of them with masks, removes the masks and shifts that don't
+// change a value narrower than its type
+bool ReduceStrength(Function& Fn);
+// Replaces the products of a induction variable of a loop by a constant with
+// a new induction variable, increased by the step of the first times the constant
+bool ReduceInductionVariables(Function& Fn);
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <jkr/CoreTypes.h>
+#include <jkr/Vector.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// Runs independent jobs on a group of worker threads,
+// each worker takes the next pending job until there are no more
+struct JobScheduler {
+    // 0 workers uses a worker per hardware thread
+    JobScheduler(UInt32 Workers = 0) :
+        Workers(Workers ? Workers : std::max(1u, std::thread::hardware_concurrency())) {}
+
+    // Calls Job(Index) for each index in [0, Count), returns when all of them are done
+    template<typename JobFn>
+    void Run(USize Count, JobFn&& Job) {
+        std::atomic<USize> next = 0;
+        auto worker = [&]() {
+            for (USize i = next++; i < Count; i = next++) {
+                Job(i);
+            }
+        };
+
+        USize threads = std::min<USize>(Workers, Count);
+        Vector<std::thread> pool = {};
+        if (threads > 1) {
+            pool.reserve(threads - 1);
+            for (USize i = 1; i < threads; i++) {
+                pool.emplace_back(worker);
+            }
+        }
+
+        // The calling thread is a worker too
+        worker();
+
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+
+    UInt32 Workers;
+};
@@ -0,0 +1,32 @@
+#include "jkc/Lexer/Atom.h"
+#include <cassert>
+
+Atom AtomTable::Intern(const StringView& Name) {
+    USize hash = std::hash<StringView>{}(Name);
+    UInt32 shardIndex = UInt32(hash >> 7) & (ShardCount - 1);
+    Shard& shard = Shards[shardIndex];
+
+    std::lock_guard lock{ shard.Lock };
+    auto it = shard.Atoms.find(Name);
+    if (it != shard.Atoms.end())
+        return it->second;
+
+    // The first name of a shard is 1, 0 is NoAtom
+    const String& name = shard.Names.emplace_back(Name);
+    Atom atom = Atom(shard.Names.size() << ShardBits) | shardIndex;
+    shard.Atoms.emplace(StringView(name), atom);
+    return atom;
+}
+
+StringView AtomTable::GetName(Atom Value) {
+    assert(Value != NoAtom && "NoAtom has no name");
+    Shard& shard = Shards[Value & (ShardCount - 1)];
+
+    std::lock_guard lock{ shard.Lock };
+    return shard.Names[(Value >> ShardBits) - 1];
+}
+
+AtomTable& GetAtomTable() {
+    static AtomTable table;
+    return table;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <jkr/String.h>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+// Interned identifier, the lexer interns every identifier once
+// and the rest of the compiler compares the atoms instead of the names
+using Atom = UInt32;
+
+inline constexpr Atom NoAtom = 0;
+
+// Table of every identifier seen by the compiler, shared by all the modules.
+// The modules are lexed in parallel, so the table is split in shards
+// with a lock each, the low bits of an atom are the shard that owns it
+struct AtomTable {
+    static constexpr UInt32 ShardBits = 6;
+    static constexpr UInt32 ShardCount = 1 << ShardBits;
+
+    Atom Intern(const StringView& Name);
+    // The names are owned by the table, the views are valid until exit
+    StringView GetName(Atom Value);
+
+    struct Shard {
+        std::mutex Lock;
+        std::unordered_map<StringView, Atom> Atoms;
+        std::deque<String> Names;
+    };
+
+    Shard Shards[ShardCount];
+};
+
+AtomTable& GetAtomTable();
+
+inline Atom InternAtom(const StringView& Name) {
+    return GetAtomTable().Intern(Name);
+}
@@ -1,6 +1,13 @@
 #include "jkc/Lexer/Lexer.h"
 #include <jkr/Definitions.h>
-#include <cassert>
+#include <bit>
+#include <charconv>
+#include <limits>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+    #define LEXER_SSE2 1
+    #include <emmintrin.h>
+#endif
 
 struct IdentifierInfo {
     UInt32 Len;
@@ -8,7 +15,7 @@ struct IdentifierInfo {
     Type Type;
 };
 
-static IdentifierInfo Identifiers[] = {
+static constexpr IdentifierInfo Identifiers[] = {
     {.Len = 2, .Str = u8"fn", .Type = Type::Fn },
     {.Len = 6, .Str = u8"return", .Type = Type::Return },
     
@@ -20,6 +27,7 @@ static IdentifierInfo Identifiers[] = {
     {.Len = 4, .Str = u8"else", .Type = Type::Else },
     {.Len = 3, .Str = u8"for", .Type = Type::For },
     {.Len = 5, .Str = u8"while", .Type = Type::While },
+    {.Len = 6, .Str = u8"struct", .Type = Type::Struct },
 
     {.Len = 3, .Str = u8"Any", .Type = Type::TypeAny },
     {.Len = 4, .Str = u8"Void", .Type = Type::TypeVoid },
@@ -32,108 +40,329 @@ static IdentifierInfo Identifiers[] = {
     {.Len = 6, .Str = u8"extern", .Type = Type::ExternAttr },
 };
 
+constexpr UInt32 KeywordSlotsSize = 32;
+
+// Perfect hash of the keywords, a new keyword could need other factors
+static constexpr UInt32 HashKeyword(const Char* Name, USize Len) {
+    return UInt32((Name[0] + Name[Len - 1]) * 9 + Len) & (KeywordSlotsSize - 1);
+}
+
+struct KeywordSlots {
+    IdentifierInfo Slots[KeywordSlotsSize];
+    bool HasCollisions;
+};
+
+static constexpr KeywordSlots MakeKeywordSlots() {
+    KeywordSlots keywords = {};
+    for (auto& identifier : Identifiers) {
+        IdentifierInfo& slot = keywords.Slots[HashKeyword(identifier.Str, identifier.Len)];
+        keywords.HasCollisions |= slot.Len != 0;
+        slot = identifier;
+    }
+    return keywords;
+}
+
+static constexpr KeywordSlots Keywords = MakeKeywordSlots();
+static_assert(!Keywords.HasCollisions, "The keyword hash has collisions");
+
 static inline void FindIdentifier(Token& Tk) {
-    for (UInt32 i = 0; i < std::size(Identifiers); i++) {
-        if (Identifiers[i].Len != Tk.Value.StrRef.size())
-            continue;
+    const StringView& name = Tk.Value.StrRef;
+    const IdentifierInfo& slot = Keywords.Slots[HashKeyword(name.data(), name.size())];
+
+    if (slot.Len == name.size() && memcmp(slot.Str, name.data(), slot.Len) == 0) {
+        Tk.Type = slot.Type;
+    }
+    else {
+        Tk.Type = Type::Identifier;
+        Tk.Value.Name = InternAtom(name);
+    }
+}
+
+// Scanning of runs of characters, the blocks are tested 16 characters at once
+// and the remaining characters one by one
+
+constexpr USize BlockSize = 16;
+
+static constexpr bool IsWhiteSpace(Char C) {
+    return C == ' ' || C == '\t' || C == '\n' || C == '\r';
+}
+
+static constexpr bool IsIdentifier(Char C) {
+    return (C >= 'a' && C <= 'z') || (C >= 'A' && C <= 'Z') || (C >= '0' && C <= '9') || C == '_';
+}
+
+#if LEXER_SSE2
+static inline __m128i LoadBlock(const StringView& Content, USize Index) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Content.data() + Index));
+}
+
+static inline UInt32 MatchChar(__m128i Block, char C) {
+    return UInt32(_mm_movemask_epi8(_mm_cmpeq_epi8(Block, _mm_set1_epi8(C))));
+}
 
-        if (memcmp(Identifiers[i].Str, Tk.Value.StrRef.data(), Identifiers[i].Len) == 0) {
-            Tk.Type = Identifiers[i].Type;
-            return;
+// The characters over 0x7F are negative, so they are out of the ranges
+static inline __m128i MatchRange(__m128i Block, char First, char Last) {
+    return _mm_and_si128(
+        _mm_cmpgt_epi8(Block, _mm_set1_epi8(char(First - 1))),
+        _mm_cmplt_epi8(Block, _mm_set1_epi8(char(Last + 1)))
+    );
+}
+
+static inline UInt32 MatchWhiteSpace(__m128i Block) {
+    return MatchChar(Block, ' ') | MatchChar(Block, '\t') | MatchChar(Block, '\n') | MatchChar(Block, '\r');
+}
+
+static inline UInt32 MatchIdentifier(__m128i Block) {
+    __m128i letters = _mm_or_si128(MatchRange(Block, 'a', 'z'), MatchRange(Block, 'A', 'Z'));
+    __m128i digits = MatchRange(Block, '0', '9');
+    return UInt32(_mm_movemask_epi8(_mm_or_si128(letters, digits))) | MatchChar(Block, '_');
+}
+#endif // LEXER_SSE2
+
+static USize ScanWhiteSpace(const StringView& Content, USize Index) {
+#if LEXER_SSE2
+    while (Content.size() - Index >= BlockSize) {
+        UInt32 mismatch = ~MatchWhiteSpace(LoadBlock(Content, Index)) & 0xFFFF;
+        if (mismatch) {
+            return Index + std::countr_zero(mismatch);
         }
+        Index += BlockSize;
+    }
+#endif // LEXER_SSE2
+    while (Index < Content.size() && IsWhiteSpace(Content[Index])) {
+        Index++;
     }
+    return Index;
+}
 
-    Tk.Type = Type::Identifier;
+static USize ScanIdentifier(const StringView& Content, USize Index) {
+#if LEXER_SSE2
+    while (Content.size() - Index >= BlockSize) {
+        UInt32 mismatch = ~MatchIdentifier(LoadBlock(Content, Index)) & 0xFFFF;
+        if (mismatch) {
+            return Index + std::countr_zero(mismatch);
+        }
+        Index += BlockSize;
+    }
+#endif // LEXER_SSE2
+    while (Index < Content.size() && IsIdentifier(Content[Index])) {
+        Index++;
+    }
+    return Index;
+}
+
+// Returns the index of the next newline or the end of the content
+static USize ScanLine(const StringView& Content, USize Index) {
+#if LEXER_SSE2
+    while (Content.size() - Index >= BlockSize) {
+        UInt32 newlines = MatchChar(LoadBlock(Content, Index), '\n');
+        if (newlines) {
+            return Index + std::countr_zero(newlines);
+        }
+        Index += BlockSize;
+    }
+#endif // LEXER_SSE2
+    while (Index < Content.size() && Content[Index] != '\n') {
+        Index++;
+    }
+    return Index;
+}
+
+static USize CountNewLines(const StringView& Content, USize Index, USize End) {
+    USize count = 0;
+#if LEXER_SSE2
+    while (End - Index >= BlockSize) {
+        count += std::popcount(MatchChar(LoadBlock(Content, Index), '\n'));
+        Index += BlockSize;
+    }
+#endif // LEXER_SSE2
+    while (Index < End) {
+        count += Content[Index] == '\n';
+        Index++;
+    }
+    return count;
+}
+
+void Lexer::SkipWhiteSpace() {
+    Seek(ScanWhiteSpace(FileContent, Index));
+}
+
+SourceLocation Lexer::GetLocation() {
+    Line += CountNewLines(FileContent, LineIndex, Index);
+    LineIndex = Index;
+    return SourceLocation(FileName, Line);
 }
 
 Token Lexer::GetIdentifier() {
     Token tk{};
     tk.Type = Type::Unknown;
-    tk.Location = SourceLocation(FileName, Line);
+    tk.Location = GetLocation();
 
     USize start = Index;
-    while (isalnum(Current) || Current == '_') {
-        Advance();
-    }
+    Seek(ScanIdentifier(FileContent, Index));
     tk.Value.StrRef = FileContent.substr(start, Index - start);
 
     FindIdentifier(tk);
     return tk;
 }
 
+// Value of a digit up to base 16, 0xFF if it isn't a digit
+static constexpr Byte DigitValue(Char C) {
+    if (C >= '0' && C <= '9') return Byte(C - '0');
+    if (C >= 'a' && C <= 'f') return Byte(C - 'a' + 10);
+    if (C >= 'A' && C <= 'F') return Byte(C - 'A' + 10);
+    return 0xFF;
+}
+
+// The digits can be separated by '_'
+static constexpr bool IsDigitOrSeparator(Char C) {
+    return DigitValue(C) != 0xFF || C == '_';
+}
+
+void Lexer::NumberError(const Token& Tk, USize Start, const char* Message) {
+    StringView literal = FileContent.substr(Start, Index - Start);
+    fprintf(ErrorStream, "%s:%llu: Error: %s: '%.*s'\n",
+            FileName, Tk.Location.Line, Message, Int32(literal.size()), (const char*)literal.data());
+    IsPanicMode = true;
+}
+
 Token Lexer::GetDigit() {
     Token tk{};
     tk.Type = Type::ConstInteger;
-    tk.Location = SourceLocation(FileName, Line);
-    Int32 base = 10;
+    tk.Location = GetLocation();
 
-    std::string digit{};
-loop:
-    while (isdigit(Current)) {
-        digit.push_back(Current);
+    USize start = Index;
+    UInt32 base = 10;
+    if (Current == '0' && GetOffset(1) == 'x') {
+        base = 16;
+        Seek(Index + 2);
+    }
+    else if (Current == '0' && GetOffset(1) == 'b' && (GetOffset(2) == '0' || GetOffset(2) == '1')) {
+        base = 2;
+        Seek(Index + 2);
+    }
+
+    // The hexadecimal digits are scanned in every base, so 1000H is a single literal
+    USize digits = Index;
+    while (IsDigitOrSeparator(Current)) {
         Advance();
     }
+    USize digitsEnd = Index;
 
-    if (Current == '.') {
-        tk.Type = Type::ConstFloat;
+    if (base == 10 && Current == 'H') {
+        base = 16;
         Advance();
-        digit.push_back('.');
-        goto loop;
     }
-    else if (Current == 'U') {
+    else if (base == 10 && Current == '.') {
+        GetFloat(tk, start);
+        return tk;
+    }
+
+    if (Current == 'U') {
         tk.Type = Type::ConstUInteger;
         Advance();
     }
 
-    if (tk.Type == Type::ConstFloat)
-        tk.Value.Real = std::stod(digit);
-    else if (tk.Type == Type::ConstUInteger)
-        tk.Value.Unsigned = std::stoull(digit, NULL, base);
-    else
-        tk.Value.Signed = std::stoll(digit, NULL, base);
+    const UInt limit = tk.Type == Type::ConstUInteger ? std::numeric_limits<UInt>::max() : std::numeric_limits<Int>::max();
+    UInt value = 0;
+    bool hasDigits = false;
+    for (USize i = digits; i < digitsEnd; i++) {
+        if (FileContent[i] == '_') {
+            continue;
+        }
+
+        UInt digit = DigitValue(FileContent[i]);
+        if (digit >= base) {
+            NumberError(tk, start, "Invalid digit in number");
+            return tk;
+        }
+
+        if (value > (limit - digit) / base) {
+            NumberError(tk, start, tk.Type == Type::ConstUInteger ?
+                        "Number too large for UInt" : "Number too large for Int, use the U suffix");
+            return tk;
+        }
+
+        value = value * base + digit;
+        hasDigits = true;
+    }
+
+    if (!hasDigits) {
+        NumberError(tk, start, "Number without digits");
+        return tk;
+    }
+
+    tk.Value.Unsigned = value;
     return tk;
 }
 
+void Lexer::GetFloat(Token& Tk, USize Start) {
+    Tk.Type = Type::ConstFloat;
+
+    Advance();
+    while (IsDigitOrSeparator(Current)) {
+        Advance();
+    }
+
+    StringView literal = FileContent.substr(Start, Index - Start);
+    const char* first = (const char*)literal.data();
+    const char* last = first + literal.size();
+
+    // The separators are removed in a copy, the literals without them are parsed in place
+    char buffer[128];
+    if (literal.find('_') != StringView::npos) {
+        USize size = 0;
+        for (Char c : literal) {
+            if (c == '_') continue;
+            if (size == sizeof(buffer)) {
+                NumberError(Tk, Start, "Float too long");
+                return;
+            }
+            buffer[size++] = char(c);
+        }
+
+        first = buffer;
+        last = buffer + size;
+    }
+
+    auto [end, ec] = std::from_chars(first, last, Tk.Value.Real);
+    if (ec == std::errc::result_out_of_range) {
+        NumberError(Tk, Start, "Float out of range");
+    }
+    else if (ec != std::errc() || end != last) {
+        NumberError(Tk, Start, "Invalid float");
+    }
+}
+
 Token Lexer::GetString() {
     Token tk{};
     tk.Type = Type::ConstString;
-    tk.Location = SourceLocation(FileName, Line);
+    tk.Location = GetLocation();
 
     Advance();
 
-    tk.Value.Str = {};
+    // Only validates the escape sequences, the emitter decodes them
+    USize start = Index;
+    UInt size = 0;
     while (Current != '\"' && Current != '\0') {
         if (Current == '\\') {
-            Advance();
-            switch (Current) {
-            case '0':
-                tk.Value.Str.push_back('\0');
-                break;
-            case 'n':
-                tk.Value.Str.push_back('\n');
-                break;
-            case 't':
-                tk.Value.Str.push_back('\t');
-                break;
-            case 'r':
-                tk.Value.Str.push_back('\r');
-                break;
-            default:
-                assert(0 && "Invalid string character");
-                UNREACHABLE();
-                break;
+            Char decoded = 0;
+            if (!DecodeEscape(GetOffset(1), decoded)) {
+                fprintf(ErrorStream, "%s:%llu: Error: Invalid escape sequence\n", FileName, GetLocation().Line);
+                IsPanicMode = true;
             }
             Advance();
-
-        }
-        else {
-            tk.Value.Str.push_back(Current);
-            Advance();
         }
+
+        Advance();
+        size++;
     }
 
+    tk.Value.StrRef = FileContent.substr(start, Index - start);
+    tk.Value.Unsigned = size;
+
     if (Current == '\0') {
-        fprintf(ErrorStream, "%s:%llu: Error: Bad string\n", FileName, Line);
+        fprintf(ErrorStream, "%s:%llu: Error: Bad string\n", FileName, GetLocation().Line);
         IsPanicMode = true;
     }
 
@@ -241,8 +470,7 @@ start:
         if (GetOffset(1) == '=')
             MakeTwo(Type::SlashEqual, tk);
         else if (GetOffset(1) == '/') {
-            while (Current != '\n')
-                Advance();
+            Seek(ScanLine(FileContent, Index));
             goto start;
         }
         else
@@ -286,8 +514,8 @@ start:
         }
         else {
             fprintf(ErrorStream,
-                    "%s:%llu: Error: Unexpected character %c",
-                    FileName, Line, Current
+                    "%s:%llu: Error: Unexpected character %c\n",
+                    FileName, GetLocation().Line, Current
             );
             IsPanicMode = true;
             Advance();
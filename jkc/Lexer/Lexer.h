@@ -17,6 +17,7 @@ struct Lexer {
         Current = 0;
         Index = 0;
         Line = 1;
+        LineIndex = 0;
     
         if (Content.size()) { Current = Content[0]; }
     }
@@ -25,44 +26,34 @@ struct Lexer {
     
     Token GetNext();
 
-    constexpr void Advance() {
-        if ((Index + 1) < FileContent.size()) {
-            Index++;
-            Current = FileContent[Index];
-
-            if (Current == '\n') Line++;
-        }
-        else {
-            Current = '\0';
-        }
+    // The end of the content is reached with Current as '\0'
+    constexpr void Seek(USize NewIndex) {
+        Index = NewIndex;
+        Current = Index < FileContent.size() ? FileContent[Index] : '\0';
     }
 
-    constexpr void SkipWhiteSpace() {
-        while (
-            Current == ' ' ||
-            Current == '\t' ||
-            Current == '\n' ||
-            Current == '\r') {
-            Advance();
-        }
+    constexpr void Advance() {
+        Seek(Index < FileContent.size() ? Index + 1 : Index);
     }
 
-    constexpr void MakeSimple(Type Type, Token& Tk) {
-        Tk = Token(Type, TokenValue(), SourceLocation(FileName, Line));
+    void SkipWhiteSpace();
+
+    // The lines are counted lazily, only when a token needs its location
+    SourceLocation GetLocation();
+
+    void MakeSimple(Type Type, Token& Tk) {
+        Tk = Token(Type, TokenValue(), GetLocation());
         Advance();
     }
 
-    constexpr void MakeTwo(Type Type, Token& Tk) {
-        Tk = Token(Type, TokenValue(), SourceLocation(FileName, Line));
-        Advance();
-        Advance();
+    void MakeTwo(Type Type, Token& Tk) {
+        Tk = Token(Type, TokenValue(), GetLocation());
+        Seek(Index + 2);
     }
 
-    constexpr void MakeThree(Type Type, Token& Tk) {
-        Tk = Token(Type, TokenValue(), SourceLocation(FileName, Line));
-        Advance();
-        Advance();
-        Advance();
+    void MakeThree(Type Type, Token& Tk) {
+        Tk = Token(Type, TokenValue(), GetLocation());
+        Seek(Index + 3);
     }
 
     constexpr Char GetOffset(UInt32 Off) {
@@ -71,6 +62,8 @@ struct Lexer {
 
     Token GetIdentifier();
     Token GetDigit();
+    void GetFloat(Token& Tk, USize Start);
+    void NumberError(const Token& Tk, USize Start, const char* Message);
     Token GetString();
 
     const char* FileName;
@@ -80,5 +73,7 @@ struct Lexer {
     StringView FileContent;
     Char Current = 0;
     USize Index = 0;
+    // Line of LineIndex, the newlines before it are already counted
     USize Line = 1;
+    USize LineIndex = 0;
 };
@@ -1,5 +1,7 @@
 #pragma once
+#include "jkc/Lexer/Atom.h"
 #include <jkr/String.h>
+#include <type_traits>
 
 enum class Type {
     Unknown = 0,
@@ -20,6 +22,7 @@ enum class Type {
     Else,
     For,
     While,
+    Struct,
 
     TypeAny,
     TypeVoid,
@@ -82,39 +85,50 @@ struct SourceLocation {
     constexpr explicit SourceLocation(const char* FileName, USize Line) :
         FileName(FileName), Line(Line) 
     {}
-    constexpr ~SourceLocation() {}
 
     const char* FileName;
     USize Line;
 };
 
+// Decodes the character after a '\\' in a string literal,
+// returns false if isn't a valid escape sequence
+constexpr bool DecodeEscape(Char Escape, Char& Decoded) {
+    switch (Escape) {
+    case '0': Decoded = '\0'; return true;
+    case 'n': Decoded = '\n'; return true;
+    case 't': Decoded = '\t'; return true;
+    case 'r': Decoded = '\r'; return true;
+    case '\\': Decoded = '\\'; return true;
+    case '\"': Decoded = '\"'; return true;
+    default: return false;
+    }
+}
+
+// The tokens are views into the source, they are copied freely
 struct TokenValue {
     constexpr explicit TokenValue() {}
-    constexpr ~TokenValue() {}
 
-    TokenValue(TokenValue&&) = default;
-    TokenValue& operator=(TokenValue&&) = default;
-
-    String Str{};
+    // The identifiers or the contents of a string literal,
+    // the escape sequences of a string are decoded by the emitter
     StringView StrRef{};
+    // A string literal has the size without escape sequences in Unsigned
     union {
         Int Signed = 0;
         UInt Unsigned;
         Float64 Real;
+        // Interned name of an identifier
+        Atom Name;
     };
 };
 
 struct Token {
     constexpr Token() {}
-    constexpr Token(Type Type, TokenValue&& Value, const SourceLocation& Location)
-        : Type(Type), Value(std::move(Value)), Location(Location) {}
-    constexpr ~Token() {}
-
-    Token(Token&&) = default;
-    Token& operator=(Token&&) = default;
+    constexpr Token(Type Type, const TokenValue& Value, const SourceLocation& Location)
+        : Type(Type), Value(Value), Location(Location) {}
 
     Type Type{};
     TokenValue Value{};
     SourceLocation Location{};
 };
 
+static_assert(std::is_trivially_copyable_v<Token>, "The tokens must to be plain views");
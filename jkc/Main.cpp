@@ -1,8 +1,10 @@
 #include <jkc/Compiler.h>
+#include <jkc/Server/Server.h>
 #include <jkr/NI/NI.h>
 #include <jkr/Error.h>
 #include <jkr/Runtime/Value.h>
 #include <chrono>
+#include <string.h>
 
 std::chrono::high_resolution_clock::time_point start;
 std::chrono::high_resolution_clock::time_point  end;
@@ -56,7 +58,46 @@ static inline void EndAction(const char* /*FileName*/, ActionType Type, bool Err
     }
 }
 
-int main() {
+// jkc [-O0] [-j Jobs] [-cache Directory] [-inline Threshold] [-profile File] [-lib File]... File...
+// Compiles the modules in parallel, -O0 disables the optimizations, -lib compiles the next file as a library,
+// -inline 0 disables the inliner, -profile optimizes with the profile written by
+// jkrVMWriteProfile for a execution of a previous build
+static int CompileModules(const BuildArguments& Arguments) {
+    ProfileData pd = {
+        .BeginAction = BeginAction,
+        .EndAction = EndAction,
+    };
+
+    Compiler compiler = Compiler(stderr, pd);
+    if (!compiler.CompileModules(Arguments.GetModules(), Arguments.GetOptions(), Arguments.Jobs).Success) {
+        puts("Compilation fail");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // jkc -server Socket
+    // jkc -connect Socket Arguments...
+    // jkc -connect Socket -shutdown
+    if (argc > 2 && !strcmp(argv[1], "-server")) {
+        return RunServer((Str)argv[2], stderr);
+    }
+
+    if (argc > 1) {
+        bool connect = argc > 2 && !strcmp(argv[1], "-connect");
+
+        BuildArguments arguments = {};
+        arguments.Parse(Vector<std::string>(argv + (connect ? 3 : 1), argv + argc));
+        if (connect) {
+            arguments.MakeAbsolute();
+            return RunClient((Str)argv[2], arguments, stderr);
+        }
+
+        return CompileModules(arguments);
+    }
+
     {
         ProfileData pd = {
             .BeginAction = BeginAction,
@@ -1,9 +1,10 @@
 #include "jkc/Parser/Parser.h"
 #include "jkc/AST/Expresions.h"
 #include "jkc/AST/Statements.h"
+#include <jkr/CodeFile/OpCodes.h>
 #include <stdarg.h>
 
-using ParseExpresionFn = std::unique_ptr<AST::Expresion> (Parser::*)(bool, std::unique_ptr<AST::Expresion>);
+using ParseExpresionFn = AST::Expresion* (Parser::*)(bool, AST::Expresion*);
 
 struct ParseRule {
     Type Type;
@@ -28,6 +29,7 @@ static constexpr ParseRule Rules[] = {
     { Type::Else,              nullptr,                    nullptr,                  Parser::ParsePrecedence::None },
     { Type::For,               nullptr,                    nullptr,                  Parser::ParsePrecedence::None },
     { Type::While,             nullptr,                    nullptr,                  Parser::ParsePrecedence::None },
+    { Type::Struct,            nullptr,                    nullptr,                  Parser::ParsePrecedence::None },
     { Type::TypeAny,           nullptr,                    nullptr,                  Parser::ParsePrecedence::None },
     { Type::TypeVoid,          nullptr,                    nullptr,                  Parser::ParsePrecedence::None },
     { Type::TypeByte,          nullptr,                    nullptr,                  Parser::ParsePrecedence::None },
@@ -85,10 +87,15 @@ static constexpr ParseRule GetRule(Type Type) {
 //////////////////////////////////////////////////////////////////////////////////////////
 
 void Parser::Advance() {
-    Last = std::move(Current);
-    Current = std::move(Next);
+    Last = Current;
+    Current = Next;
     Next = SourceLexer.GetNext();
 
+    TokenHash = HashValue(TokenHash, Last.Type);
+    // The atoms depend on the order of interning, the names are hashed instead
+    TokenHash = HashValue(TokenHash, Last.Type == Type::Identifier ? UInt(0) : Last.Value.Unsigned);
+    TokenHash = HashBytes(TokenHash, Last.Value.StrRef.data(), Last.Value.StrRef.size());
+
     if (!SourceLexer.Success()) {
         IsPanicMode = true;
     }
@@ -139,6 +146,8 @@ void Parser::Syncronize() {
             break;
         case Type::Var:
             return;
+        case Type::Struct:
+            return;
         default:
             break;
         }
@@ -151,8 +160,17 @@ AST::TypeDecl Parser::ParseType() {
     AST::TypeDecl type{};
     type.Primitive = AST::TypeDecl::Type::Unknown;
 
-    while (IsType() || IsTypeAttrib()) {
+    while (IsType() || IsTypeAttrib() || 
+           (Current.Type == Type::Identifier && type.Primitive == AST::TypeDecl::Type::Unknown)) {
         switch (Current.Type) {
+        case Type::Identifier:
+            // A user defined type, the emitter resolve the struct
+            type.SizeInBits = 64;
+            type.Primitive = AST::TypeDecl::Type::Struct;
+            type.StructName = Current.Value.StrRef;
+            type.StructAtom = Current.Value.Name;
+            Advance();
+            break;
         case Type::TypeAny:
             type.SizeInBits = 64;
             type.Primitive = AST::TypeDecl::Type::Any;
@@ -215,9 +233,8 @@ AST::TypeDecl Parser::ParseType() {
 // Expresions
 //////////////////////////////////////////////////////////////////////////////////////////
 
-std::unique_ptr<AST::Expresion> Parser::ParseConstantValue(bool, 
-                                                       std::unique_ptr<AST::Expresion> /*RHS*/) {
-    auto constVal = std::make_unique<AST::Constant>(
+AST::Expresion* Parser::ParseConstantValue(bool, AST::Expresion* /*RHS*/) {
+    auto constVal = Nodes->New<AST::Constant>(
         Last.Location
     );
 
@@ -241,27 +258,27 @@ std::unique_ptr<AST::Expresion> Parser::ParseConstantValue(bool,
         constVal->ValueType.Flags |= AST::TypeDecl::Const;
         constVal->ValueType.Flags |= AST::TypeDecl::Array;
         
-        constVal->ValueType.ArrayLen = (UInt32)Last.Value.Str.size();
+        constVal->ValueType.ArrayLen = (UInt32)Last.Value.Unsigned;
         constVal->ValueType.SizeInBits = 8;
 
-        constVal->String = std::move(Last.Value.Str);
+        constVal->String = Last.Value.StrRef;
     }
 
     return constVal;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseIdentifier(bool /*CanAssign*/, 
-                                                        std::unique_ptr<AST::Expresion>) {
-    auto id = std::make_unique<AST::Identifier>(
+AST::Expresion* Parser::ParseIdentifier(bool /*CanAssign*/, AST::Expresion*) {
+    auto id = Nodes->New<AST::Identifier>(
         Last.Location
     );
     id->ID = Last.Value.StrRef;
+    id->IDAtom = Last.Value.Name;
 
     return id;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseGroup(bool, std::unique_ptr<AST::Expresion>) {
-    auto group = std::make_unique<AST::Group>(
+AST::Expresion* Parser::ParseGroup(bool, AST::Expresion*) {
+    auto group = Nodes->New<AST::Group>(
         Last.Location
     );
 
@@ -270,18 +287,17 @@ std::unique_ptr<AST::Expresion> Parser::ParseGroup(bool, std::unique_ptr<AST::Ex
     return group;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseCall(bool, std::unique_ptr<AST::Expresion> Expresion) {
-    auto call = std::make_unique<AST::Call>(
+AST::Expresion* Parser::ParseCall(bool, AST::Expresion* Expresion) {
+    auto call = Nodes->New<AST::Call>(
         SourceLocation(Current.Location)
     );
 
-    call->Target = std::move(Expresion);
+    call->Target = Expresion;
 
     Advance(); // (
 
     while (Current.Type != Type::RightParent && Current.Type != Type::EndOfFile) {
-        std::unique_ptr<AST::Expresion>& expr = call->Arguments.emplace_back();
-        expr = ParseExpresion(ParsePrecedence::Assignment);
+        call->Arguments.Push(*Nodes, ParseExpresion(ParsePrecedence::Assignment));
 
         if (Current.Type != Type::RightParent) {
             Expected(Type::Comma, u8"',' was expected");
@@ -292,16 +308,29 @@ std::unique_ptr<AST::Expresion> Parser::ParseCall(bool, std::unique_ptr<AST::Exp
     return call;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseDot(bool, std::unique_ptr<AST::Expresion>) {
-    auto dot = std::make_unique<AST::Dot>(
+AST::Expresion* Parser::ParseDot(bool, AST::Expresion* Expresion) {
+    auto dot = Nodes->New<AST::Dot>(
         SourceLocation(Current.Location)
     );
-    Advance();
+    Advance(); // .
+
+    dot->Left = Expresion;
+    if (!Expected(Type::Identifier, u8"A field name was expected")) {
+        return dot;
+    }
+
+    auto field = Nodes->New<AST::Identifier>(
+        Last.Location
+    );
+    field->ID = Last.Value.StrRef;
+    field->IDAtom = Last.Value.Name;
+    dot->Right = field;
+
     return dot;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseUnary(bool, std::unique_ptr<AST::Expresion>) {
-    auto unary = std::make_unique<AST::Unary>(
+AST::Expresion* Parser::ParseUnary(bool, AST::Expresion*) {
+    auto unary = Nodes->New<AST::Unary>(
         Last.Location
     );
 
@@ -316,12 +345,12 @@ std::unique_ptr<AST::Expresion> Parser::ParseUnary(bool, std::unique_ptr<AST::Ex
     return unary;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseBinaryOp(bool, std::unique_ptr<AST::Expresion> Expresion) {
-    auto binOp = std::make_unique<AST::BinaryOp>(
+AST::Expresion* Parser::ParseBinaryOp(bool, AST::Expresion* Expresion) {
+    auto binOp = Nodes->New<AST::BinaryOp>(
         Last.Location
     );
 
-    binOp->Left = std::move(Expresion);
+    binOp->Left = Expresion;
 
     switch (Current.Type) {
     case Type::Plus: binOp->Op = AST::BinaryOperation::Add; break;
@@ -357,14 +386,13 @@ std::unique_ptr<AST::Expresion> Parser::ParseBinaryOp(bool, std::unique_ptr<AST:
     return binOp;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseArrayList(bool, std::unique_ptr<AST::Expresion>) {
-    auto arrayList = std::make_unique<AST::ArrayList>(
+AST::Expresion* Parser::ParseArrayList(bool, AST::Expresion*) {
+    auto arrayList = Nodes->New<AST::ArrayList>(
         Last.Location
     );
     
     while (Current.Type != Type::RightBrace && Current.Type != Type::EndOfFile) {
-        std::unique_ptr<AST::Expresion>& expr = arrayList->Elements.emplace_back();
-        expr = ParseExpresion(ParsePrecedence::Assignment);
+        arrayList->Elements.Push(*Nodes, ParseExpresion(ParsePrecedence::Assignment));
 
         if (Current.Type != Type::RightBrace) {
             Expected(Type::Comma, u8"',' was expected");
@@ -375,23 +403,21 @@ std::unique_ptr<AST::Expresion> Parser::ParseArrayList(bool, std::unique_ptr<AST
     return arrayList;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseArrayAccess(bool /*CanAssign*/, 
-                                                     std::unique_ptr<AST::Expresion> Expr) {
-    auto arrayAccess = std::make_unique<AST::ArrayAccess>(
+AST::Expresion* Parser::ParseArrayAccess(bool /*CanAssign*/, AST::Expresion* Expr) {
+    auto arrayAccess = Nodes->New<AST::ArrayAccess>(
         Last.Location
     );
 
     Advance(); // [
-    arrayAccess->Expr = std::move(Expr);
+    arrayAccess->Expr = Expr;
     arrayAccess->IndexExpr = ParseExpresion(ParsePrecedence::Assignment);
     Advance(); // ]
 
     return arrayAccess;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseIncDec(bool /*CanAssign*/, 
-                                                std::unique_ptr<AST::Expresion> Expr) {
-    auto incDec = std::make_unique<AST::IncDec>(
+AST::Expresion* Parser::ParseIncDec(bool /*CanAssign*/, AST::Expresion* Expr) {
+    auto incDec = Nodes->New<AST::IncDec>(
         Last.Location
     );
 
@@ -407,7 +433,7 @@ std::unique_ptr<AST::Expresion> Parser::ParseIncDec(bool /*CanAssign*/,
     }
 
     if (Expr) { // Expr++
-        incDec->Expr = std::move(Expr);
+        incDec->Expr = Expr;
         incDec->After = true;
     }
     else { // ++Expr
@@ -418,14 +444,13 @@ std::unique_ptr<AST::Expresion> Parser::ParseIncDec(bool /*CanAssign*/,
     return incDec;
 }
 
-std::unique_ptr<AST::Expresion> Parser::ParseAssignment(bool CanAssign,
-                                                        std::unique_ptr<AST::Expresion> Expr) {
-    auto assignment = std::make_unique<AST::Assignment>(
+AST::Expresion* Parser::ParseAssignment(bool CanAssign, AST::Expresion* Expr) {
+    auto assignment = Nodes->New<AST::Assignment>(
         Last.Location
     );
 
 
-    assignment->Target = std::move(Expr);
+    assignment->Target = Expr;
 
     if (CanAssign) {
         Advance(); // =
@@ -439,8 +464,8 @@ std::unique_ptr<AST::Expresion> Parser::ParseAssignment(bool CanAssign,
 // Expresions
 //////////////////////////////////////////////////////////////////////////////////////////
 
-std::unique_ptr<AST::Expresion> Parser::ParseExpresion(ParsePrecedence Precedence) {
-    std::unique_ptr<AST::Expresion> expr = {};
+AST::Expresion* Parser::ParseExpresion(ParsePrecedence Precedence) {
+    AST::Expresion* expr = nullptr;
 
     ParseExpresionFn prefix = GetRule(Current.Type).Prefix;
     if (prefix == nullptr) {
@@ -454,7 +479,7 @@ std::unique_ptr<AST::Expresion> Parser::ParseExpresion(ParsePrecedence Precedenc
     expr = (this->*prefix)(canAssign, nullptr);
 
     while (Precedence < (GetRule(Current.Type).Precedence)) {
-        expr = (this->*GetRule(Current.Type).Infix)(canAssign, std::move(expr));
+        expr = (this->*GetRule(Current.Type).Infix)(canAssign, expr);
     }
 
     if (canAssign && Current.Type == Type::Equal) {
@@ -464,13 +489,13 @@ std::unique_ptr<AST::Expresion> Parser::ParseExpresion(ParsePrecedence Precedenc
     return expr;
 }
 
-std::unique_ptr<AST::Block> Parser::ParseBlock() {
-    auto block = std::make_unique<AST::Block>(
+AST::Block* Parser::ParseBlock() {
+    auto block = Nodes->New<AST::Block>(
         Current.Location
     );
 
     while (Current.Type != Type::RightBrace && Current.Type != Type::EndOfFile) {
-        block->Statements.emplace_back(ParseStatement());
+        block->Statements.Push(*Nodes, ParseStatement());
     }
 
     return block;
@@ -480,8 +505,9 @@ void Parser::ParseFunctionParameters(AST::Function& Function) {
     while (Current.Type != Type::RightParent && Current.Type != Type::EndOfFile) {
         Expected(Type::Identifier, u8"A identifier was expected");
 
-        auto& param = Function.Parameters.emplace_back();
+        auto& param = Function.Parameters.Push(*Nodes, AST::FunctionParameter());
         param.Name = Last.Value.StrRef;
+        param.NameAtom = Last.Value.Name;
 
         Expected(Type::Colon, u8"':' was expected");
 
@@ -501,19 +527,20 @@ void Parser::ParseFunctionParameters(AST::Function& Function) {
     }
 }
 
-std::unique_ptr<AST::Statement> Parser::ParseFunction(const AttributeInfo& Attribs) {
-    auto function = std::make_unique<AST::Function>(
+AST::Statement* Parser::ParseFunction(const AttributeInfo& Attribs) {
+    auto function = Nodes->New<AST::Function>(
         SourceLocation(Current.Location)
     );
     Advance(); // fn
 
     if (Attribs.Attributes & AttribExtern) {
         function->IsExtern = true;
-        function->LibraryRef = std::move(Attribs.Library);
+        function->LibraryRef = Attribs.Library;
     }
 
     Expected(Type::Identifier, u8"A identifier was expected");
     function->Name = Last.Value.StrRef;
+    function->NameAtom = Last.Value.Name;
 
     Expected(Type::LeftParent, u8"'(' was expected");
     ParseFunctionParameters(*function);
@@ -546,21 +573,28 @@ std::unique_ptr<AST::Statement> Parser::ParseFunction(const AttributeInfo& Attri
         }
         function->IsDefined = true;
 
+        // The body has its own hash, so editing it doesn't change the declarations
+        UInt64 declarationHash = TokenHash;
+        TokenHash = HashSeed;
+
         Context.IsInFn = true;
         function->Body = ParseBlock();
         Context.IsInFn = false;
         Expected(Type::RightBrace, u8"'}' was expected");
 
+        function->BodyHash = TokenHash;
+        TokenHash = declarationHash;
+
         if (Context.ReturnCount == 0) {
             if (function->FunctionType.IsVoid()) {
-                function->Body->Statements.emplace_back(
-                    std::make_unique<AST::Return>(Last.Location)
+                function->Body->Statements.Push(
+                    *Nodes, Nodes->New<AST::Return>(Last.Location)
                 );
             }
             else {
                 ErrorAtCurrent(
-                    u8"\'%s\' must to return a value",
-                    function->Name.c_str()
+                    u8"\'%.*s\' must to return a value",
+                    (int)function->Name.size(), function->Name.data()
                 );
             }
         }
@@ -575,10 +609,10 @@ return_fn:
     return function;
 }
 
-std::unique_ptr<AST::Statement> Parser::ParseReturn() {
+AST::Statement* Parser::ParseReturn() {
     Context.ReturnCount++;
 
-    auto ret = std::make_unique<AST::Return>(Current.Location);
+    auto ret = Nodes->New<AST::Return>(Current.Location);
     Advance();
 
     if (Current.Type == Type::Semicolon) {
@@ -593,14 +627,15 @@ std::unique_ptr<AST::Statement> Parser::ParseReturn() {
     return ret;
 }
 
-std::unique_ptr<AST::Statement> Parser::ParseConstVal() {
-    auto constVal = std::make_unique<AST::ConstVal>(
+AST::Statement* Parser::ParseConstVal() {
+    auto constVal = Nodes->New<AST::ConstVal>(
         Current.Location
     );
     Advance(); // const
 
     Expected(Type::Identifier, u8"A identifier was expected");
     constVal->Name = Last.Value.StrRef;
+    constVal->NameAtom = Last.Value.Name;
     
     Expected(Type::Colon, u8"':' was expected");
     constVal->ConstType = ParseType();
@@ -616,12 +651,13 @@ std::unique_ptr<AST::Statement> Parser::ParseConstVal() {
     return constVal;
 }
 
-std::unique_ptr<AST::Statement> Parser::ParseVar() {
-    auto var = std::make_unique<AST::Var>(Current.Location);
+AST::Statement* Parser::ParseVar() {
+    auto var = Nodes->New<AST::Var>(Current.Location);
     Advance();
 
     Expected(Type::Identifier, u8"A identifier was expected");
     var->Name = Last.Value.StrRef;
+    var->NameAtom = Last.Value.Name;
 
     if (Current.Type != Type::Equal) {
         Expected(Type::Colon, u8"':' was expected");
@@ -646,8 +682,8 @@ std::unique_ptr<AST::Statement> Parser::ParseVar() {
     return var;
 }
 
-std::unique_ptr<AST::If> Parser::ParseIf() {
-    auto _if = std::make_unique<AST::If>(
+AST::If* Parser::ParseIf() {
+    auto _if = Nodes->New<AST::If>(
         Current.Location
     );
     Advance(); // if
@@ -674,8 +710,100 @@ std::unique_ptr<AST::If> Parser::ParseIf() {
     return _if;
 }
 
-std::unique_ptr<AST::Statement> Parser::ParseExpresionStatement() {
-    auto es = std::make_unique<AST::ExpresionStatement>(
+AST::Statement* Parser::ParseWhile() {
+    auto _while = Nodes->New<AST::While>(
+        Current.Location
+    );
+    Advance(); // while
+
+    Expected(Type::LeftParent, u8"'(' was expected");
+    _while->Expr = ParseExpresion(ParsePrecedence::Assignment);
+    Expected(Type::RightParent, u8"')' was expected");
+
+    Expected(Type::LeftBrace, u8"'{' was expected");
+    _while->Body = ParseBlock();
+    Expected(Type::RightBrace, u8"'}' was expected");
+
+    return _while;
+}
+
+AST::Statement* Parser::ParseFor() {
+    auto _for = Nodes->New<AST::For>(
+        Current.Location
+    );
+    Advance(); // for
+
+    Expected(Type::LeftParent, u8"'(' was expected");
+    if (Current.Type == Type::Semicolon) {
+        Advance();
+    }
+    else if (Current.Type == Type::Var) {
+        _for->Init = ParseVar();
+    }
+    else {
+        _for->Init = ParseExpresionStatement();
+    }
+
+    if (Current.Type != Type::Semicolon) {
+        _for->Expr = ParseExpresion(ParsePrecedence::Assignment);
+    }
+    Expected(Type::Semicolon, u8"';' was expected");
+
+    if (Current.Type != Type::RightParent) {
+        _for->Step = ParseExpresion(ParsePrecedence::Assignment);
+    }
+    Expected(Type::RightParent, u8"')' was expected");
+
+    Expected(Type::LeftBrace, u8"'{' was expected");
+    _for->Body = ParseBlock();
+    Expected(Type::RightBrace, u8"'}' was expected");
+
+    return _for;
+}
+
+AST::Statement* Parser::ParseStruct() {
+    auto _struct = Nodes->New<AST::Struct>(
+        Current.Location
+    );
+    Advance(); // struct
+
+    Expected(Type::Identifier, u8"A identifier was expected");
+    _struct->Name = Last.Value.StrRef;
+    _struct->NameAtom = Last.Value.Name;
+
+    Expected(Type::LeftBrace, u8"'{' was expected");
+    while (Current.Type != Type::RightBrace && Current.Type != Type::EndOfFile) {
+        if (!Expected(Type::Identifier, u8"A field name was expected")) {
+            Advance();
+            continue;
+        }
+
+        auto& field = _struct->Fields.Push(*Nodes, AST::StructField());
+        field.Name = Last.Value.StrRef;
+        field.NameAtom = Last.Value.Name;
+        field.Location = Last.Location;
+
+        Expected(Type::Colon, u8"':' was expected");
+        field.Type = ParseType();
+        if (field.Type.Primitive == AST::TypeDecl::Type::Unknown ||
+            field.Type.IsVoid()) {
+            ErrorAtCurrent(u8"A type was expected");
+            Advance();
+        }
+
+        Expected(Type::Semicolon, u8"';' was expected");
+    }
+    Expected(Type::RightBrace, u8"'}' was expected");
+
+    if (_struct->Fields.size() > codefile::MaxFields) {
+        ErrorAtCurrent(u8"%d is the max field count", codefile::MaxFields);
+    }
+
+    return _struct;
+}
+
+AST::Statement* Parser::ParseExpresionStatement() {
+    auto es = Nodes->New<AST::ExpresionStatement>(
         Current.Location
     );
     es->Value = ParseExpresion(ParsePrecedence::Assignment);
@@ -683,8 +811,8 @@ std::unique_ptr<AST::Statement> Parser::ParseExpresionStatement() {
     return es;
 }
 
-std::unique_ptr<AST::Statement> Parser::ParseStatement() {
-    std::unique_ptr<AST::Statement> statement = {};
+AST::Statement* Parser::ParseStatement() {
+    AST::Statement* statement = nullptr;
 
     if (MustSyncronize) {
         Syncronize();
@@ -714,15 +842,33 @@ std::unique_ptr<AST::Statement> Parser::ParseStatement() {
     else if (Current.Type == Type::If) {
         statement = ParseIf();
     }
+    else if (Current.Type == Type::While || Current.Type == Type::For) {
+        if (Context.IsInFn) {
+            statement = Current.Type == Type::While ? ParseWhile() : ParseFor();
+        }
+        else {
+            ErrorAtCurrent(u8"Invalid statement");
+            return nullptr;
+        }
+    }
+    else if (Current.Type == Type::Struct) {
+        if (!Context.IsInFn) {
+            statement = ParseStruct();
+        }
+        else {
+            ErrorAtCurrent(u8"A struct can't be declared inside a function");
+            return nullptr;
+        }
+    }
     else if (Current.Type == Type::LeftBrace) {
         if (Context.IsInFn){
-            auto es = std::make_unique<AST::ExpresionStatement>(
+            auto es = Nodes->New<AST::ExpresionStatement>(
                 Current.Location
             );
             Advance();
             es->Value = ParseBlock();
             Advance();
-            statement = std::move(es);
+            statement = es;
         }
         else {
             ErrorAtCurrent(u8"Invalid statement");
@@ -755,7 +901,7 @@ AttributeInfo Parser::ParseAttribs() {
                 continue;
             }
 
-            attribs.Library = std::move(Last.Value.Str);
+            attribs.Library = Last.Value.StrRef;
             break;
         }
     }
@@ -768,14 +914,18 @@ AST::Program Parser::ParseContent(const char* FileName, const StringView& Conten
     name = name.substr(0, name.find_last_of('.'));
 
     AST::Program program = AST::Program(name);
+    Nodes = &program.Nodes;
+    TokenHash = HashSeed;
     SourceLexer.Set(FileName, Content);
 
     Advance();
     Advance();
 
     while (Current.Type != Type::EndOfFile) {
-        program.Statements.emplace_back(ParseStatement());
+        program.Statements.Push(program.Nodes, ParseStatement());
     }
 
+    Nodes = nullptr;
+    program.DeclarationHash = TokenHash;
     return program;
 }
@@ -2,6 +2,7 @@
 #include "jkc/Lexer/Lexer.h"
 #include "jkc/AST/Program.h"
 #include "jkc/AST/Type.h"
+#include "jkc/Hash.h"
 
 enum AttributeType {
     AttribNone = 0,
@@ -14,7 +15,7 @@ enum AttributeType {
 
 struct AttributeInfo {
     UInt16 Attributes;
-    String Library;
+    StringView Library;
 };
 
 struct Parser {
@@ -33,7 +34,7 @@ struct Parser {
     };
 
     constexpr Parser(FILE* ErrorStream) :
-        ErrorStream(ErrorStream), SourceLexer(SourceLexer) {}
+        ErrorStream(ErrorStream), SourceLexer(ErrorStream, nullptr, StringView()) {}
 
     constexpr ~Parser() {}
 
@@ -78,41 +79,33 @@ struct Parser {
     bool Expected(Type Type, Str Format, ...);
     void Syncronize();
 
-    AST::TypeDecl                   ParseType();
-
-    std::unique_ptr<AST::Expresion> ParseConstantValue(bool CanAssign, 
-                                                   std::unique_ptr<AST::Expresion>);
-    std::unique_ptr<AST::Expresion> ParseIdentifier(bool CanAssign, 
-                                                std::unique_ptr<AST::Expresion>);
-    std::unique_ptr<AST::Expresion> ParseGroup(bool CanAssign, 
-                                           std::unique_ptr<AST::Expresion>);
-    std::unique_ptr<AST::Expresion> ParseCall(bool CanAssign, 
-                                          std::unique_ptr<AST::Expresion> Left);
-    std::unique_ptr<AST::Expresion> ParseDot(bool CanAssign, 
-                                         std::unique_ptr<AST::Expresion> Left);
-    std::unique_ptr<AST::Expresion> ParseUnary(bool CanAssign, 
-                                           std::unique_ptr<AST::Expresion>);
-    std::unique_ptr<AST::Expresion> ParseBinaryOp(bool CanAssign, 
-                                              std::unique_ptr<AST::Expresion> Left);
-    std::unique_ptr<AST::Expresion> ParseArrayList(bool CanAssign, 
-                                               std::unique_ptr<AST::Expresion>);
-    std::unique_ptr<AST::Expresion> ParseArrayAccess(bool CanAssign, 
-                                                 std::unique_ptr<AST::Expresion>);
-    std::unique_ptr<AST::Expresion> ParseIncDec(bool CanAssign, 
-                                                std::unique_ptr<AST::Expresion>);
-    std::unique_ptr<AST::Expresion> ParseAssignment(bool CanAssign,
-                                                std::unique_ptr<AST::Expresion>);
-
-    std::unique_ptr<AST::Expresion> ParseExpresion(ParsePrecedence Precedence);
-    std::unique_ptr<AST::Block>     ParseBlock();
-    void                            ParseFunctionParameters(AST::Function& Function);
-    std::unique_ptr<AST::Statement> ParseFunction(const AttributeInfo& Attribs);
-    std::unique_ptr<AST::Statement> ParseReturn();
-    std::unique_ptr<AST::Statement> ParseConstVal();
-    std::unique_ptr<AST::Statement> ParseVar();
-    std::unique_ptr<AST::If>        ParseIf();
-    std::unique_ptr<AST::Statement> ParseExpresionStatement();
-    std::unique_ptr<AST::Statement> ParseStatement();
+    AST::TypeDecl   ParseType();
+
+    AST::Expresion* ParseConstantValue(bool CanAssign, AST::Expresion*);
+    AST::Expresion* ParseIdentifier(bool CanAssign, AST::Expresion*);
+    AST::Expresion* ParseGroup(bool CanAssign, AST::Expresion*);
+    AST::Expresion* ParseCall(bool CanAssign, AST::Expresion* Left);
+    AST::Expresion* ParseDot(bool CanAssign, AST::Expresion* Left);
+    AST::Expresion* ParseUnary(bool CanAssign, AST::Expresion*);
+    AST::Expresion* ParseBinaryOp(bool CanAssign, AST::Expresion* Left);
+    AST::Expresion* ParseArrayList(bool CanAssign, AST::Expresion*);
+    AST::Expresion* ParseArrayAccess(bool CanAssign, AST::Expresion*);
+    AST::Expresion* ParseIncDec(bool CanAssign, AST::Expresion*);
+    AST::Expresion* ParseAssignment(bool CanAssign, AST::Expresion*);
+
+    AST::Expresion* ParseExpresion(ParsePrecedence Precedence);
+    AST::Block*     ParseBlock();
+    void            ParseFunctionParameters(AST::Function& Function);
+    AST::Statement* ParseFunction(const AttributeInfo& Attribs);
+    AST::Statement* ParseReturn();
+    AST::Statement* ParseConstVal();
+    AST::Statement* ParseVar();
+    AST::If*        ParseIf();
+    AST::Statement* ParseWhile();
+    AST::Statement* ParseFor();
+    AST::Statement* ParseStruct();
+    AST::Statement* ParseExpresionStatement();
+    AST::Statement* ParseStatement();
 
     AttributeInfo ParseAttribs();
 
@@ -128,6 +121,10 @@ struct Parser {
     Token Current{};
     Token Next{};
     Lexer SourceLexer;
+    // Arena of the program being parsed
+    AST::Arena* Nodes = nullptr;
+    // Hash of the consumed tokens, see AST::Program::DeclarationHash
+    UInt64 TokenHash = HashSeed;
 
     bool IsPanicMode = false;
     bool MustSyncronize = false;
@@ -0,0 +1,126 @@
+#include "jkc/Server/LocalSocket.h"
+#include "jkr/Vector.h"
+#include <WinSock2.h>
+#include <afunix.h>
+#include <Windows.h>
+#include <mutex>
+#include <string.h>
+
+#pragma comment(lib, "Ws2_32.lib")
+#pragma comment(lib, "Advapi32.lib")
+
+static bool MakeAddress(Str Path, sockaddr_un& Address) {
+    static std::once_flag started;
+    std::call_once(started, []() {
+        WSADATA data;
+        (void)WSAStartup(MAKEWORD(2, 2), &data);
+    });
+
+    USize length = strlen((const char*)Path);
+    if (length >= sizeof(Address.sun_path)) {
+        return false;
+    }
+
+    Address = {};
+    Address.sun_family = AF_UNIX;
+    memcpy(Address.sun_path, Path, length + 1);
+    return true;
+}
+
+LocalSocket::~LocalSocket() {
+    if (Handle) {
+        closesocket(SOCKET(Handle - 1));
+    }
+}
+
+bool LocalSocket::Listen(Str Path) {
+    sockaddr_un address;
+    if (!MakeAddress(Path, address)) {
+        return false;
+    }
+
+    SOCKET s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) {
+        return false;
+    }
+    Handle = IntPtr(s) + 1;
+
+    DeleteFileA(address.sun_path);
+    return bind(s, (sockaddr*)&address, sizeof(address)) == 0 && listen(s, SOMAXCONN) == 0;
+}
+
+bool LocalSocket::Connect(Str Path) {
+    sockaddr_un address;
+    if (!MakeAddress(Path, address)) {
+        return false;
+    }
+
+    SOCKET s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) {
+        return false;
+    }
+    Handle = IntPtr(s) + 1;
+
+    return connect(s, (sockaddr*)&address, sizeof(address)) == 0;
+}
+
+LocalSocket LocalSocket::Accept() {
+    SOCKET s = accept(SOCKET(Handle - 1), nullptr, nullptr);
+    return LocalSocket(s == INVALID_SOCKET ? 0 : IntPtr(s) + 1);
+}
+
+bool LocalSocket::Send(const void* Data, USize Size) {
+    const char* bytes = (const char*)Data;
+    while (Size) {
+        int sent = send(SOCKET(Handle - 1), bytes, int(Size > 0x4000'0000 ? 0x4000'0000 : Size), 0);
+        if (sent <= 0) {
+            return false;
+        }
+
+        bytes += sent;
+        Size -= USize(sent);
+    }
+
+    return true;
+}
+
+USize LocalSocket::Receive(void* Data, USize Size) {
+    int received = recv(SOCKET(Handle - 1), (char*)Data, int(Size > 0x4000'0000 ? 0x4000'0000 : Size), 0);
+    return received < 0 ? 0 : USize(received);
+}
+
+// Reads the user of the token of the process, the buffer holds a TOKEN_USER
+static bool GetProcessUser(HANDLE Process, Vector<Byte>& User) {
+    HANDLE token = nullptr;
+    if (!OpenProcessToken(Process, TOKEN_QUERY, &token)) {
+        return false;
+    }
+
+    DWORD size = 0;
+    (void)GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+    User.resize(size);
+    bool success = size && GetTokenInformation(token, TokenUser, User.data(), size, &size);
+    CloseHandle(token);
+    return success;
+}
+
+bool LocalSocket::PeerIsOwner() {
+    ULONG pid = 0;
+    DWORD returned = 0;
+    if (WSAIoctl(SOCKET(Handle - 1), SIO_AF_UNIX_GETPEERPID, nullptr, 0, &pid, sizeof(pid), &returned, nullptr, nullptr) != 0) {
+        return false;
+    }
+
+    // The processes of other users usually can't be opened, the users are compared anyway
+    HANDLE peer = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!peer) {
+        return false;
+    }
+
+    Vector<Byte> peerUser = {};
+    Vector<Byte> user = {};
+    bool same = GetProcessUser(peer, peerUser) && GetProcessUser(GetCurrentProcess(), user) &&
+        EqualSid(reinterpret_cast<TOKEN_USER*>(peerUser.data())->User.Sid, reinterpret_cast<TOKEN_USER*>(user.data())->User.Sid);
+    CloseHandle(peer);
+    return same;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <jkr/CoreTypes.h>
+
+// Stream socket bound to a path of the file system
+struct LocalSocket {
+    // The descriptor is stored biased by one, zero means not opened
+    IntPtr Handle = 0;
+
+    LocalSocket() {}
+    explicit LocalSocket(IntPtr Handle) : Handle(Handle) {}
+    ~LocalSocket();
+
+    LocalSocket(const LocalSocket&) = delete;
+    LocalSocket& operator=(const LocalSocket&) = delete;
+
+    LocalSocket(LocalSocket&& Other) : Handle(Other.Handle) {
+        Other.Handle = 0;
+    }
+
+    // Creates the socket at Path, a previous socket at Path is replaced
+    bool Listen(Str Path);
+    bool Connect(Str Path);
+    // Waits for the next client
+    LocalSocket Accept();
+
+    bool Send(const void* Data, USize Size);
+    // Returns the count of received bytes, 0 at the end of the stream or on error
+    USize Receive(void* Data, USize Size);
+
+    // Checks that the process at the other end runs as the user of this process,
+    // the socket file can be reached by any user
+    bool PeerIsOwner();
+
+    constexpr bool IsOpen() const { return Handle != 0; }
+};
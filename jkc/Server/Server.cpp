@@ -0,0 +1,341 @@
+#include "jkc/Server/Server.h"
+#include "jkc/Server/LocalSocket.h"
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <stdlib.h>
+
+// Time between the checks of the sources of the last build
+static constexpr auto WatchInterval = std::chrono::milliseconds(500);
+
+// A message is his size followed by the bytes,
+// a request has the arguments and a reply the status and the diagnostics
+static bool SendMessage(LocalSocket& Socket, const std::string& Message) {
+    UInt32 size = UInt32(Message.size());
+    return Socket.Send(&size, sizeof(size)) && Socket.Send(Message.data(), Message.size());
+}
+
+static bool ReceiveBytes(LocalSocket& Socket, void* Data, USize Size) {
+    Byte* bytes = (Byte*)Data;
+    while (Size) {
+        USize received = Socket.Receive(bytes, Size);
+        if (received == 0) {
+            return false;
+        }
+
+        bytes += received;
+        Size -= received;
+    }
+
+    return true;
+}
+
+static bool ReceiveMessage(LocalSocket& Socket, std::string& Message) {
+    UInt32 size = 0;
+    if (!ReceiveBytes(Socket, &size, sizeof(size))) {
+        return false;
+    }
+
+    Message.resize(size);
+    return ReceiveBytes(Socket, Message.data(), size);
+}
+
+void BuildArguments::Parse(const Vector<std::string>& Arguments) {
+    for (USize i = 0; i < Arguments.size(); i++) {
+        bool hasNext = i + 1 < Arguments.size();
+
+        if (Arguments[i] == "-O0") {
+            OptimizationLevel = CodeGen::OPTIMIZATION_NONE;
+        }
+        else if (Arguments[i] == "-j" && hasNext) {
+            Jobs = UInt32(atoi(Arguments[++i].c_str()));
+        }
+        else if (Arguments[i] == "-cache" && hasNext) {
+            CacheDirectory = Arguments[++i];
+        }
+        else if (Arguments[i] == "-inline" && hasNext) {
+            InlineThreshold = UInt32(atoi(Arguments[++i].c_str()));
+        }
+        else if (Arguments[i] == "-profile" && hasNext) {
+            ProfilePath = Arguments[++i];
+        }
+        else if (Arguments[i] == "-lib" && hasNext) {
+            Files.emplace_back(Arguments[++i]);
+            FileTypes.emplace_back(CodeGen::FileType::Library);
+        }
+        else if (Arguments[i] == "-shutdown") {
+            Shutdown = true;
+        }
+        else {
+            Files.emplace_back(Arguments[i]);
+            FileTypes.emplace_back(CodeGen::FileType::Executable);
+        }
+    }
+}
+
+Vector<std::string> BuildArguments::ToArguments() const {
+    Vector<std::string> arguments = {};
+    if (Shutdown) {
+        arguments.emplace_back("-shutdown");
+    }
+
+    if (OptimizationLevel == CodeGen::OPTIMIZATION_NONE) {
+        arguments.emplace_back("-O0");
+    }
+
+    if (Jobs) {
+        arguments.emplace_back("-j");
+        arguments.emplace_back(std::to_string(Jobs));
+    }
+
+    if (!CacheDirectory.empty()) {
+        arguments.emplace_back("-cache");
+        arguments.emplace_back(CacheDirectory);
+    }
+
+    if (InlineThreshold != CodeGen::DefaultInlineThreshold) {
+        arguments.emplace_back("-inline");
+        arguments.emplace_back(std::to_string(InlineThreshold));
+    }
+
+    if (!ProfilePath.empty()) {
+        arguments.emplace_back("-profile");
+        arguments.emplace_back(ProfilePath);
+    }
+
+    for (USize i = 0; i < Files.size(); i++) {
+        if (FileTypes[i] == CodeGen::FileType::Library) {
+            arguments.emplace_back("-lib");
+        }
+        arguments.emplace_back(Files[i]);
+    }
+
+    return arguments;
+}
+
+void BuildArguments::MakeAbsolute() {
+    std::error_code error;
+    for (auto& file : Files) {
+        file = std::filesystem::absolute(file, error).string();
+    }
+
+    if (!CacheDirectory.empty()) {
+        CacheDirectory = std::filesystem::absolute(CacheDirectory, error).string();
+    }
+
+    if (!ProfilePath.empty()) {
+        ProfilePath = std::filesystem::absolute(ProfilePath, error).string();
+    }
+}
+
+Vector<SourceModule> BuildArguments::GetModules() const {
+    Vector<SourceModule> modules = {};
+    for (USize i = 0; i < Files.size(); i++) {
+        modules.emplace_back(SourceModule{
+            .FileName = Files[i].c_str(),
+            .FileTy = FileTypes[i],
+        });
+    }
+
+    return modules;
+}
+
+CodeGen::EmitOptions BuildArguments::GetOptions() const {
+    return CodeGen::EmitOptions{
+        .Debug = CodeGen::DBG_NORMAL,
+        .OptimizationLevel = OptimizationLevel,
+        .CacheDirectory = CacheDirectory.empty() ? nullptr : CacheDirectory.c_str(),
+        .InlineThreshold = InlineThreshold,
+        .ProfilePath = ProfilePath.empty() ? nullptr : ProfilePath.c_str(),
+    };
+}
+
+// The state shared by the threads of the server
+struct ServerState {
+    std::string SocketPath;
+    FILE* ErrorStream;
+    Compiler Builder;
+    // The compiler keeps the modules between the builds, only one runs at a time
+    std::mutex BuildMutex;
+
+    std::mutex Mutex;
+    std::condition_variable Changed;
+    // The last build of a client and the write times of its sources
+    BuildArguments Watched = {};
+    Vector<std::filesystem::file_time_type> WriteTimes = {};
+    UInt32 Clients = 0;
+    bool Stopping = false;
+};
+
+static Vector<std::filesystem::file_time_type> GetWriteTimes(const BuildArguments& Build) {
+    Vector<std::filesystem::file_time_type> times = {};
+    for (auto& file : Build.Files) {
+        std::error_code error;
+        times.emplace_back(std::filesystem::last_write_time(file, error));
+    }
+
+    return times;
+}
+
+// Returns the status of the build, the diagnostics are written to Errors
+static bool RunBuild(ServerState& State, const BuildArguments& Build, FILE* Errors) {
+    std::lock_guard lock{ State.BuildMutex };
+    State.Builder.ErrorStream = Errors;
+    bool success = State.Builder.CompileModules(Build.GetModules(), Build.GetOptions(), Build.Jobs).Success;
+    State.Builder.ErrorStream = State.ErrorStream;
+    return success;
+}
+
+static void ServeClient(ServerState& State, LocalSocket& Client) {
+    std::string request = {};
+    if (!ReceiveMessage(Client, request)) {
+        return;
+    }
+
+    // The arguments are separated by a '\0'
+    Vector<std::string> arguments = {};
+    for (USize begin = 0; begin < request.size();) {
+        USize end = request.find('\0', begin);
+        if (end == std::string::npos) {
+            end = request.size();
+        }
+
+        arguments.emplace_back(request.substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    BuildArguments build = {};
+    build.Parse(arguments);
+
+    if (build.Shutdown) {
+        {
+            std::lock_guard lock{ State.Mutex };
+            State.Stopping = true;
+        }
+        State.Changed.notify_all();
+        (void)SendMessage(Client, "0");
+
+        // Wakes the accept of the server
+        LocalSocket wake = {};
+        (void)wake.Connect((Str)State.SocketPath.c_str());
+        return;
+    }
+
+    // A source that changes during the build is rebuilt by the watcher
+    auto times = GetWriteTimes(build);
+
+    // The diagnostics are sent to the client
+    FILE* errors = tmpfile();
+    bool success = RunBuild(State, build, errors ? errors : State.ErrorStream);
+
+    {
+        std::lock_guard lock{ State.Mutex };
+        State.WriteTimes = std::move(times);
+        State.Watched = std::move(build);
+    }
+
+    std::string reply = success ? "0" : "1";
+    if (errors) {
+        char buffer[1024];
+        rewind(errors);
+        while (USize size = fread(buffer, 1, sizeof(buffer), errors)) {
+            reply.append(buffer, size);
+        }
+        fclose(errors);
+    }
+
+    (void)SendMessage(Client, reply);
+}
+
+// Rebuilds the last build when one of its sources changes,
+// so the next request of the client only writes the code files
+static void WatchSources(ServerState& State) {
+    std::unique_lock lock{ State.Mutex };
+    while (!State.Changed.wait_for(lock, WatchInterval, [&]() { return State.Stopping; })) {
+        if (State.Watched.Files.empty()) {
+            continue;
+        }
+
+        auto times = GetWriteTimes(State.Watched);
+        if (times == State.WriteTimes) {
+            continue;
+        }
+
+        State.WriteTimes = std::move(times);
+        BuildArguments build = State.Watched;
+
+        lock.unlock();
+        (void)RunBuild(State, build, State.ErrorStream);
+        lock.lock();
+    }
+}
+
+int RunServer(Str SocketPath, FILE* ErrorStream) {
+    LocalSocket server = {};
+    if (!server.Listen(SocketPath)) {
+        fprintf(ErrorStream, "Error: can't listen in '%s'\n", (const char*)SocketPath);
+        return -1;
+    }
+
+    ServerState state = {
+        .SocketPath = (const char*)SocketPath,
+        .ErrorStream = ErrorStream,
+        .Builder = Compiler(ErrorStream, ProfileData{}),
+    };
+
+    std::thread watcher = std::thread(WatchSources, std::ref(state));
+
+    // Each client is served in its own thread, a slow client doesn't stop the others
+    while (true) {
+        LocalSocket client = server.Accept();
+        std::lock_guard lock{ state.Mutex };
+        if (state.Stopping) {
+            break;
+        }
+        // The processes of other users could stop the server or write files with the rights of its owner
+        if (!client.IsOpen() || !client.PeerIsOwner()) {
+            continue;
+        }
+
+        state.Clients++;
+        std::thread([&state, client = std::move(client)]() mutable {
+            ServeClient(state, client);
+
+            std::lock_guard lock{ state.Mutex };
+            state.Clients--;
+            state.Changed.notify_all();
+        }).detach();
+    }
+
+    watcher.join();
+    {
+        std::unique_lock lock{ state.Mutex };
+        state.Changed.wait(lock, [&]() { return state.Clients == 0; });
+    }
+
+    return 0;
+}
+
+int RunClient(Str SocketPath, const BuildArguments& Arguments, FILE* ErrorStream) {
+    LocalSocket socket = {};
+    if (!socket.Connect(SocketPath)) {
+        fprintf(ErrorStream, "Error: can't connect to '%s'\n", (const char*)SocketPath);
+        return -1;
+    }
+
+    std::string request = {};
+    for (auto& argument : Arguments.ToArguments()) {
+        request += argument;
+        request += '\0';
+    }
+
+    std::string reply = {};
+    if (!SendMessage(socket, request) || !ReceiveMessage(socket, reply) || reply.empty()) {
+        fprintf(ErrorStream, "Error: the server closed the connection\n");
+        return -1;
+    }
+
+    fwrite(reply.data() + 1, 1, reply.size() - 1, ErrorStream);
+    return reply[0] == '0' ? 0 : -1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "jkc/Compiler.h"
+#include <string>
+
+// Arguments of a build: [-O0] [-j Jobs] [-cache Directory] [-inline Threshold] [-profile File] [-lib File]... File...
+// -shutdown stops the server that receives it
+struct BuildArguments {
+    Vector<std::string> Files = {};
+    Vector<CodeGen::FileType> FileTypes = {};
+    std::string CacheDirectory = {};
+    std::string ProfilePath = {};
+    UInt32 Jobs = 0;
+    UInt32 InlineThreshold = CodeGen::DefaultInlineThreshold;
+    CodeGen::Optimization OptimizationLevel = CodeGen::OPTIMIZATION_RELEASE_FAST;
+    bool Shutdown = false;
+
+    void Parse(const Vector<std::string>& Arguments);
+    Vector<std::string> ToArguments() const;
+    // The server can run in other directory
+    void MakeAbsolute();
+
+    Vector<SourceModule> GetModules() const;
+    CodeGen::EmitOptions GetOptions() const;
+};
+
+// Builds the requests of the clients with a single compiler, so the modules that don't change
+// are never parsed or emitted again. The sources of the last build are watched and rebuilt when
+// they change. Only the processes of the user that runs the server are served
+int RunServer(Str SocketPath, FILE* ErrorStream);
+// Sends the build to the server and prints his diagnostics
+int RunClient(Str SocketPath, const BuildArguments& Arguments, FILE* ErrorStream);
@@ -9,6 +9,8 @@ enum FunctionFlags : UInt16 {
     FunctionExport = 0x02,
     FunctionNative = 0x04,
     FunctionDebugInfo = 0x08,
+    // The code has backward jumps, the back edges of its loops
+    FunctionLoops = 0x10,
 };
 
 constexpr Byte MaxArguments = 32;
@@ -22,9 +24,17 @@ struct FunctionHeader {
 
     // If has the Native flag
     // SizeOfCode is a index in string table: Library
+    // If has the Import flag
+    // SizeOfCode is a index in the imports section
     UInt32 SizeOfCode;
 };
 
+// Entry of the functions section
+struct FunctionEntry : FunctionHeader {
+    // Offset from the start of the code section
+    UInt32 CodeOffset;
+};
+
 struct FunctionDebugInfo {
     UInt32 Name; // Index in string table
 };
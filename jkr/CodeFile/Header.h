@@ -1,5 +1,6 @@
 #pragma once
 #include "jkr/CoreTypes.h"
+#include "jkr/Align.h"
 
 namespace codefile {
 
@@ -10,6 +11,42 @@ static constexpr Char Signature[] = {
     'L',
 };
 
+// Version written by the compiler and accepted by the runtime
+static constexpr UInt16 CurrentMajorVersion = 6;
+static constexpr UInt16 CurrentMinorVersion = 0;
+
+// Every section and every function code starts aligned to this
+static constexpr USize SectionAlignment = 8;
+// Every string of the strings section starts aligned to this
+static constexpr USize StringAlignment = 4;
+
+// Version 6 layout, a runtime only reads the files of its own major version:
+//  FileHeader
+//  SectionHeader[SectionCount]
+//  Data section: DataHeader followed by the value, for each global
+//  Functions section: FunctionEntry[FunctionSize]
+//  Code section: The code of the functions, referenced by FunctionEntry::CodeOffset
+//  Strings section: UInt32 size followed by the bytes and a null terminator, for each unique string
+//  Exports section: ExportEntry[], only in libraries
+//  Imports section: ImportEntry[]
+//  Sites section: SiteEntry[], the conditions and calls of the source in the code
+// The changes of each major version:
+//  2: The sections and the functions materialized on the first call
+//  3: The strings are unique and aligned to StringAlignment
+//  4: The exports and imports sections
+//  5: The 8 and 32 bits jumps, the displacements of the jumps are signed
+//  6: The sites section, the profile is counted by site of the source
+enum SectionKind : UInt32 {
+    SectionData = 0,
+    SectionFunctions = 1,
+    SectionCode = 2,
+    SectionStrings = 3,
+    SectionExports = 4,
+    SectionImports = 5,
+    SectionSites = 6,
+    SectionCount,
+};
+
 enum FileType : Byte {
     Executable = 0,
     Library = 1,
@@ -38,4 +75,13 @@ struct FileHeader {
     UInt32 EntryPoint;
 };
 
+struct SectionHeader {
+    // Offset from the start of the file
+    UInt32 Offset;
+    UInt32 Size;
+};
+
+// The section directory is placed after the header
+static constexpr USize SectionDirectoryOffset = Align(sizeof(FileHeader), SectionAlignment);
+
 }
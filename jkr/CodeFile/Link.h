@@ -0,0 +1,36 @@
+#pragma once
+#include "jkr/CoreTypes.h"
+
+namespace codefile {
+
+// FNV-1a hash of a exported name
+constexpr UInt32 HashName(const Char* Name, USize Size) {
+    UInt32 hash = 0x811C9DC5;
+    for (USize i = 0; i < Size; i++) {
+        hash ^= Byte(Name[i]);
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+// Entry of the exports section, the entries are sorted by hash
+struct ExportEntry {
+    UInt32 Hash;
+    // Index in string table
+    UInt32 Name;
+    // Index in the functions section
+    UInt32 Function;
+};
+
+// Entry of the imports section,
+// referenced by the SizeOfCode of a function with the FunctionImport flag
+struct ImportEntry {
+    UInt32 Hash;
+    // Index in string table
+    UInt32 Name;
+    // Index in string table: Path of the library code file
+    UInt32 Library;
+};
+
+}
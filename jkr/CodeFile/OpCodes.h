@@ -9,6 +9,7 @@ namespace codefile {
 
 constexpr auto MaxLocals = 0xFF;
 constexpr auto MaxFields = 0xFF;
+constexpr auto MaxObjectSize = 0xFFFF;
 constexpr auto MaxFunctions = 0xFFFF'FFFF;
 constexpr auto MaxObjects = 0xFFFF'FFFF;
 constexpr auto MaxGlobals = 0xFFFF;
@@ -129,6 +130,19 @@ enum AddressingMode {
 // Array Destroy Layout
 // Src array register [8-11]/4 bits
 
+// Object New Layout
+// Dest register [8-11]/4 bits
+// Size of the object in bytes [16-31]/16 bits
+
+// Object Destroy Layout
+// Src object register [8-11]/4 bits
+
+// Load/Store Field Layout
+// Dest/Src register [8-11]/4 bits
+// Object register [12-15]/4 bits
+// Field Element [16-23]/8 bits
+// Offset in bytes [24-39]/16 bits
+
 enum class OpCode {
     Brk = 0,
 
@@ -148,6 +162,8 @@ enum class OpCode {
     Cmp,
     FCmp,
     TestZ,
+    // The displacement of the jumps is signed and relative to the next instruction,
+    // the near form has 16 bits
     Jmp,
     Je,
     Jne,
@@ -155,6 +171,22 @@ enum class OpCode {
     Jle,
     Jg,
     Jge,
+    // Short form, 8 bits
+    Jmp8,
+    Je8,
+    Jne8,
+    Jl8,
+    Jle8,
+    Jg8,
+    Jge8,
+    // Long form, 32 bits
+    Jmp32,
+    Je32,
+    Jne32,
+    Jl32,
+    Jle32,
+    Jg32,
+    Jge32,
 
     Call,
     Calla,
@@ -239,6 +271,83 @@ enum class OpCode {
     // Object
     ObjectNew,
     ObjectDestroy,
+    LoadField,
+    StoreField,
 };
 
+// Size in bytes of each instruction including the opcode,
+// 0 for the opcodes that the virtual machine doesn't implement
+constexpr Byte InstructionSizes[] = {
+    1, // Brk
+
+    2, 2, 3, 4, 6, 10, // Mov, Mov4, Mov8, Mov16, Mov32, Mov64
+    6, 4, 4, // Ldstr, Ldr, Str
+
+    2, 2, 2, // Cmp, FCmp, TestZ
+    3, 3, 3, 3, 3, 3, 3, // Jmp, Je, Jne, Jl, Jle, Jg, Jge
+    2, 2, 2, 2, 2, 2, 2, // Jmp8...Jge8
+    5, 5, 5, 5, 5, 5, 5, // Jmp32...Jge32
+
+    5, 0, 1, 5, // Call, Calla, Ret, RetC
+
+    2, 2, 2, 2, 2, 2, // Inc, IInc, FInc, Dec, IDec, FDec
+
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, // Add...FDiv
+    3, 3, 3, 3, 3, 3, 3, 3, // Add8...IDiv8
+    4, 4, 4, 4, 4, 4, 4, 4, // Add16...IDiv16
+
+    3, 3, 3, 3, 3, // Or, And, XOr, Shl, Shr
+    2, 2, // Not, Neg
+    3, 3, 3, 3, 3, // Or8, And8, XOr8, Shl8, Shr8
+    4, 4, 4, // Or16, And16, XOr16
+
+    2, 3, 5, 9, 1, // Push8, Push16, Push32, Push64, Popd
+    2, 2, // Push, Pop
+
+    2, 2, 3, 3, 2, // ArrayNew, ArrayL, ArrayLoad, ArrayStore, ArrayDestroy
+
+    4, 2, 5, 5, // ObjectNew, ObjectDestroy, LoadField, StoreField
+};
+
+constexpr USize OpCodeCount = sizeof(InstructionSizes);
+static_assert(OpCodeCount == USize(OpCode::StoreField) + 1, "A instruction size is missing");
+
+enum class JumpForm : Byte {
+    Short,
+    Near,
+    Long,
+};
+
+constexpr Byte CountOfJumpConditions = Byte(OpCode::Jge) - Byte(OpCode::Jmp) + 1;
+
+[[nodiscard]] constexpr bool IsJump(OpCode Op) {
+    return Op >= OpCode::Jmp && Op <= OpCode::Jge32;
+}
+
+// The near form of a jump, which names its condition
+[[nodiscard]] constexpr OpCode GetNearJump(OpCode Op) {
+    return OpCode(Byte(OpCode::Jmp) + (Byte(Op) - Byte(OpCode::Jmp)) % CountOfJumpConditions);
+}
+
+// The near form of the conditional jump taken when Op isn't
+[[nodiscard]] constexpr OpCode GetNegatedJump(OpCode Op) {
+    switch (GetNearJump(Op)) {
+    case OpCode::Je: return OpCode::Jne;
+    case OpCode::Jne: return OpCode::Je;
+    case OpCode::Jl: return OpCode::Jge;
+    case OpCode::Jle: return OpCode::Jg;
+    case OpCode::Jg: return OpCode::Jle;
+    default: return OpCode::Jl;
+    }
+}
+
+[[nodiscard]] constexpr OpCode GetJumpForm(OpCode Op, JumpForm Form) {
+    Byte condition = Byte(GetNearJump(Op)) - Byte(OpCode::Jmp);
+    switch (Form) {
+    case JumpForm::Short: return OpCode(Byte(OpCode::Jmp8) + condition);
+    case JumpForm::Long: return OpCode(Byte(OpCode::Jmp32) + condition);
+    default: return OpCode(Byte(OpCode::Jmp) + condition);
+    }
+}
+
 }
@@ -0,0 +1,44 @@
+#pragma once
+#include "jkr/CoreTypes.h"
+
+namespace codefile {
+
+// Profile of a execution, written by the virtual machine and read by the
+// compiler to optimize the next build of the same module.
+// The counts are by site of the source: a condition or a call numbered in the
+// order the compiler builds its function, keyed by the name and the body of the
+// function. The sites section of the code file maps the code to them, so the
+// compiler looks the counts up while it emits the function again
+//
+// Layout, little endian:
+//  Magic, Version, CountOfSites
+//  For each site of the functions called, sorted by Key and Site:
+//   Key, Site, Counts[2]
+// The site 0 is the function itself, counted by its calls. A condition counts
+// the times it was true and false, a call the times it was made
+static constexpr UInt32 ProfileMagic = 0x4650'4B4A; // JKPF
+static constexpr UInt32 ProfileVersion = 2;
+
+enum SiteKind : UInt32 {
+    SiteFunction = 0,
+    SiteCall = 1,
+    // A conditional jump taken when the condition is true
+    SiteBranch = 2,
+    // A conditional jump taken when the condition is false
+    SiteNegatedBranch = 3,
+};
+
+// Entry of the sites section, the entries are sorted by function and by offset
+struct SiteEntry {
+    // Key of the function of the source, a inlined site keeps the one of its callee
+    UInt64 Key;
+    // Index in the functions section of the function with the code
+    UInt32 Function;
+    // Offset of the jump or the call from the start of the code of the function
+    UInt32 Offset;
+    // Ordinal of the site in the function of the source
+    UInt32 Site;
+    UInt32 Kind;
+};
+
+}
@@ -11,9 +11,10 @@
     __pragma(pack(pop))
 
 #if defined(_MSC_VER)
-    #define UNREACHABLE() __assume(true)
+    #define UNREACHABLE() __assume(0)
     #define Break() __debugbreak()
 #else
-    #define UNREACHABLE
+    #define UNREACHABLE() __builtin_unreachable()
+    #define Break() __builtin_trap()
 #endif // _MSC_VER
 
@@ -46,6 +46,9 @@ JK_API JKResult jkrVMLink(JKVirtualMachine VM) {
         if (vm->Err == runtime::VMLinkageError) {
             return JK_VM_LINKAGE_ERROR;
         }
+        else if (vm->Err == runtime::VMCorruptAssembly) {
+            return JK_CORRUPT_ASM;
+        }
     }
 
     return JK_OK;
@@ -58,6 +61,12 @@ extern "C" JK_API JKResult jkrVMExecuteMain(JKVirtualMachine VM, JKInt* ExitValu
         if (vm->Err == runtime::VMLinkageError) {
             return JK_VM_LINKAGE_ERROR;
         }
+        else if (vm->Err == runtime::VMCorruptAssembly) {
+            return JK_CORRUPT_ASM;
+        }
+        else if (vm->Err == runtime::VMStackOverflow) {
+            return JK_VM_STACK_OVERFLOW;
+        }
     }
 
     return JK_OK;
@@ -68,6 +77,20 @@ extern "C" JK_API void jkrDestroyVM(JKVirtualMachine VM) {
     delete vm;
 }
 
+extern "C" JK_API void jkrVMEnableProfile(JKVirtualMachine VM) {
+    runtime::VirtualMachine* vm = reinterpret_cast<runtime::VirtualMachine*>(VM);
+    vm->EnableProfile();
+}
+
+extern "C" JK_API JKResult jkrVMWriteProfile(JKVirtualMachine VM, JKString Path) {
+    runtime::VirtualMachine* vm = reinterpret_cast<runtime::VirtualMachine*>(VM);
+    if (!vm->Asm || !vm->WriteProfile(Str(Path))) {
+        return JK_VM_PROFILE_ERROR;
+    }
+
+    return JK_OK;
+}
+
 extern "C" JK_API JKResult jkrCreateObject(JKUInt ObjectType, JKObject* pObject) {
     return JKResult();
 }
@@ -37,6 +37,7 @@ typedef enum {
     
     JK_VM_LINKAGE_ERROR,
     JK_VM_STACK_OVERFLOW,
+    JK_VM_PROFILE_ERROR,
 
 } JKResult;
 
@@ -58,6 +59,14 @@ JK_API JKResult jkrVMExecuteMain(JKVirtualMachine VM, JKInt* ExitValue);
 
 JK_API void jkrDestroyVM(JKVirtualMachine VM);
 
+// Profile
+
+// The next executions of the VM are profiled, it makes them slower
+JK_API void jkrVMEnableProfile(JKVirtualMachine VM);
+
+// Writes the profile of the last execution, the compiler reads it with -profile
+JK_API JKResult jkrVMWriteProfile(JKVirtualMachine VM, JKString Path);
+
 // Runtime
 
 JK_API JKResult jkrCreateObject(JKUInt ObjectType, JKObject* pObject);
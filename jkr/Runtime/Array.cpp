@@ -25,8 +25,15 @@ Array::Array(USize Size, codefile::ArrayElement ElementType) :
     Bytes = new Byte[Size * ElementSize]{};
 }
 
+Array::Array(const Byte* Data, USize Size, codefile::ArrayElement ElementType) :
+    Size(Size), ElementSize(ElementToSize(ElementType)), ElementType(ElementType), IsView(true) {
+    Bytes = const_cast<Byte*>(Data);
+}
+
 Array::~Array() {
-    delete[] Bytes;
+    if (!IsView) {
+        delete[] Bytes;
+    }
 }
 
 }
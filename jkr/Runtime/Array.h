@@ -16,7 +16,12 @@ struct Array {
         Float* Floats;
     };
 
+    // Set when Bytes points to memory owned by someone else
+    bool IsView = false;
+
     Array(USize Size, codefile::ArrayElement ElementType);
+    // Makes a view over Data, the memory isn't released by the array
+    Array(const Byte* Data, USize Size, codefile::ArrayElement ElementType);
     ~Array();
 
     Array(Array&&) = default;
@@ -1,92 +1,351 @@
 #include "jkr/Runtime/Assembly.h"
+#include "jkr/Runtime/Verifier.h"
 #include <jkr/CodeFile/Type.h>
-#include <fstream>
+#include <jkr/Align.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
 
 namespace runtime {
 
-Assembly::Assembly(Str FilePath) {
+// Bounds checked cursor over the mapping
+struct Reader {
+    const Byte* Current;
+    const Byte* End;
+
+    constexpr bool Has(USize Size) const { return USize(End - Current) >= Size; }
+
+    template<typename T>
+    bool Read(T& Dest, USize Size = sizeof(T)) {
+        if (!Has(Size)) return false;
+        memcpy(&Dest, Current, Size);
+        Current += Size;
+        return true;
+    }
+
+    bool AlignTo(const Byte* Base, USize Alignment) {
+        return Take(Align(USize(Current - Base), Alignment) - USize(Current - Base)) != nullptr;
+    }
+
+    const Byte* Take(USize Size) {
+        if (!Has(Size)) return nullptr;
+        const Byte* data = Current;
+        Current += Size;
+        return data;
+    }
+};
+
+// The names of the libraries and the symbols are given to the system as C strings,
+// the size of a string includes its null terminator
+static bool IsName(const Array& String) {
+    return String.Size > 1
+        && String.Bytes[String.Size - 1] == 0
+        && memchr(String.Bytes, 0, String.Size - 1) == nullptr;
+}
+
+Assembly::Assembly(Str FilePath) :
+    Mapping(FilePath) {
     this->FilePath = FilePath;
 
-    std::ifstream file{ (const char*)FilePath, std::ios::ate | std::ios::binary };
-    if (!file.is_open()) {
+    if (!Mapping.IsOpen()) {
         Err = AsmNotExists;
         return;
     }
 
-    USize size = file.tellg();
-    file.seekg(0);
-    if (size < sizeof(codefile::FileHeader)) {
+    if (Mapping.Size < sizeof(codefile::FileHeader)) {
         Err = AsmBadFile;
-        file.close();
         return;
     }
 
-    file.read(reinterpret_cast<char*>(this), sizeof(codefile::FileHeader));
-    if (size != this->CheckSize) {
+    Reader reader = {
+        .Current = Mapping.Data,
+        .End = Mapping.Data + Mapping.Size,
+    };
+
+    reader.Read(static_cast<codefile::FileHeader&>(*this));
+    if (Mapping.Size != this->CheckSize) {
         Err = AsmCorruptFile;
-        file.close();
         return;
     }
 
     UInt32& sig = *(UInt32*)codefile::Signature;
     if (this->Signature != sig) {
         Err = AsmCorruptFile;
-        file.close();
         return;
     }
 
-    if (this->DataSize) {
-        CodeSection.reserve(this->DataSize);
-        for (UInt32 i = 0; i < this->DataSize; i++) {
-            auto& element = DataSection.emplace_back();
-            file.read((char*)&element, sizeof(codefile::DataHeader));
-            if (element.Primitive == codefile::PrimitiveByte) {
-                file.read((char*)&element.Value.Unsigned, 1);
-            }
-            else if (element.Primitive >= codefile::PrimitiveInt && element.Primitive <= codefile::PrimitiveFloat) {
-                file.read((char*)&element.Value.Unsigned, 8);
-            }
+    if (this->MajorVersion != codefile::CurrentMajorVersion) {
+        Err = AsmBadFile;
+        return;
+    }
+
+    if (this->FunctionSize && EntryPoint >= this->FunctionSize) {
+        Err = AsmBadFile;
+        return;
+    }
+
+    reader.Current = Mapping.Data + codefile::SectionDirectoryOffset;
+    if (!reader.Read(Sections)) {
+        Err = AsmCorruptFile;
+        return;
+    }
+
+    for (auto& section : Sections) {
+        if (section.Offset % codefile::SectionAlignment != 0
+            || USize(section.Offset) + section.Size > Mapping.Size) {
+            Err = AsmCorruptFile;
+            return;
         }
     }
 
-    if (this->FunctionSize) {
-        CodeSection.reserve(this->FunctionSize);
-        if (EntryPoint >= this->FunctionSize) {
-            Err = AsmBadFile;
-            file.close();
+    auto& functions = Sections[codefile::SectionFunctions];
+    if (functions.Size != USize(this->FunctionSize) * sizeof(codefile::FunctionEntry)) {
+        Err = AsmCorruptFile;
+        return;
+    }
+
+    // The functions are only materialized on the first use
+    FunctionTable = reinterpret_cast<const codefile::FunctionEntry*>(Mapping.Data + functions.Offset);
+    CodeSection.resize(this->FunctionSize);
+
+    auto& exports = Sections[codefile::SectionExports];
+    auto& imports = Sections[codefile::SectionImports];
+    auto& sites = Sections[codefile::SectionSites];
+    if (exports.Size % sizeof(codefile::ExportEntry) != 0 || imports.Size % sizeof(codefile::ImportEntry) != 0
+        || sites.Size % sizeof(codefile::SiteEntry) != 0) {
+        Err = AsmCorruptFile;
+        return;
+    }
+
+    ExportTable = reinterpret_cast<const codefile::ExportEntry*>(Mapping.Data + exports.Offset);
+    ImportTable = reinterpret_cast<const codefile::ImportEntry*>(Mapping.Data + imports.Offset);
+    SiteTable = reinterpret_cast<const codefile::SiteEntry*>(Mapping.Data + sites.Offset);
+    ExportSize = UInt32(exports.Size / sizeof(codefile::ExportEntry));
+    ImportSize = UInt32(imports.Size / sizeof(codefile::ImportEntry));
+    SiteSize = UInt32(sites.Size / sizeof(codefile::SiteEntry));
+
+    auto sectionReader = [&](codefile::SectionKind Kind) {
+        return Reader{
+            .Current = Mapping.Data + Sections[Kind].Offset,
+            .End = Mapping.Data + Sections[Kind].Offset + Sections[Kind].Size,
+        };
+    };
+
+    DataSection.reserve(this->DataSize);
+    STSection.reserve(this->StringsSize);
+
+    reader = sectionReader(codefile::SectionData);
+    for (UInt32 i = 0; i < this->DataSize; i++) {
+        auto& element = DataSection.emplace_back();
+        if (!reader.Read(static_cast<codefile::DataHeader&>(element))) {
+            Err = AsmCorruptFile;
             return;
         }
 
-        for (UInt32 i = 0; i < this->FunctionSize; i++) {
-            auto& fn = CodeSection.emplace_back();
-            file.read((char*)&fn, sizeof(codefile::FunctionHeader));
-            fn.Asm = this;
-            if (fn.Flags & codefile::FunctionNative) {
-                continue;
-            }
+        bool read = true;
+        if (element.Primitive == codefile::PrimitiveByte) {
+            read = reader.Read(element.Value.Unsigned, 1);
+        }
+        else if (element.Primitive >= codefile::PrimitiveInt && element.Primitive <= codefile::PrimitiveFloat) {
+            read = reader.Read(element.Value.Unsigned, 8);
+        }
 
-            fn.Code.resize(fn.SizeOfCode);
-            file.read((char*)fn.Code.data(), fn.SizeOfCode);
+        if (!read) {
+            Err = AsmCorruptFile;
+            return;
+        }
+    }
+
+    // The strings are views into the strings section
+    reader = sectionReader(codefile::SectionStrings);
+    const Byte* strings = reader.Current;
+    for (UInt32 i = 0; i < this->StringsSize; i++) {
+        UInt32 sizeStr = 0;
+        const Byte* data = nullptr;
+        if (!reader.AlignTo(strings, codefile::StringAlignment)
+            || !reader.Read(sizeStr)
+            || !(data = reader.Take(sizeStr))) {
+            Err = AsmCorruptFile;
+            return;
         }
+
+        STSection.emplace_back(data, sizeStr, codefile::AE_1B);
     }
 
-    if (this->StringsSize) {
-        STSection.reserve(this->StringsSize);
-        for (UInt32 i = 0; i < this->StringsSize; i++) {
-            UInt16 sizeStr = 0;
-            file.read((char*)&sizeStr, UInt16(2));
+    for (UInt32 i = 0; i < ExportSize; i++) {
+        if (ExportTable[i].Name >= this->StringsSize || ExportTable[i].Function >= this->FunctionSize) {
+            Err = AsmCorruptFile;
+            return;
+        }
+    }
 
-            auto& str = STSection.emplace_back(sizeStr, codefile::AE_1B);
+    for (UInt32 i = 0; i < ImportSize; i++) {
+        if (ImportTable[i].Name >= this->StringsSize || ImportTable[i].Library >= this->StringsSize
+            || !IsName(STSection[ImportTable[i].Name]) || !IsName(STSection[ImportTable[i].Library])) {
+            Err = AsmCorruptFile;
+            return;
+        }
+    }
 
-            file.read((char*)str.Bytes, sizeStr);
-            str.Size = sizeStr;
+    // The offsets are checked against the code when the profile is written
+    for (UInt32 i = 0; i < SiteSize; i++) {
+        if (SiteTable[i].Function >= this->FunctionSize || SiteTable[i].Kind > codefile::SiteNegatedBranch) {
+            Err = AsmCorruptFile;
+            return;
         }
     }
 
     Err = AsmOk;
-    file.close();
 }
 
-Assembly::~Assembly() {}
+Assembly::~Assembly() {
+    for (auto& [_, lib] : Imports) {
+        ReleaseLibrary(lib);
+    }
+
+    for (auto& [_, lib] : Libraries) {
+        Library::Release(lib);
+    }
+}
+
+Function* Assembly::MaterializeFunction(UInt32 Index) {
+    std::lock_guard lock{ LoadMutex };
+    Function& fn = CodeSection[Index];
+    // Other thread could materialize it first
+    if (fn.Loaded) {
+        return &fn;
+    }
+
+    const codefile::FunctionEntry& entry = FunctionTable[Index];
+
+    static_cast<codefile::FunctionHeader&>(fn) = entry;
+    fn.Asm = this;
+
+    if (fn.Flags & codefile::FunctionImport) {
+        // The code is resolved by the linker
+        if (fn.SizeOfCode >= ImportSize) {
+            Err = AsmCorruptFile;
+            return nullptr;
+        }
+        fn.Import = fn.SizeOfCode;
+        fn.SizeOfCode = 0;
+    }
+    else if (fn.Flags & codefile::FunctionNative) {
+        // The native functions references the string table
+        UInt entryAddress = UInt(fn.StackArguments | (fn.LocalReserve << 16));
+        if (fn.SizeOfCode >= this->StringsSize || entryAddress >= this->StringsSize
+            || !IsName(STSection[fn.SizeOfCode]) || !IsName(STSection[entryAddress])) {
+            Err = AsmCorruptFile;
+            return nullptr;
+        }
+    }
+    else {
+        auto& code = Sections[codefile::SectionCode];
+        if (USize(entry.CodeOffset) + fn.SizeOfCode > code.Size) {
+            Err = AsmCorruptFile;
+            return nullptr;
+        }
+
+        fn.Code = Mapping.Data + code.Offset + entry.CodeOffset;
+
+        UInt32 maxDepth = 0;
+        VerifyResult result = Verify(*this, fn, maxDepth);
+        if (result == VerifyCorrupt) {
+            Err = AsmCorruptFile;
+            return nullptr;
+        }
+        fn.Verified = result == VerifyProven;
+        fn.MaxDepth = fn.Verified ? maxDepth : 0;
+    }
+
+    // Published after the rest of the function
+    std::atomic_ref(fn.Loaded).store(true, std::memory_order_release);
+    return &fn;
+}
+
+bool Assembly::BindNative(Function& Fn) {
+    std::lock_guard lock{ BindMutex };
+    // Other thread could bind it first
+    if (std::atomic_ref(Fn.Native).load(std::memory_order_relaxed)) {
+        return true;
+    }
+
+    Library*& lib = Libraries[Fn.SizeOfCode];
+    if (!lib) {
+        // The size includes the null terminator, checked when the function was materialized
+        const Array& libName = STSection[Fn.SizeOfCode];
+        lib = Library::Acquire(StringView(Str(libName.Bytes), libName.Size - 1));
+        if (!lib) {
+            Libraries.erase(Fn.SizeOfCode);
+            return false;
+        }
+    }
+
+    UInt entryAddress = UInt(Fn.StackArguments | (Fn.LocalReserve << 16));
+    auto native = (Value(*)(...))lib->Get(Str(STSection[entryAddress].Bytes));
+    // Published after the library, ProcessCall reads it without the lock
+    std::atomic_ref(Fn.Native).store(native, std::memory_order_release);
+    return native != nullptr;
+}
+
+Function* Assembly::FindExport(UInt32 Hash, const Array& Name) {
+    // The exports are sorted by hash
+    const codefile::ExportEntry* end = ExportTable + ExportSize;
+    const codefile::ExportEntry* entry = std::lower_bound(ExportTable, end, Hash,
+        [](const codefile::ExportEntry& Entry, UInt32 Hash) {
+            return Entry.Hash < Hash;
+        }
+    );
+
+    for (; entry != end && entry->Hash == Hash; entry++) {
+        const Array& exportName = STSection[entry->Name];
+        if (exportName.Size == Name.Size && memcmp(exportName.Bytes, Name.Bytes, Name.Size) == 0) {
+            return LoadFunction(entry->Function);
+        }
+    }
+
+    return nullptr;
+}
+
+static std::mutex LibrariesMutex;
+static std::unordered_map<String, Assembly*> LoadedLibraries;
+
+Assembly* Assembly::AcquireLibrary(Str FilePath) {
+    std::lock_guard lock{ LibrariesMutex };
+
+    auto it = LoadedLibraries.find(FilePath);
+    if (it != LoadedLibraries.end()) {
+        it->second->References++;
+        return it->second;
+    }
+
+    // The key owns the path used by the assembly
+    auto [entry, _] = LoadedLibraries.emplace(FilePath, nullptr);
+    Assembly* lib = new Assembly(entry->first.c_str());
+    if (lib->Err != AsmOk || lib->FileType != codefile::Library) {
+        LoadedLibraries.erase(entry);
+        delete lib;
+        return nullptr;
+    }
+
+    lib->References = 1;
+    entry->second = lib;
+    return lib;
+}
+
+void Assembly::ReleaseLibrary(Assembly* Lib) {
+    {
+        std::lock_guard lock{ LibrariesMutex };
+        if (--Lib->References != 0) {
+            return;
+        }
+
+        LoadedLibraries.erase(Lib->FilePath);
+    }
+
+    // Releases his own imports
+    delete Lib;
+}
 
 }
@@ -1,10 +1,17 @@
 #pragma once
 #include "jkr/CodeFile/Header.h"
+#include "jkr/CodeFile/Link.h"
+#include "jkr/CodeFile/Profile.h"
 #include "jkr/Runtime/Function.h"
 #include "jkr/Runtime/DataElement.h"
 #include "jkr/Runtime/Array.h"
+#include "jkr/Runtime/MappedFile.h"
+#include "jkr/Runtime/Library.h"
 #include "jkr/Vector.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace runtime {
 
@@ -19,12 +26,58 @@ struct [[nodiscard]] Assembly : codefile::FileHeader {
     Assembly(Str FilePath);
     ~Assembly();
 
+    // Returns the function materializing it on the first use,
+    // returns nullptr if the function is corrupt
+    Function* LoadFunction(UInt32 Index) {
+        Function& fn = CodeSection[Index];
+        return std::atomic_ref(fn.Loaded).load(std::memory_order_acquire) ? &fn : MaterializeFunction(Index);
+    }
+
+    // The assembly can be shared by virtual machines in other threads,
+    // only one materializes the function and the others wait for it
+    Function* MaterializeFunction(UInt32 Index);
+
+    // Resolves a native function, called on the first call of the function
+    bool BindNative(Function& Fn);
+
+    // Finds a exported function, returns nullptr if isn't exported
+    Function* FindExport(UInt32 Hash, const Array& Name);
+
+    // The libraries are shared by all the virtual machines of the process,
+    // each acquire must be paired with a release
+    static Assembly* AcquireLibrary(Str FilePath);
+    static void ReleaseLibrary(Assembly* Lib);
+
     const Char* FilePath;
     AssemblyError Err;
+    // Set when the imports and the native functions were resolved
+    bool Linked = false;
+    UInt32 References = 0;
+
+    // Function code and strings points into the mapping
+    MappedFile Mapping;
+    codefile::SectionHeader Sections[codefile::SectionCount] = {};
+    const codefile::FunctionEntry* FunctionTable = nullptr;
+    const codefile::ExportEntry* ExportTable = nullptr;
+    const codefile::ImportEntry* ImportTable = nullptr;
+    // Only read to write the profile
+    const codefile::SiteEntry* SiteTable = nullptr;
+    UInt32 ExportSize = 0;
+    UInt32 ImportSize = 0;
+    UInt32 SiteSize = 0;
 
     Vector<Function> CodeSection = {};
     Vector<DataElement> DataSection = {};
     Vector<Array> STSection = {};
+
+    // The native libraries used by the bound native functions, by the index of their name
+    // in the string table, each one is acquired once for all its natives
+    std::unordered_map<UInt32, Library*> Libraries = {};
+    std::mutex BindMutex;
+    std::mutex LoadMutex;
+    // The code files imported by this code file, by the index of their path in the string table,
+    // each one is acquired once for all its imports
+    std::unordered_map<UInt32, Assembly*> Imports = {};
 };
 
 }
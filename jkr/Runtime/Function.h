@@ -1,7 +1,6 @@
 #pragma once
 #include "jkr/CodeFile/Function.h"
 #include "jkr/Runtime/Value.h"
-#include <vector>
 
 namespace runtime {
 
@@ -12,7 +11,23 @@ struct [[nodiscard]] Function : codefile::FunctionHeader {
 
     constexpr ~Function() {}
 
-    std::vector<Byte> Code;
+    // Points into the mapping of the assembly
+    const Byte* Code = nullptr;
+    // Set when the function was materialized from the functions section,
+    // accessed atomically by LoadFunction
+    bool Loaded = false;
+    // Index in the imports section of a function with the FunctionImport flag,
+    // the code file keeps it in SizeOfCode
+    UInt32 Import = 0;
+    // Set when the verifier proved the code, it runs without runtime checks
+    bool Verified = false;
+    // Values pushed over the locals by a verified function at most,
+    // its frame is checked once with them
+    UInt32 MaxDepth = 0;
+    // Backward jumps taken, the iterations of the loops of the function,
+    // each frame adds its count atomically when it returns
+    UInt64 Iterations = 0;
+    // Bound by the first call through Assembly::BindNative, accessed atomically
     Value(*Native)(...) = nullptr;
     Assembly* Asm;
 };
@@ -0,0 +1,47 @@
+#include "jkr/Runtime/MappedFile.h"
+#include <Windows.h>
+
+MappedFile::MappedFile(Str FilePath) {
+    HANDLE file = CreateFileA(
+        (LPCSTR)FilePath,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    Handle = reinterpret_cast<IntPtr>(file);
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        return;
+    }
+
+    Mapping = reinterpret_cast<IntPtr>(mapping);
+    Data = reinterpret_cast<const Byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    Size = Data ? USize(size.QuadPart) : 0;
+}
+
+MappedFile::~MappedFile() {
+    if (Data) {
+        UnmapViewOfFile(Data);
+    }
+
+    if (Mapping) {
+        CloseHandle((HANDLE)Mapping);
+    }
+
+    if (Handle) {
+        CloseHandle((HANDLE)Handle);
+    }
+}
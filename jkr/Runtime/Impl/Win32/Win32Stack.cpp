@@ -0,0 +1,59 @@
+#include "jkr/Runtime/Stack.h"
+#include "jkr/Definitions.h"
+#include "jkr/Align.h"
+#include <Windows.h>
+
+namespace runtime {
+
+Stack::Stack(USize StackSize) {
+    SYSTEM_INFO info = {};
+    GetSystemInfo(&info);
+    PageSize = info.dwPageSize;
+
+    USize size = Align(StackSize * sizeof(Value), PageSize);
+    // Only the address space is reserved, the pages are committed by the filter
+    Start = reinterpret_cast<Value*>(
+        VirtualAlloc(nullptr, size + PageSize, MEM_RESERVE, PAGE_NOACCESS)
+    );
+    End = Start ? Start + size / sizeof(Value) : nullptr;
+    Size = Start ? size / sizeof(Value) : 0;
+}
+
+Stack::~Stack() {
+    if (Start) {
+        VirtualFree(Start, 0, MEM_RELEASE);
+    }
+}
+
+// Only commits the pages, the execution is never unwound through the frames of the
+// virtual machine, a access to the guard page or outside of the stack is passed on
+static LONG CommitFilter(Stack& S, EXCEPTION_POINTERS* Info) {
+    if (Info->ExceptionRecord->ExceptionCode != EXCEPTION_ACCESS_VIOLATION) {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    Byte* address = reinterpret_cast<Byte*>(Info->ExceptionRecord->ExceptionInformation[1]);
+    Byte* start = reinterpret_cast<Byte*>(S.Start);
+    Byte* end = reinterpret_cast<Byte*>(S.End);
+
+    if (address >= start && address < end) {
+        // First touch of a page
+        Byte* page = start + Align(address - start + 1, S.PageSize) - S.PageSize;
+        if (VirtualAlloc(page, S.PageSize, MEM_COMMIT, PAGE_READWRITE)) {
+            return EXCEPTION_CONTINUE_EXECUTION;
+        }
+    }
+
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+void Stack::Run(StackProc Proc, void* Data) {
+    __try {
+        Proc(Data);
+    }
+    __except (CommitFilter(*this, GetExceptionInformation())) {
+        // The filter never executes the handler
+    }
+}
+
+}
@@ -0,0 +1,59 @@
+#include "jkr/Runtime/Library.h"
+#include "jkr/CodeFile/Link.h"
+#include <mutex>
+#include <unordered_map>
+#include <stdio.h>
+
+static std::mutex LibrariesMutex;
+static std::unordered_multimap<UInt32, Library*> LoadedLibraries;
+
+Library* Library::Acquire(const StringView& Name) {
+    UInt32 hash = codefile::HashName(Name.data(), Name.size());
+
+    std::lock_guard lock{ LibrariesMutex };
+    auto [begin, end] = LoadedLibraries.equal_range(hash);
+    for (auto it = begin; it != end; it++) {
+        if (it->second->Name == Name) {
+            it->second->References++;
+            return it->second;
+        }
+    }
+
+    char buff[512] = {};
+#ifdef _WIN32
+    sprintf_s(buff, 512, "%.*s.dll", int(Name.size()), (const char*)Name.data());
+#else
+    snprintf(buff, 512, "lib%.*s.so", int(Name.size()), (const char*)Name.data());
+#endif
+
+    Library* lib = new Library(String((Str)buff));
+    if (!lib->Handle) {
+        delete lib;
+        return nullptr;
+    }
+
+    lib->Hash = hash;
+    lib->Name = Name;
+    lib->References = 1;
+    LoadedLibraries.emplace(hash, lib);
+    return lib;
+}
+
+void Library::Release(Library* Lib) {
+    {
+        std::lock_guard lock{ LibrariesMutex };
+        if (--Lib->References != 0) {
+            return;
+        }
+
+        auto [begin, end] = LoadedLibraries.equal_range(Lib->Hash);
+        for (auto it = begin; it != end; it++) {
+            if (it->second == Lib) {
+                LoadedLibraries.erase(it);
+                break;
+            }
+        }
+    }
+
+    delete Lib;
+}
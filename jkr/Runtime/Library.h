@@ -8,6 +8,11 @@ struct Library {
     IntPtr Handle = 0;
     String FilePath;
 
+    // Hash of the name used to acquire the library
+    UInt32 Hash = 0;
+    UInt32 References = 0;
+    String Name;
+
     Library() {}
 
     Library(const String& FilePath);
@@ -17,4 +22,9 @@ struct Library {
     Library& operator=(Library&&) = default;
 
     Procedure Get(Str Entry);
+
+    // The libraries are shared by the entire process,
+    // each acquire must be paired with a release
+    static Library* Acquire(const StringView& Name);
+    static void Release(Library* Lib);
 };
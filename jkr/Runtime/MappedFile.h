@@ -0,0 +1,20 @@
+#pragma once
+#include "jkr/CoreTypes.h"
+
+// Read only view of a entire file
+struct MappedFile {
+    IntPtr Handle = 0;
+    IntPtr Mapping = 0;
+    const Byte* Data = nullptr;
+    USize Size = 0;
+
+    MappedFile() {}
+
+    MappedFile(Str FilePath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    constexpr bool IsOpen() const { return Data != nullptr || Handle != 0; }
+};
@@ -0,0 +1,16 @@
+#include "jkr/Runtime/Object.h"
+
+namespace runtime {
+
+Object* Object::New(UInt32 Size) {
+    Byte* memory = new Byte[sizeof(Object) + Size]{};
+    Object* object = reinterpret_cast<Object*>(memory);
+    object->Size = Size;
+    return object;
+}
+
+void Object::Destroy(Object* Obj) {
+    delete[] reinterpret_cast<Byte*>(Obj);
+}
+
+}
@@ -3,21 +3,26 @@
 
 namespace runtime {
 
-struct Field {
-    Byte Type;
+// A object is a single allocation, the header is followed by the fields
+// packed by the compiler, the fields are accessed by byte offset.
+struct Object {
+    static Object* New(UInt32 Size);
+    static void Destroy(Object* Obj);
 
-    Value Content;
-};
+    Byte* Fields() {
+        return reinterpret_cast<Byte*>(this + 1);
+    }
 
-struct Object {
-    constexpr Object(Byte FieldCount) :
-        FieldCount(FieldCount) {
-        Fields = new Field[FieldCount]{};
+    Byte& GetByte(UInt16 Offset) {
+        return Fields()[Offset];
+    }
+
+    UInt& GetUInt(UInt16 Offset) {
+        return *reinterpret_cast<UInt*>(Fields() + Offset);
     }
-    constexpr ~Object() {}
 
-    Byte FieldCount;
-    Field* Fields = nullptr;
+    // Size of the fields in bytes
+    USize Size;
 };
 
 }
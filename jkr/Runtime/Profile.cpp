@@ -0,0 +1,95 @@
+#include "jkr/Runtime/Profile.h"
+#include "jkr/Runtime/Assembly.h"
+#include <jkr/CodeFile/Profile.h>
+#include <fstream>
+#include <map>
+#include <algorithm>
+
+namespace runtime {
+
+template<typename T>
+static void Write(std::ofstream& File, const T& Value) {
+    File.write((const char*)&Value, sizeof(T));
+}
+
+struct SiteCounts {
+    UInt64 Counts[2] = {};
+};
+
+void BeginProfile(const Assembly& Asm, UInt32 Function, FunctionProfile& Profile) {
+    auto first = Asm.SiteTable;
+    auto last = Asm.SiteTable + Asm.SiteSize;
+    auto begin = std::lower_bound(first, last, Function, [](const codefile::SiteEntry& Site, UInt32 Function) {
+        return Site.Function < Function;
+    });
+    auto end = std::upper_bound(begin, last, Function, [](UInt32 Function, const codefile::SiteEntry& Site) {
+        return Function < Site.Function;
+    });
+
+    Profile.FirstSite = UInt32(begin - first);
+    Profile.SiteCount = UInt32(end - begin);
+    Profile.Taken.assign(Profile.SiteCount, 0);
+    Profile.NotTaken.assign(Profile.SiteCount, 0);
+}
+
+void CountSite(const Assembly& Asm, FunctionProfile& Profile, UInt32 Offset, bool IsTaken) {
+    auto first = Asm.SiteTable + Profile.FirstSite;
+    auto last = first + Profile.SiteCount;
+    auto site = std::lower_bound(first, last, Offset, [](const codefile::SiteEntry& Site, UInt32 Offset) {
+        return Site.Offset < Offset;
+    });
+
+    // The entry of the function itself has no code
+    while (site != last && site->Offset == Offset && site->Kind == codefile::SiteFunction) {
+        site++;
+    }
+    if (site == last || site->Offset != Offset)
+        return;
+
+    (IsTaken ? Profile.Taken : Profile.NotTaken)[site - first]++;
+}
+
+bool WriteProfile(const Assembly& Asm, const Vector<FunctionProfile>& Profiles, Str Path) {
+    std::ofstream file{ (const char*)Path, std::ios::binary | std::ios::trunc };
+    if (!file.is_open())
+        return false;
+
+    // The copies of a site in the code are summed, a site
+    // of a function that was called and has no counts never ran
+    std::map<std::pair<UInt64, UInt32>, SiteCounts> sites = {};
+    for (UInt32 i = 0; i < Asm.SiteSize; i++) {
+        const codefile::SiteEntry& site = Asm.SiteTable[i];
+        if (site.Function >= Profiles.size() || Profiles[site.Function].Calls == 0)
+            continue;
+
+        const FunctionProfile& profile = Profiles[site.Function];
+        if (site.Kind == codefile::SiteFunction) {
+            sites[{ site.Key, site.Site }].Counts[0] += profile.Calls;
+            continue;
+        }
+
+        UInt32 index = i - profile.FirstSite;
+        if (index >= profile.SiteCount)
+            continue;
+
+        SiteCounts& counts = sites[{ site.Key, site.Site }];
+        bool isNegated = site.Kind == codefile::SiteNegatedBranch;
+        counts.Counts[isNegated ? 1 : 0] += profile.Taken[index];
+        counts.Counts[isNegated ? 0 : 1] += profile.NotTaken[index];
+    }
+
+    Write(file, codefile::ProfileMagic);
+    Write(file, codefile::ProfileVersion);
+    Write(file, UInt32(sites.size()));
+
+    for (auto& [key, counts] : sites) {
+        Write(file, key.first);
+        Write(file, key.second);
+        Write(file, counts.Counts[0]);
+        Write(file, counts.Counts[1]);
+    }
+
+    return bool(file);
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "jkr/CoreTypes.h"
+#include "jkr/Vector.h"
+
+namespace runtime {
+
+struct Assembly;
+
+// Counts of a function of the profiled code file, by index of the site in its entries
+// of the sites section
+struct FunctionProfile {
+    UInt64 Calls = 0;
+    // The entries of the function in Assembly::SiteTable
+    UInt32 FirstSite = 0;
+    UInt32 SiteCount = 0;
+    // A conditional jump counts in both, a call only in Taken
+    Vector<UInt64> Taken = {};
+    Vector<UInt64> NotTaken = {};
+};
+
+// Called on the first call of the function, finds its entries in the sites section
+void BeginProfile(const Assembly& Asm, UInt32 Function, FunctionProfile& Profile);
+
+// Counts the jump or the call at Offset in the code of the function, the jumps without a site aren't counted
+void CountSite(const Assembly& Asm, FunctionProfile& Profile, UInt32 Offset, bool IsTaken);
+
+// Writes the counts of the sites of the functions called in the codefile::ProfileMagic format,
+// returns false if the file can't be written
+bool WriteProfile(const Assembly& Asm, const Vector<FunctionProfile>& Profiles, Str Path);
+
+}
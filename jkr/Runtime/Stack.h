@@ -3,15 +3,28 @@
 
 namespace runtime {
 
+// The stack is a reserved region of virtual memory followed by a guard page,
+// the pages are committed on first touch so a idle stack only costs the reservation.
+// The virtual machine checks the pushes and the frames against End and returns
+// through its error path, the guard page only stops a access that escaped them.
 struct [[nodiscard]] Stack {
+    using StackProc = void(*)(void* Data);
+
     Stack(USize StackSize);
     ~Stack();
 
-    Stack(Stack&&) = default;
-    Stack& operator=(Stack&&) = default;
+    Stack(const Stack&) = delete;
+    Stack& operator=(const Stack&) = delete;
+
+    // Calls Proc committing the pages of the stack as they are touched, nothing
+    // is unwound. The frames and the pushes are checked before they reach the guard page
+    void Run(StackProc Proc, void* Data);
 
     USize Size;
     Value* Start;
+    // One past the last usable value, the guard page begins here
+    Value* End;
+    USize PageSize;
 };
 
 struct [[nodiscard]] StackFrame {
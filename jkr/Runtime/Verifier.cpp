@@ -0,0 +1,250 @@
+#include "jkr/Runtime/Verifier.h"
+#include "jkr/Runtime/Assembly.h"
+#include <jkr/CodeFile/OpCodes.h>
+#include <jkr/CodeFile/Array.h>
+#include <string.h>
+#include <algorithm>
+
+namespace runtime {
+
+// Depth of the stack in the code that can't be reached
+constexpr UInt32 NoDepth = 0xFFFF'FFFF;
+// Each pass lowers the depth of a loop, the nested loops need one more
+constexpr UInt32 MaxPasses = 8;
+
+template<typename T>
+static T ReadOperand(const Byte* Operand) {
+    T value;
+    memcpy(&value, Operand, sizeof(T));
+    return value;
+}
+
+// A join point keeps the lowest depth, the pops are proven against it
+static void MergeDepth(UInt32& Dest, UInt32 Depth) {
+    Dest = std::min(Dest, Depth);
+}
+
+// Targets has the depth of the stack at the jump targets, Repeat is set when a backward
+// jump reaches code that was checked with a deeper stack, or as unreachable
+static VerifyResult VerifyPass(const Assembly& Asm, const Function& Fn, Vector<UInt32>& Targets, bool& Repeat, UInt32& MaxDepth) {
+    const Byte* code = Fn.Code;
+    const UInt32 size = Fn.SizeOfCode;
+
+    VerifyResult result = VerifyProven;
+    // Values pushed over the locals of the frame
+    UInt32 depth = 0;
+    // Highest depth on any path, a join point keeps the highest
+    UInt32 highDepth = 0;
+    Vector<UInt32> highTargets(size, 0);
+    // Depth of the stack at each instruction, for the backward jumps
+    Vector<UInt32> depths(size, NoDepth);
+    Vector<UInt32> highDepths(size, 0);
+    Vector<bool> starts(size, false);
+    MaxDepth = 0;
+    bool terminated = false;
+
+    UInt32 offset = 0;
+    while (offset < size) {
+        MergeDepth(depth, Targets[offset]);
+        highDepth = std::max(highDepth, highTargets[offset]);
+        depths[offset] = depth;
+        highDepths[offset] = highDepth;
+        starts[offset] = true;
+
+        Byte byte = code[offset];
+        if (byte >= codefile::OpCodeCount || codefile::InstructionSizes[byte] == 0) {
+            return VerifyCorrupt;
+        }
+
+        UInt32 length = codefile::InstructionSizes[byte];
+        if (size - offset < length) {
+            return VerifyCorrupt;
+        }
+
+        const Byte* operands = code + offset + 1;
+        UInt32 next = offset + length;
+        terminated = false;
+
+        switch (codefile::OpCode(byte)) {
+        case codefile::OpCode::Ldstr:
+            if (ReadOperand<UInt32>(operands + 1) >= Asm.StringsSize) {
+                return VerifyCorrupt;
+            }
+            break;
+        case codefile::OpCode::Ldr:
+        case codefile::OpCode::Str:
+        {
+            UInt16 index = ReadOperand<UInt16>(operands + 1);
+            switch (INST_ARG2(operands[0])) {
+            case codefile::BaseSP:
+                // Relative to the top of the stack, only known at runtime
+                result = VerifyUnproven;
+                break;
+            case codefile::BaseFP:
+                if (index >= Fn.LocalReserve) {
+                    return VerifyCorrupt;
+                }
+                break;
+            case codefile::BaseCS:
+                if (index >= Asm.DataSize) {
+                    return VerifyCorrupt;
+                }
+                break;
+            default:
+                return VerifyCorrupt;
+            }
+        }
+        break;
+        case codefile::OpCode::Jmp:
+        case codefile::OpCode::Je:
+        case codefile::OpCode::Jne:
+        case codefile::OpCode::Jl:
+        case codefile::OpCode::Jle:
+        case codefile::OpCode::Jg:
+        case codefile::OpCode::Jge:
+        case codefile::OpCode::Jmp8:
+        case codefile::OpCode::Je8:
+        case codefile::OpCode::Jne8:
+        case codefile::OpCode::Jl8:
+        case codefile::OpCode::Jle8:
+        case codefile::OpCode::Jg8:
+        case codefile::OpCode::Jge8:
+        case codefile::OpCode::Jmp32:
+        case codefile::OpCode::Je32:
+        case codefile::OpCode::Jne32:
+        case codefile::OpCode::Jl32:
+        case codefile::OpCode::Jle32:
+        case codefile::OpCode::Jg32:
+        case codefile::OpCode::Jge32:
+        {
+            Int64 displacement = 0;
+            switch (length) {
+            case 2: displacement = ReadOperand<Int8>(operands); break;
+            case 3: displacement = ReadOperand<Int16>(operands); break;
+            default: displacement = ReadOperand<Int32>(operands); break;
+            }
+
+            Int64 target = Int64(next) + displacement;
+            if (target < 0 || target >= Int64(size)) {
+                return VerifyCorrupt;
+            }
+
+            if (target > offset) {
+                MergeDepth(Targets[target], depth);
+                highTargets[target] = std::max(highTargets[target], highDepth);
+            }
+            else if (!starts[target]) {
+                // A backward jump must land in a instruction that was already decoded
+                return VerifyCorrupt;
+            }
+            else {
+                if (depth < depths[target]) {
+                    // The loop is checked again from the lower depth
+                    MergeDepth(Targets[target], depth);
+                    Repeat = true;
+                }
+                if (highDepth > highDepths[target]) {
+                    // Each iteration pushes more and MaxDepth doesn't bound the stack
+                    result = VerifyUnproven;
+                }
+            }
+
+            if (codefile::GetNearJump(codefile::OpCode(byte)) == codefile::OpCode::Jmp) {
+                depth = NoDepth;
+                highDepth = 0;
+                terminated = true;
+            }
+        }
+        break;
+        case codefile::OpCode::Call:
+        {
+            UInt32 index = ReadOperand<UInt32>(operands);
+            if (index >= Asm.FunctionSize) {
+                return VerifyCorrupt;
+            }
+
+            // The native functions takes the arguments in registers
+            const codefile::FunctionEntry& callee = Asm.FunctionTable[index];
+            UInt32 arguments = callee.Flags & codefile::FunctionNative ? 0 : callee.StackArguments;
+            if (depth != NoDepth && depth < arguments) {
+                result = VerifyUnproven;
+            }
+        }
+        break;
+        case codefile::OpCode::Ret:
+        case codefile::OpCode::RetC:
+            depth = NoDepth;
+            highDepth = 0;
+            terminated = true;
+            break;
+        case codefile::OpCode::Push8:
+        case codefile::OpCode::Push16:
+        case codefile::OpCode::Push32:
+        case codefile::OpCode::Push64:
+        case codefile::OpCode::Push:
+            // The frame is checked with the highest depth when the function is called
+            if (depth != NoDepth) {
+                depth++;
+                highDepth++;
+                MaxDepth = std::max(MaxDepth, highDepth);
+            }
+            break;
+        case codefile::OpCode::Popd:
+        case codefile::OpCode::Pop:
+            if (depth == 0) {
+                result = VerifyUnproven;
+            }
+            else if (depth != NoDepth) {
+                depth--;
+                highDepth--;
+            }
+            break;
+        case codefile::OpCode::ArrayNew:
+            if (INST_ARG2(operands[0]) > codefile::AT_32B) {
+                return VerifyCorrupt;
+            }
+            break;
+        case codefile::OpCode::LoadField:
+        case codefile::OpCode::StoreField:
+            // The offset is checked against the size of the object at runtime
+            if (operands[1] > codefile::AE_8B) {
+                return VerifyCorrupt;
+            }
+            break;
+        default:
+            break;
+        }
+
+        // A jump into the middle of a instruction
+        for (UInt32 i = offset + 1; i < next; i++) {
+            if (Targets[i] != NoDepth) {
+                return VerifyCorrupt;
+            }
+        }
+
+        offset = next;
+    }
+
+    // The execution can't fall off the end of the code
+    return terminated ? result : VerifyCorrupt;
+}
+
+VerifyResult Verify(const Assembly& Asm, const Function& Fn, UInt32& MaxDepth) {
+    // The arguments are the first locals of the frame
+    if (Fn.StackArguments > Fn.LocalReserve) {
+        return VerifyCorrupt;
+    }
+
+    Vector<UInt32> targets(Fn.SizeOfCode, NoDepth);
+    for (UInt32 pass = 0; pass < MaxPasses; pass++) {
+        bool repeat = false;
+        VerifyResult result = VerifyPass(Asm, Fn, targets, repeat, MaxDepth);
+        if (result == VerifyCorrupt || !repeat)
+            return result;
+    }
+
+    // The code is valid but the depths didn't settle
+    return VerifyUnproven;
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "jkr/Runtime/Function.h"
+
+namespace runtime {
+
+struct Assembly;
+
+enum VerifyResult {
+    // The code can't be executed
+    VerifyCorrupt = 0,
+    // The code is valid but some accesses are only known at runtime
+    VerifyUnproven = 1,
+    // Every access of the code is valid, it can run without runtime checks
+    VerifyProven = 2,
+};
+
+// Checks the code of a function before the first execution, a pass proves the
+// entire function, the backward jumps are checked against the depth of the stack
+// recorded at its target and the code of a loop is checked again if it was lower.
+// MaxDepth is the most values that the code pushes over its locals
+VerifyResult Verify(const Assembly& Asm, const Function& Fn, UInt32& MaxDepth);
+
+}
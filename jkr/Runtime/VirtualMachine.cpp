@@ -1,9 +1,12 @@
 #include "jkr/CodeFile/OpCodes.h"
 #include "jkr/CodeFile/Type.h"
 #include "jkr/Runtime/VirtualMachine.h"
+#include "jkr/Runtime/Object.h"
 #include "jkr/Error.h"
 #include "jkr/String.h"
 #include <stdio.h>
+#include <mutex>
+#include <atomic>
 
 using Float4 = Float[4];
 using Int4 = Int[4];
@@ -28,6 +31,32 @@ thread_local UInt CMP = 0;
         RuntimeError(false, "Index out of range");\
     }
 
+// The size of a object is only known at runtime, the field must be inside it
+#define CHECK_FIELD() \
+    if (!object || word + (util2 == codefile::AE_1B ? 1 : sizeof(UInt)) > object->Size) {\
+        RuntimeError(false, "Field out of range");\
+    }
+
+// The checks of the code that the verifier couldn't prove,
+// a error returns through all the calls with Err set
+#define CHECK_CODE(Expr) \
+    if constexpr (Checked) {\
+        if (!(Expr)) {\
+            Err = VMCorruptAssembly;\
+            return 0;\
+        }\
+    }
+
+// The pushes of a proven function are checked once with its frame,
+// the unproven code checks every push
+#define CHECK_PUSH() \
+    if constexpr (Checked) {\
+        if (Frame.SP >= VMStack.End) {\
+            Err = VMStackOverflow;\
+            return 0;\
+        }\
+    }
+
 #define GET_AND_INC(Type, Dest) \
     Dest = *(Type*)ip;\
     ip += sizeof(Type);
@@ -52,26 +81,65 @@ thread_local UInt CMP = 0;
     Registers[INST_ARG1(util)].##Field = Registers[INST_ARG2(util)].##Field Op Type(word);\
     break;\
 
+// The displacement is relative to the next instruction, a backward jump
+// that the verifier couldn't prove is checked against the start of the code.
+// The backward jumps are the back edges of the loops, each one taken is a iteration of the frame
+#define HANDLE_JUMP(Case, Type, Cond) \
+    case codefile::OpCode::##Case:\
+    {\
+        Type displacement;\
+        GET_AND_INC(Type, displacement);\
+        bool taken = (Cond);\
+        if constexpr (Profiled) {\
+            CountSite(*Fn.Asm, *Profile, UInt32(ip - Fn.Code) - sizeof(Type) - 1, taken);\
+        }\
+        if (taken) {\
+            if (displacement < 0) {\
+                CHECK_CODE(ip - Fn.Code >= -Int(displacement));\
+                iterations++;\
+            }\
+            ip = ip + displacement;\
+        }\
+    }\
+    break;\
+
+#define HANDLE_JUMPS(Case, Cond) \
+    HANDLE_JUMP(Case, Int16, Cond)\
+    HANDLE_JUMP(Case##8, Int8, Cond)\
+    HANDLE_JUMP(Case##32, Int32, Cond)\
+
 namespace runtime {
 
 // Utility
 
+// Each comparision replaces the flags of the previous one
 void MakeComparisionInteger(UInt A, UInt B) {
-    UInt diff = A - B;
-    UInt sign = (diff >> 63) & 0x1;
-    CMP |= sign ? SIGN_FLAG : 0;
-    CMP |=
-        ((diff ^ sign) - sign) ? 
-        0 :
-        ZERO_FLAG;
+    CMP = A == B ? ZERO_FLAG : 0;
+    CMP |= Int(A) < Int(B) ? SIGN_FLAG : 0;
 }
 
 void MakeComparisionFloat(Float A, Float B) {
-    if (A < B) {
-        CMP |= SIGN_FLAG;
+    CMP = A == B ? ZERO_FLAG : 0;
+    CMP |= A < B ? SIGN_FLAG : 0;
+}
+
+static void AddIterations(Function& Fn, UInt64 Iterations) {
+    if (Iterations != 0) {
+        std::atomic_ref(Fn.Iterations).fetch_add(Iterations, std::memory_order_relaxed);
     }
-    if (A > B) {
-        CMP |= SIGN_FLAG;
+}
+
+// Checks a address of Ldr/Str that the verifier couldn't prove
+static bool IsValidAddress(const Stack& VMStack, const Function& Fn, const StackFrame& Frame, Byte Base, UInt16 Index) {
+    switch (Base) {
+    case codefile::BaseSP:
+        return Frame.SP + Index < VMStack.End;
+    case codefile::BaseFP:
+        return Index < Fn.LocalReserve;
+    case codefile::BaseCS:
+        return Index < Fn.Asm->DataSize;
+    default:
+        return false;
     }
 }
 
@@ -96,73 +164,143 @@ Int VirtualMachine::ExecMain() {
         return {};
     }
     
-    Function& fn = Asm->CodeSection[Asm->EntryPoint];
+    Function* fn = Asm->LoadFunction(Asm->EntryPoint);
+    if (!fn) {
+        Err = VMCorruptAssembly;
+        return {};
+    }
+
+    if (!VMStack.Start) {
+        Err = VMStackOverflow;
+        return {};
+    }
 
-    StackFrame frame = {
-        .SP = VMStack.Start,
-        .FP = VMStack.Start,
+    Err = VMSuccess;
+    Profiles.clear();
+    if (IsProfiling) {
+        Profiles.resize(Asm->FunctionSize);
+    }
+
+    struct MainCall {
+        VirtualMachine* VM;
+        Function* Fn;
+        StackFrame Frame;
+    } call = {
+        .VM = this,
+        .Fn = fn,
+        .Frame = {
+            .SP = VMStack.Start + fn->LocalReserve,
+            .FP = VMStack.Start,
+        },
     };
-    UInt status = MainLoop(fn, frame);
-    (void)status;
+
+    if (!FitsInStack(*call.Fn, call.Frame)) {
+        Err = VMStackOverflow;
+        return {};
+    }
+
+    VMStack.Run([](void* Data) {
+        MainCall& call = *reinterpret_cast<MainCall*>(Data);
+        UInt status = call.VM->Execute(*call.Fn, call.Frame);
+        (void)status;
+    }, &call);
+
+    if (Err != VMSuccess) {
+        return {};
+    }
+
     return Registers[0].Signed;
 }
 
 void VirtualMachine::ResolveExtern() {
-    for (auto& fn : Asm->CodeSection) {
-        if (fn.Flags & codefile::FunctionNative) {
-            USize lib = {};
-            if (!TryLoad(Asm->STSection[fn.SizeOfCode], lib)) {
-                Err = VMLinkageError;
-                return;
-            }
+    // The libraries are shared by all the virtual machines,
+    // so only one can be linking at the same time
+    static std::mutex linkMutex;
+    std::lock_guard lock{ linkMutex };
 
-            UInt entryAddress = UInt(fn.StackArguments | (fn.LocalReserve << 16));
-            Str entry = Str(Asm->STSection[entryAddress].Bytes);
-            fn.Native = (Value(*)(...))Libraries[lib].Get(entry);
+    Err = Link(Asm);
+    LinkageResolved = Err == VMSuccess;
+}
 
-            if (!fn.Native) {
-                Err = VMLinkageError;
-                return;
-            }
-        }
+VMError VirtualMachine::Link(Assembly* Target) {
+    if (Target->Linked) {
+        return VMSuccess;
     }
 
-    LinkageResolved = true;
-}
+    // Marked before resolving the imports, so a import cycle ends here
+    Target->Linked = true;
 
-bool VirtualMachine::TryLoad(Array& LibName, USize& Lib) {
-    USize i = 0;
-    for (auto& lib : Libraries) {
-        USize len = lib.FilePath.length();
-        if (len != LibName.Size) {
+    // The native functions are bound on the first call
+    for (UInt32 i = 0; i < Target->FunctionSize; i++) {
+        if (!(Target->FunctionTable[i].Flags & codefile::FunctionImport)) {
             continue;
         }
 
-        if (memcmp((void*)lib.FilePath.data(), LibName.Bytes, len) == 0) {
-            Lib = i;
-            return true;
+        VMError err = VMCorruptAssembly;
+        if (Function* fn = Target->LoadFunction(i)) {
+            err = LinkImport(Target, *fn);
+        }
+
+        if (err != VMSuccess) {
+            Target->Linked = false;
+            return err;
+        }
+    }
+
+    return VMSuccess;
+}
+
+VMError VirtualMachine::LinkImport(Assembly* Target, Function& Fn) {
+    const codefile::ImportEntry& import = Target->ImportTable[Fn.Import];
+
+    Assembly*& lib = Target->Imports[import.Library];
+    if (!lib) {
+        lib = Assembly::AcquireLibrary(Str(Target->STSection[import.Library].Bytes));
+        if (!lib) {
+            Target->Imports.erase(import.Library);
+            return VMLinkageError;
         }
-        i++;
     }
 
-    char buff[512] = {};
-#ifdef _WIN32
-    sprintf_s(buff, 512, "%s.dll", (char*)LibName.Bytes);
-#else
-    sprintf(buff, "lib%s.so", (char*)LibName.Items);
-#endif
+    VMError err = Link(lib);
+    if (err != VMSuccess) {
+        return err;
+    }
 
-    auto& newLib = Libraries.emplace_back((Char*)buff);
-    Lib = Libraries.size() - 1;
-    if (!newLib.Handle)
-        return false;
+    Function* exported = lib->FindExport(import.Hash, Target->STSection[import.Name]);
+    if (!exported) {
+        return VMLinkageError;
+    }
 
-    return true;
+    // The callers were verified with the arguments of the import
+    if (exported->StackArguments != Fn.StackArguments) {
+        return VMLinkageError;
+    }
+
+    // The import becomes a direct reference to the exported function
+    static_cast<codefile::FunctionHeader&>(Fn) = *exported;
+    Fn.Code = exported->Code;
+    Fn.Native = std::atomic_ref(exported->Native).load(std::memory_order_acquire);
+    Fn.Verified = exported->Verified;
+    Fn.MaxDepth = exported->MaxDepth;
+    Fn.Asm = exported->Asm;
+    return VMSuccess;
 }
 
+template<bool Checked>
 UInt VirtualMachine::ProcessCall(StackFrame& Frame, Function& Fn) {
-    if (Fn.Native) {
-        Registers[0] = Fn.Native(
+    if (Fn.Flags & codefile::FunctionNative) {
+        // The first call binds the function, the next calls uses it directly
+        auto native = std::atomic_ref(Fn.Native).load(std::memory_order_acquire);
+        if (!native) {
+            if (!Fn.Asm->BindNative(Fn)) {
+                Err = VMLinkageError;
+                return 0;
+            }
+            native = std::atomic_ref(Fn.Native).load(std::memory_order_acquire);
+        }
+
+        Registers[0] = native(
             Registers[1], Registers[2], Registers[3], Registers[4], Registers[5],
             Registers[6], Registers[7], Registers[8], Registers[9], Registers[10]
         );
@@ -174,11 +312,56 @@ UInt VirtualMachine::ProcessCall(StackFrame& Frame, Function& Fn) {
         .FP = Frame.SP - Fn.StackArguments,
     };
 
-    return MainLoop(Fn, newFrame);
+    // The verifier proves that the arguments were pushed
+    CHECK_CODE(newFrame.FP >= VMStack.Start);
+
+    if (!FitsInStack(Fn, newFrame)) {
+        Err = VMStackOverflow;
+        return 0;
+    }
+
+    return Execute(Fn, newFrame);
+}
+
+bool VirtualMachine::FitsInStack(const Function& Fn, const StackFrame& Frame) const {
+    // The locals of the frame and the pushes of a proven function,
+    // the unproven code checks its pushes one by one
+    return Frame.SP <= VMStack.End && USize(VMStack.End - Frame.SP) >= Fn.MaxDepth;
+}
+
+// Only the functions of the code file of the virtual machine are profiled,
+// the imported ones run with the function of their library
+FunctionProfile* VirtualMachine::BeginProfile(Function& Fn) {
+    if (Profiles.empty() || Fn.Asm != Asm)
+        return nullptr;
+
+    UInt32 index = UInt32(&Fn - Asm->CodeSection.data());
+    FunctionProfile& profile = Profiles[index];
+    if (profile.Calls++ == 0) {
+        runtime::BeginProfile(*Asm, index, profile);
+    }
+    return &profile;
+}
+
+UInt VirtualMachine::Execute(Function& Fn, StackFrame& Frame) {
+    // The loop without the profile doesn't test it on each jump
+    if (FunctionProfile* profile = BeginProfile(Fn)) {
+        if (Fn.Verified) {
+            return MainLoop<false, true>(Fn, Frame, profile);
+        }
+        return MainLoop<true, true>(Fn, Frame, profile);
+    }
+
+    if (Fn.Verified) {
+        return MainLoop<false, false>(Fn, Frame, nullptr);
+    }
+    return MainLoop<true, false>(Fn, Frame, nullptr);
 }
 
-UInt VirtualMachine::MainLoop(Function& Fn, StackFrame& Frame) {
-    Byte* ip = &Fn.Code[0];
+template<bool Checked, bool Profiled>
+UInt VirtualMachine::MainLoop(Function& Fn, StackFrame& Frame, FunctionProfile* Profile) {
+    const Byte* ip = Fn.Code;
+    const Byte* end = Fn.Code + Fn.SizeOfCode;
 
     Value constant = {};
     Byte util = 0;
@@ -189,8 +372,17 @@ UInt VirtualMachine::MainLoop(Function& Fn, StackFrame& Frame) {
         UInt qword = 0;
     };
     Array* array = nullptr;
+    Object* object = nullptr;
+    // Added to the function when the frame returns, the function can run in other threads
+    UInt64 iterations = 0;
 
     while (true) {
+        // Checking the next instruction checks the forward jumps
+        CHECK_CODE(ip < end
+            && *ip < codefile::OpCodeCount
+            && codefile::InstructionSizes[*ip] != 0
+            && USize(end - ip) >= codefile::InstructionSizes[*ip]);
+
         codefile::OpCode opcode = codefile::OpCode(*ip++);
 
         switch (opcode) {
@@ -228,11 +420,13 @@ UInt VirtualMachine::MainLoop(Function& Fn, StackFrame& Frame) {
         case codefile::OpCode::Ldstr:
             util = *ip++;
             GET_AND_INC(UInt32, dword);
-            Registers[INST_ARG1(util)].Ptr = &Asm->STSection[dword];
+            CHECK_CODE(dword < Fn.Asm->StringsSize);
+            Registers[INST_ARG1(util)].Ptr = &Fn.Asm->STSection[dword];
             break;
         case codefile::OpCode::Ldr:
             util = *ip++;
             GET_AND_INC(UInt16, word);
+            CHECK_CODE(IsValidAddress(VMStack, Fn, Frame, INST_ARG2(util), word));
             if (INST_ARG2(util) == codefile::BaseSP) {
                 Registers[INST_ARG1(util)] = Frame.SP[word];
             }
@@ -240,11 +434,13 @@ UInt VirtualMachine::MainLoop(Function& Fn, StackFrame& Frame) {
                 Registers[INST_ARG1(util)] = Frame.FP[word];
             }
             else  if (INST_ARG2(util) == codefile::BaseCS) {
-                Registers[INST_ARG1(util)].Unsigned = Asm->DataSection[word].Value.Unsigned;
+                Registers[INST_ARG1(util)].Unsigned = Fn.Asm->DataSection[word].Value.Unsigned;
             }
             break;
         case codefile::OpCode::Str:
             util = *ip++;
+            GET_AND_INC(UInt16, word);
+            CHECK_CODE(IsValidAddress(VMStack, Fn, Frame, INST_ARG2(util), word));
             if (INST_ARG2(util) == codefile::BaseSP) {
                 Frame.SP[word] = Registers[INST_ARG1(util)];
             }
@@ -252,90 +448,55 @@ UInt VirtualMachine::MainLoop(Function& Fn, StackFrame& Frame) {
                 Frame.FP[word] = Registers[INST_ARG1(util)];
             }
             else  if (INST_ARG2(util) == codefile::BaseCS) {
-                Asm->DataSection[word].Value.Unsigned = Registers[INST_ARG1(util)].Unsigned;
+                Fn.Asm->DataSection[word].Value.Unsigned = Registers[INST_ARG1(util)].Unsigned;
             }
             break;
         case codefile::OpCode::Cmp:
             util = *ip++;
-            MakeComparisionInteger(INST_ARG1(util), INST_ARG2(util));
+            MakeComparisionInteger(Registers[INST_ARG1(util)].Unsigned, Registers[INST_ARG2(util)].Unsigned);
             break;
         case codefile::OpCode::FCmp:
-        {
-            union {
-                UInt op1_;
-                Float op1;
-            };
-
-            union {
-                UInt op2_;
-                Float op2;
-            };
-
             util = *ip++;
-            op1_ = INST_ARG1(util);
-            op2_ = INST_ARG2(util);
-            MakeComparisionFloat(op1, op2);
-        }
-        break;
+            MakeComparisionFloat(Registers[INST_ARG1(util)].Real, Registers[INST_ARG2(util)].Real);
+            break;
         case codefile::OpCode::TestZ:
             util = *ip++;
-            if (!Registers[INST_ARG1(util)].Unsigned) {
-                CMP |= ZERO_FLAG;
-            }
-            break;
-        case codefile::OpCode::Jmp:
-            GET_AND_INC(UInt16, word);
-            ip = ip + word;
-            break;
-        case codefile::OpCode::Je:
-            GET_AND_INC(UInt16, word);
-            if (CMP & ZERO_FLAG) {
-                ip = ip + word;
-            }
-            break;
-        case codefile::OpCode::Jne:
-            GET_AND_INC(UInt16, word);
-            if (!(CMP & ZERO_FLAG)) {
-                ip = ip + word;
-            }
-            break;
-        case codefile::OpCode::Jl:
-            GET_AND_INC(UInt16, word);
-            if (CMP & SIGN_FLAG) {
-                ip = ip + word;
-            }
-            break;
-        case codefile::OpCode::Jle:
-            GET_AND_INC(UInt16, word);
-            if (CMP & ZERO_FLAG || CMP & SIGN_FLAG) {
-                ip = ip + word;
-            }
-            break;
-        case codefile::OpCode::Jg:
-            GET_AND_INC(UInt16, word);
-            if (!(CMP & ZERO_FLAG) && !(CMP & SIGN_FLAG)) {
-                ip = ip + word;
-            }
-            break;
-        case codefile::OpCode::Jge:
-            GET_AND_INC(UInt16, word);
-            if (!(CMP & SIGN_FLAG)) {
-                ip = ip + word;
-            }
-            break;
+            MakeComparisionInteger(Registers[INST_ARG1(util)].Unsigned, 0);
+            break;
+        HANDLE_JUMPS(Jmp, true)
+        HANDLE_JUMPS(Je, CMP & ZERO_FLAG)
+        HANDLE_JUMPS(Jne, !(CMP & ZERO_FLAG))
+        HANDLE_JUMPS(Jl, CMP & SIGN_FLAG)
+        HANDLE_JUMPS(Jle, CMP & ZERO_FLAG || CMP & SIGN_FLAG)
+        HANDLE_JUMPS(Jg, !(CMP & ZERO_FLAG) && !(CMP & SIGN_FLAG))
+        HANDLE_JUMPS(Jge, !(CMP & SIGN_FLAG))
         case codefile::OpCode::Call:
         {
             GET_AND_INC(UInt32, dword);
-            RuntimeError(qword < Asm->FunctionSize, "Invalid function address %08X", dword);
-            Function& target = Asm->CodeSection[dword];
-            UInt status = ProcessCall(Frame, target);
+            CHECK_CODE(dword < Fn.Asm->FunctionSize);
+            if constexpr (Profiled) {
+                CountSite(*Fn.Asm, *Profile, UInt32(ip - Fn.Code) - sizeof(UInt32) - 1, true);
+            }
+            // The callee is verified when it's materialized
+            Function* target = Fn.Asm->LoadFunction(dword);
+            if (!target) {
+                Err = VMCorruptAssembly;
+                return 0;
+            }
+            UInt status = ProcessCall<Checked>(Frame, *target);
             (void)status;
+            // A error returns through all the calls with Err set
+            if (Err != VMSuccess) {
+                return 0;
+            }
         }
         break;
         case codefile::OpCode::Ret:
+            AddIterations(Fn, iterations);
             return 0;
         case codefile::OpCode::RetC:
             GET_AND_INC(UInt32, dword);
+            AddIterations(Fn, iterations);
             return dword;
         case codefile::OpCode::Inc:
             util = *ip++;
@@ -410,41 +571,51 @@ UInt VirtualMachine::MainLoop(Function& Fn, StackFrame& Frame) {
                 HANDLE_MATH16(XOr16, ^, Unsigned, UInt16);
             }
         case codefile::OpCode::Not:
+            util = *ip++;
             Registers[INST_ARG1(util)].Unsigned = ~Registers[INST_ARG1(util)].Unsigned;
             break;
         case codefile::OpCode::Neg:
+            util = *ip++;
             Registers[INST_ARG1(util)].Signed = -Registers[INST_ARG1(util)].Signed;
             break;
         case codefile::OpCode::Push8:
+            CHECK_PUSH();
             Push(Frame, { .Unsigned = *ip++ });
             break;
         case codefile::OpCode::Push16:
+            CHECK_PUSH();
             GET_AND_INC(UInt16, word);
             Push(Frame, { .Unsigned = word });
             break;
         case codefile::OpCode::Push32:
+            CHECK_PUSH();
             GET_AND_INC(UInt32, dword);
             Push(Frame, { .Unsigned = dword });
             break;
         case codefile::OpCode::Push64:
-            GET_AND_INC(UInt32, qword);
+            CHECK_PUSH();
+            GET_AND_INC(UInt64, qword);
             Push(Frame, { .Unsigned = qword });
             break;
         case codefile::OpCode::Popd:
+            CHECK_CODE(Frame.SP > VMStack.Start);
             (void)Pop(Frame);
             break;
         case codefile::OpCode::Push:
+            CHECK_PUSH();
             util = *ip++;
             Push(Frame, Registers[INST_ARG1(util)]);
             break;
         case codefile::OpCode::Pop:
             util = *ip++;
+            CHECK_CODE(Frame.SP > VMStack.Start);
             Registers[INST_ARG1(util)] = Pop(Frame);
             break;
         case codefile::OpCode::ArrayNew:
             util = *ip++;
             qword = Registers[INST_ARG1(util)].Unsigned;
-            util2 = Byte(Registers[INST_ARG2(util)].Unsigned);
+            util2 = INST_ARG2(util);
+            CHECK_CODE(util2 <= codefile::AT_32B);
 
             Registers[INST_ARG1(util)].ArrayRef = new Array(qword, codefile::ArrayElement(util2));
             break;
@@ -488,9 +659,48 @@ UInt VirtualMachine::MainLoop(Function& Fn, StackFrame& Frame) {
             delete array;
             array = nullptr;
             break;
-        default:
-            RuntimeError(0, "Invalid OpCode %X\n", Byte(opcode));
+        case codefile::OpCode::ObjectNew:
+            util = *ip++;
+            GET_AND_INC(UInt16, word);
+            Registers[INST_ARG1(util)].Obj = Object::New(word);
+            break;
+        case codefile::OpCode::ObjectDestroy:
+            util = *ip++;
+            Object::Destroy(Registers[INST_ARG1(util)].Obj);
             break;
+        case codefile::OpCode::LoadField:
+            util = *ip++;
+            util2 = *ip++;
+            GET_AND_INC(UInt16, word);
+            object = Registers[INST_ARG2(util)].Obj;
+            CHECK_CODE(util2 <= codefile::AE_8B);
+            CHECK_FIELD();
+
+            if (util2 == codefile::AE_1B) {
+                Registers[INST_ARG1(util)].Unsigned = object->GetByte(word);
+            }
+            else {
+                Registers[INST_ARG1(util)].Unsigned = object->GetUInt(word);
+            }
+            break;
+        case codefile::OpCode::StoreField:
+            util = *ip++;
+            util2 = *ip++;
+            GET_AND_INC(UInt16, word);
+            object = Registers[INST_ARG2(util)].Obj;
+            CHECK_CODE(util2 <= codefile::AE_8B);
+            CHECK_FIELD();
+
+            if (util2 == codefile::AE_1B) {
+                object->GetByte(word) = Byte(Registers[INST_ARG1(util)].Unsigned);
+            }
+            else {
+                object->GetUInt(word) = Registers[INST_ARG1(util)].Unsigned;
+            }
+            break;
+        default:
+            // The opcodes are checked before the dispatch
+            UNREACHABLE();
         }
     }
 }
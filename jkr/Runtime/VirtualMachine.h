@@ -1,13 +1,15 @@
 #pragma once
 #include "jkr/Runtime/Assembly.h"
-#include "jkr/Runtime/Library.h"
 #include "jkr/Runtime/Stack.h"
+#include "jkr/Runtime/Profile.h"
 
 namespace runtime {
 
 enum VMError {
     VMSuccess = 0,
     VMLinkageError = 1,
+    VMStackOverflow = 2,
+    VMCorruptAssembly = 3,
 };
 
 struct [[nodiscard]] VirtualMachine {
@@ -15,20 +17,40 @@ struct [[nodiscard]] VirtualMachine {
     ~VirtualMachine();
 
     Int ExecMain();
-    
-    void ResolveExtern();
 
-    bool TryLoad(Array& LibName, USize& Lib);
+    // The next executions count the calls, the conditional jumps and the calls
+    // of the functions of the code file, each execution starts a new profile
+    void EnableProfile() { IsProfiling = true; }
+    bool WriteProfile(Str Path) const { return runtime::WriteProfile(*Asm, Profiles, Path); }
+    // The profile of the function, nullptr if it isn't profiled
+    FunctionProfile* BeginProfile(Function& Fn);
+
+    void ResolveExtern();
+    VMError Link(Assembly* Target);
+    VMError LinkImport(Assembly* Target, Function& Fn);
 
+    // Checked is set when the caller runs with runtime checks
+    template<bool Checked>
     UInt ProcessCall(StackFrame& Frame, Function& Fn);
 
-    UInt MainLoop(Function& Fn, StackFrame& Frame);
+    // Checks the frame of the function before it runs
+    bool FitsInStack(const Function& Fn, const StackFrame& Frame) const;
+
+    // Runs the function in the loop without runtime checks if it was verified
+    UInt Execute(Function& Fn, StackFrame& Frame);
+
+    // Profiled is set when the function counts its jumps and calls in Profile
+    template<bool Checked, bool Profiled>
+    UInt MainLoop(Function& Fn, StackFrame& Frame, FunctionProfile* Profile);
 
     Stack VMStack;
     Assembly* Asm;
-    std::vector<Library> Libraries;
     VMError Err;
     bool LinkageResolved;
+
+    bool IsProfiling = false;
+    // By index of the function in the code file
+    Vector<FunctionProfile> Profiles = {};
 };
 
 }
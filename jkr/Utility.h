@@ -3,7 +3,7 @@
 
 inline constexpr UInt32 Const4Max = 0xF;
 inline constexpr UInt32 Const16Max = 0xFFFF;
-inline constexpr UInt32 Const32Max = 0xFFFF;
+inline constexpr UInt32 Const32Max = 0xFFFF'FFFF;
 inline constexpr Byte ByteMax = 0xFF;
 inline constexpr Int IntMax = 0xFFFF'FFFF'FFFF'FFFF;
 inline constexpr UInt UIntMax = UInt(-1);